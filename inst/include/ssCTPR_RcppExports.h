@@ -151,6 +151,27 @@ namespace ssCTPR {
         return Rcpp::as<arma::mat >(rcpp_result_gen);
     }
 
+    inline std::string sampleMajorCache(const std::string fileName, int N, int P, int tileVariants) {
+        typedef SEXP(*Ptr_sampleMajorCache)(SEXP,SEXP,SEXP,SEXP);
+        static Ptr_sampleMajorCache p_sampleMajorCache = NULL;
+        if (p_sampleMajorCache == NULL) {
+            validateSignature("std::string(*sampleMajorCache)(const std::string,int,int,int)");
+            p_sampleMajorCache = (Ptr_sampleMajorCache)R_GetCCallable("ssCTPR", "_ssCTPR_sampleMajorCache");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_sampleMajorCache(Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(N)), Shield<SEXP>(Rcpp::wrap(P)), Shield<SEXP>(Rcpp::wrap(tileVariants)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<std::string >(rcpp_result_gen);
+    }
+
     inline arma::vec normalize(arma::mat& genotypes) {
         typedef SEXP(*Ptr_normalize)(SEXP);
         static Ptr_normalize p_normalize = NULL;
@@ -172,17 +193,143 @@ namespace ssCTPR {
         return Rcpp::as<arma::vec >(rcpp_result_gen);
     }
 
-    inline List runElnet(arma::vec& lambda, double shrink, double lambda_ct, const std::string fileName, arma::mat& r, arma::vec& adj, int N, int P, arma::Col<int>& col_skip_pos, arma::Col<int>& col_skip, arma::Col<int>& keepbytes, arma::Col<int>& keepoffset, double thr, arma::vec& x, int trace, int maxiter, arma::Col<int>& startvec, arma::Col<int>& endvec) {
-        typedef SEXP(*Ptr_runElnet)(SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP);
+    inline List runElnet(arma::vec& lambda, double shrink, double lambda_ct, const std::string fileName, arma::mat& r, arma::vec& adj, int N, int P, arma::Col<int>& col_skip_pos, arma::Col<int>& col_skip, arma::Col<int>& keepbytes, arma::Col<int>& keepoffset, double thr, arma::vec& x, int trace, int maxiter, arma::Col<int>& startvec, arma::Col<int>& endvec, arma::Col<int>& sketch, int sketchMethod, double seed, bool sparse, double r2, double window, arma::vec& pos, const std::string ldFile, double variance, int solver, bool ridge, int subsample, double carriers) {
+        typedef SEXP(*Ptr_runElnet)(SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP,SEXP);
         static Ptr_runElnet p_runElnet = NULL;
         if (p_runElnet == NULL) {
-            validateSignature("List(*runElnet)(arma::vec&,double,double,const std::string,arma::mat&,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,double,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&)");
+            validateSignature("List(*runElnet)(arma::vec&,double,double,const std::string,arma::mat&,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,double,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,int,double,bool,double,double,arma::vec&,const std::string,double,int,bool,int,double)");
             p_runElnet = (Ptr_runElnet)R_GetCCallable("ssCTPR", "_ssCTPR_runElnet");
         }
         RObject rcpp_result_gen;
         {
             RNGScope RCPP_rngScope_gen;
-            rcpp_result_gen = p_runElnet(Shield<SEXP>(Rcpp::wrap(lambda)), Shield<SEXP>(Rcpp::wrap(shrink)), Shield<SEXP>(Rcpp::wrap(lambda_ct)), Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(r)), Shield<SEXP>(Rcpp::wrap(adj)), Shield<SEXP>(Rcpp::wrap(N)), Shield<SEXP>(Rcpp::wrap(P)), Shield<SEXP>(Rcpp::wrap(col_skip_pos)), Shield<SEXP>(Rcpp::wrap(col_skip)), Shield<SEXP>(Rcpp::wrap(keepbytes)), Shield<SEXP>(Rcpp::wrap(keepoffset)), Shield<SEXP>(Rcpp::wrap(thr)), Shield<SEXP>(Rcpp::wrap(x)), Shield<SEXP>(Rcpp::wrap(trace)), Shield<SEXP>(Rcpp::wrap(maxiter)), Shield<SEXP>(Rcpp::wrap(startvec)), Shield<SEXP>(Rcpp::wrap(endvec)));
+            rcpp_result_gen = p_runElnet(Shield<SEXP>(Rcpp::wrap(lambda)), Shield<SEXP>(Rcpp::wrap(shrink)), Shield<SEXP>(Rcpp::wrap(lambda_ct)), Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(r)), Shield<SEXP>(Rcpp::wrap(adj)), Shield<SEXP>(Rcpp::wrap(N)), Shield<SEXP>(Rcpp::wrap(P)), Shield<SEXP>(Rcpp::wrap(col_skip_pos)), Shield<SEXP>(Rcpp::wrap(col_skip)), Shield<SEXP>(Rcpp::wrap(keepbytes)), Shield<SEXP>(Rcpp::wrap(keepoffset)), Shield<SEXP>(Rcpp::wrap(thr)), Shield<SEXP>(Rcpp::wrap(x)), Shield<SEXP>(Rcpp::wrap(trace)), Shield<SEXP>(Rcpp::wrap(maxiter)), Shield<SEXP>(Rcpp::wrap(startvec)), Shield<SEXP>(Rcpp::wrap(endvec)), Shield<SEXP>(Rcpp::wrap(sketch)), Shield<SEXP>(Rcpp::wrap(sketchMethod)), Shield<SEXP>(Rcpp::wrap(seed)), Shield<SEXP>(Rcpp::wrap(sparse)), Shield<SEXP>(Rcpp::wrap(r2)), Shield<SEXP>(Rcpp::wrap(window)), Shield<SEXP>(Rcpp::wrap(pos)), Shield<SEXP>(Rcpp::wrap(ldFile)), Shield<SEXP>(Rcpp::wrap(variance)), Shield<SEXP>(Rcpp::wrap(solver)), Shield<SEXP>(Rcpp::wrap(ridge)), Shield<SEXP>(Rcpp::wrap(subsample)), Shield<SEXP>(Rcpp::wrap(carriers)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<List >(rcpp_result_gen);
+    }
+
+    inline IntegerVector threadBudget(int threads, int blas) {
+        typedef SEXP(*Ptr_threadBudget)(SEXP,SEXP);
+        static Ptr_threadBudget p_threadBudget = NULL;
+        if (p_threadBudget == NULL) {
+            validateSignature("IntegerVector(*threadBudget)(int,int)");
+            p_threadBudget = (Ptr_threadBudget)R_GetCCallable("ssCTPR", "_ssCTPR_threadBudget");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_threadBudget(Shield<SEXP>(Rcpp::wrap(threads)), Shield<SEXP>(Rcpp::wrap(blas)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<IntegerVector >(rcpp_result_gen);
+    }
+
+    inline int fistaVariants(int variants) {
+        typedef SEXP(*Ptr_fistaVariants)(SEXP);
+        static Ptr_fistaVariants p_fistaVariants = NULL;
+        if (p_fistaVariants == NULL) {
+            validateSignature("int(*fistaVariants)(int)");
+            p_fistaVariants = (Ptr_fistaVariants)R_GetCCallable("ssCTPR", "_ssCTPR_fistaVariants");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_fistaVariants(Shield<SEXP>(Rcpp::wrap(variants)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<int >(rcpp_result_gen);
+    }
+
+    inline int writeWeights(const std::string fileName, arma::mat& weights, int column) {
+        typedef SEXP(*Ptr_writeWeights)(SEXP,SEXP,SEXP);
+        static Ptr_writeWeights p_writeWeights = NULL;
+        if (p_writeWeights == NULL) {
+            validateSignature("int(*writeWeights)(const std::string,arma::mat&,int)");
+            p_writeWeights = (Ptr_writeWeights)R_GetCCallable("ssCTPR", "_ssCTPR_writeWeights");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_writeWeights(Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(weights)), Shield<SEXP>(Rcpp::wrap(column)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<int >(rcpp_result_gen);
+    }
+
+    inline List readWeights(const std::string fileName, IntegerVector columns) {
+        typedef SEXP(*Ptr_readWeights)(SEXP,SEXP);
+        static Ptr_readWeights p_readWeights = NULL;
+        if (p_readWeights == NULL) {
+            validateSignature("List(*readWeights)(const std::string,IntegerVector)");
+            p_readWeights = (Ptr_readWeights)R_GetCCallable("ssCTPR", "_ssCTPR_readWeights");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_readWeights(Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(columns)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<List >(rcpp_result_gen);
+    }
+
+    inline int writeScores(const std::string fileName, arma::mat& scores, IntegerVector samples, int column) {
+        typedef SEXP(*Ptr_writeScores)(SEXP,SEXP,SEXP,SEXP);
+        static Ptr_writeScores p_writeScores = NULL;
+        if (p_writeScores == NULL) {
+            validateSignature("int(*writeScores)(const std::string,arma::mat&,IntegerVector,int)");
+            p_writeScores = (Ptr_writeScores)R_GetCCallable("ssCTPR", "_ssCTPR_writeScores");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_writeScores(Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(scores)), Shield<SEXP>(Rcpp::wrap(samples)), Shield<SEXP>(Rcpp::wrap(column)));
+        }
+        if (rcpp_result_gen.inherits("interrupted-error"))
+            throw Rcpp::internal::InterruptedException();
+        if (Rcpp::internal::isLongjumpSentinel(rcpp_result_gen))
+            throw Rcpp::LongjumpException(rcpp_result_gen);
+        if (rcpp_result_gen.inherits("try-error"))
+            throw Rcpp::exception(Rcpp::as<std::string>(rcpp_result_gen).c_str());
+        return Rcpp::as<int >(rcpp_result_gen);
+    }
+
+    inline List readScores(const std::string fileName, IntegerVector columns) {
+        typedef SEXP(*Ptr_readScores)(SEXP,SEXP);
+        static Ptr_readScores p_readScores = NULL;
+        if (p_readScores == NULL) {
+            validateSignature("List(*readScores)(const std::string,IntegerVector)");
+            p_readScores = (Ptr_readScores)R_GetCCallable("ssCTPR", "_ssCTPR_readScores");
+        }
+        RObject rcpp_result_gen;
+        {
+            RNGScope RCPP_rngScope_gen;
+            rcpp_result_gen = p_readScores(Shield<SEXP>(Rcpp::wrap(fileName)), Shield<SEXP>(Rcpp::wrap(columns)));
         }
         if (rcpp_result_gen.inherits("interrupted-error"))
             throw Rcpp::internal::InterruptedException();
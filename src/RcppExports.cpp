@@ -263,6 +263,43 @@ RcppExport SEXP _ssCTPR_genotypeMatrix(SEXP fileNameSEXP, SEXP NSEXP, SEXP PSEXP
     UNPROTECT(1);
     return rcpp_result_gen;
 }
+// sampleMajorCache
+std::string sampleMajorCache(const std::string fileName, int N, int P, int tileVariants);
+static SEXP _ssCTPR_sampleMajorCache_try(SEXP fileNameSEXP, SEXP NSEXP, SEXP PSEXP, SEXP tileVariantsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< int >::type N(NSEXP);
+    Rcpp::traits::input_parameter< int >::type P(PSEXP);
+    Rcpp::traits::input_parameter< int >::type tileVariants(tileVariantsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sampleMajorCache(fileName, N, P, tileVariants));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_sampleMajorCache(SEXP fileNameSEXP, SEXP NSEXP, SEXP PSEXP, SEXP tileVariantsSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_sampleMajorCache_try(fileNameSEXP, NSEXP, PSEXP, tileVariantsSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
 // normalize
 arma::vec normalize(arma::mat& genotypes);
 static SEXP _ssCTPR_normalize_try(SEXP genotypesSEXP) {
@@ -298,8 +335,8 @@ RcppExport SEXP _ssCTPR_normalize(SEXP genotypesSEXP) {
     return rcpp_result_gen;
 }
 // runElnet
-List runElnet(arma::vec& lambda, double shrink, double lambda_ct, const std::string fileName, arma::mat& r, arma::vec& adj, int N, int P, arma::Col<int>& col_skip_pos, arma::Col<int>& col_skip, arma::Col<int>& keepbytes, arma::Col<int>& keepoffset, double thr, arma::vec& x, int trace, int maxiter, arma::Col<int>& startvec, arma::Col<int>& endvec);
-static SEXP _ssCTPR_runElnet_try(SEXP lambdaSEXP, SEXP shrinkSEXP, SEXP lambda_ctSEXP, SEXP fileNameSEXP, SEXP rSEXP, SEXP adjSEXP, SEXP NSEXP, SEXP PSEXP, SEXP col_skip_posSEXP, SEXP col_skipSEXP, SEXP keepbytesSEXP, SEXP keepoffsetSEXP, SEXP thrSEXP, SEXP xSEXP, SEXP traceSEXP, SEXP maxiterSEXP, SEXP startvecSEXP, SEXP endvecSEXP) {
+List runElnet(arma::vec& lambda, double shrink, double lambda_ct, const std::string fileName, arma::mat& r, arma::vec& adj, int N, int P, arma::Col<int>& col_skip_pos, arma::Col<int>& col_skip, arma::Col<int>& keepbytes, arma::Col<int>& keepoffset, double thr, arma::vec& x, int trace, int maxiter, arma::Col<int>& startvec, arma::Col<int>& endvec, arma::Col<int>& sketch, int sketchMethod, double seed, bool sparse, double r2, double window, arma::vec& pos, const std::string ldFile, double variance, int solver, bool ridge, int subsample, double carriers);
+static SEXP _ssCTPR_runElnet_try(SEXP lambdaSEXP, SEXP shrinkSEXP, SEXP lambda_ctSEXP, SEXP fileNameSEXP, SEXP rSEXP, SEXP adjSEXP, SEXP NSEXP, SEXP PSEXP, SEXP col_skip_posSEXP, SEXP col_skipSEXP, SEXP keepbytesSEXP, SEXP keepoffsetSEXP, SEXP thrSEXP, SEXP xSEXP, SEXP traceSEXP, SEXP maxiterSEXP, SEXP startvecSEXP, SEXP endvecSEXP, SEXP sketchSEXP, SEXP sketchMethodSEXP, SEXP seedSEXP, SEXP sparseSEXP, SEXP r2SEXP, SEXP windowSEXP, SEXP posSEXP, SEXP ldFileSEXP, SEXP varianceSEXP, SEXP solverSEXP, SEXP ridgeSEXP, SEXP subsampleSEXP, SEXP carriersSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< arma::vec& >::type lambda(lambdaSEXP);
@@ -320,15 +357,240 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type maxiter(maxiterSEXP);
     Rcpp::traits::input_parameter< arma::Col<int>& >::type startvec(startvecSEXP);
     Rcpp::traits::input_parameter< arma::Col<int>& >::type endvec(endvecSEXP);
-    rcpp_result_gen = Rcpp::wrap(runElnet(lambda, shrink, lambda_ct, fileName, r, adj, N, P, col_skip_pos, col_skip, keepbytes, keepoffset, thr, x, trace, maxiter, startvec, endvec));
+    Rcpp::traits::input_parameter< arma::Col<int>& >::type sketch(sketchSEXP);
+    Rcpp::traits::input_parameter< int >::type sketchMethod(sketchMethodSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< bool >::type sparse(sparseSEXP);
+    Rcpp::traits::input_parameter< double >::type r2(r2SEXP);
+    Rcpp::traits::input_parameter< double >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< arma::vec& >::type pos(posSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type ldFile(ldFileSEXP);
+    Rcpp::traits::input_parameter< double >::type variance(varianceSEXP);
+    Rcpp::traits::input_parameter< int >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< bool >::type ridge(ridgeSEXP);
+    Rcpp::traits::input_parameter< int >::type subsample(subsampleSEXP);
+    Rcpp::traits::input_parameter< double >::type carriers(carriersSEXP);
+    rcpp_result_gen = Rcpp::wrap(runElnet(lambda, shrink, lambda_ct, fileName, r, adj, N, P, col_skip_pos, col_skip, keepbytes, keepoffset, thr, x, trace, maxiter, startvec, endvec, sketch, sketchMethod, seed, sparse, r2, window, pos, ldFile, variance, solver, ridge, subsample, carriers));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_runElnet(SEXP lambdaSEXP, SEXP shrinkSEXP, SEXP lambda_ctSEXP, SEXP fileNameSEXP, SEXP rSEXP, SEXP adjSEXP, SEXP NSEXP, SEXP PSEXP, SEXP col_skip_posSEXP, SEXP col_skipSEXP, SEXP keepbytesSEXP, SEXP keepoffsetSEXP, SEXP thrSEXP, SEXP xSEXP, SEXP traceSEXP, SEXP maxiterSEXP, SEXP startvecSEXP, SEXP endvecSEXP, SEXP sketchSEXP, SEXP sketchMethodSEXP, SEXP seedSEXP, SEXP sparseSEXP, SEXP r2SEXP, SEXP windowSEXP, SEXP posSEXP, SEXP ldFileSEXP, SEXP varianceSEXP, SEXP solverSEXP, SEXP ridgeSEXP, SEXP subsampleSEXP, SEXP carriersSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_runElnet_try(lambdaSEXP, shrinkSEXP, lambda_ctSEXP, fileNameSEXP, rSEXP, adjSEXP, NSEXP, PSEXP, col_skip_posSEXP, col_skipSEXP, keepbytesSEXP, keepoffsetSEXP, thrSEXP, xSEXP, traceSEXP, maxiterSEXP, startvecSEXP, endvecSEXP, sketchSEXP, sketchMethodSEXP, seedSEXP, sparseSEXP, r2SEXP, windowSEXP, posSEXP, ldFileSEXP, varianceSEXP, solverSEXP, ridgeSEXP, subsampleSEXP, carriersSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// threadBudget
+IntegerVector threadBudget(int threads, int blas);
+static SEXP _ssCTPR_threadBudget_try(SEXP threadsSEXP, SEXP blasSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type blas(blasSEXP);
+    rcpp_result_gen = Rcpp::wrap(threadBudget(threads, blas));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_threadBudget(SEXP threadsSEXP, SEXP blasSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_threadBudget_try(threadsSEXP, blasSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// fistaVariants
+int fistaVariants(int variants);
+static SEXP _ssCTPR_fistaVariants_try(SEXP variantsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< int >::type variants(variantsSEXP);
+    rcpp_result_gen = Rcpp::wrap(fistaVariants(variants));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_fistaVariants(SEXP variantsSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_fistaVariants_try(variantsSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// writeWeights
+int writeWeights(const std::string fileName, arma::mat& weights, int column);
+static SEXP _ssCTPR_writeWeights_try(SEXP fileNameSEXP, SEXP weightsSEXP, SEXP columnSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< arma::mat& >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< int >::type column(columnSEXP);
+    rcpp_result_gen = Rcpp::wrap(writeWeights(fileName, weights, column));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_writeWeights(SEXP fileNameSEXP, SEXP weightsSEXP, SEXP columnSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_writeWeights_try(fileNameSEXP, weightsSEXP, columnSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// readWeights
+List readWeights(const std::string fileName, IntegerVector columns);
+static SEXP _ssCTPR_readWeights_try(SEXP fileNameSEXP, SEXP columnsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type columns(columnsSEXP);
+    rcpp_result_gen = Rcpp::wrap(readWeights(fileName, columns));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_readWeights(SEXP fileNameSEXP, SEXP columnsSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_readWeights_try(fileNameSEXP, columnsSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// writeScores
+int writeScores(const std::string fileName, arma::mat& scores, IntegerVector samples, int column);
+static SEXP _ssCTPR_writeScores_try(SEXP fileNameSEXP, SEXP scoresSEXP, SEXP samplesSEXP, SEXP columnSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< arma::mat& >::type scores(scoresSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< int >::type column(columnSEXP);
+    rcpp_result_gen = Rcpp::wrap(writeScores(fileName, scores, samples, column));
+    return rcpp_result_gen;
+END_RCPP_RETURN_ERROR
+}
+RcppExport SEXP _ssCTPR_writeScores(SEXP fileNameSEXP, SEXP scoresSEXP, SEXP samplesSEXP, SEXP columnSEXP) {
+    SEXP rcpp_result_gen;
+    {
+        Rcpp::RNGScope rcpp_rngScope_gen;
+        rcpp_result_gen = PROTECT(_ssCTPR_writeScores_try(fileNameSEXP, scoresSEXP, samplesSEXP, columnSEXP));
+    }
+    Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
+    if (rcpp_isInterrupt_gen) {
+        UNPROTECT(1);
+        Rf_onintr();
+    }
+    bool rcpp_isLongjump_gen = Rcpp::internal::isLongjumpSentinel(rcpp_result_gen);
+    if (rcpp_isLongjump_gen) {
+        Rcpp::internal::resumeJump(rcpp_result_gen);
+    }
+    Rboolean rcpp_isError_gen = Rf_inherits(rcpp_result_gen, "try-error");
+    if (rcpp_isError_gen) {
+        SEXP rcpp_msgSEXP_gen = Rf_asChar(rcpp_result_gen);
+        UNPROTECT(1);
+        Rf_error(CHAR(rcpp_msgSEXP_gen));
+    }
+    UNPROTECT(1);
+    return rcpp_result_gen;
+}
+// readScores
+List readScores(const std::string fileName, IntegerVector columns);
+static SEXP _ssCTPR_readScores_try(SEXP fileNameSEXP, SEXP columnsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::string >::type fileName(fileNameSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type columns(columnsSEXP);
+    rcpp_result_gen = Rcpp::wrap(readScores(fileName, columns));
     return rcpp_result_gen;
 END_RCPP_RETURN_ERROR
 }
-RcppExport SEXP _ssCTPR_runElnet(SEXP lambdaSEXP, SEXP shrinkSEXP, SEXP lambda_ctSEXP, SEXP fileNameSEXP, SEXP rSEXP, SEXP adjSEXP, SEXP NSEXP, SEXP PSEXP, SEXP col_skip_posSEXP, SEXP col_skipSEXP, SEXP keepbytesSEXP, SEXP keepoffsetSEXP, SEXP thrSEXP, SEXP xSEXP, SEXP traceSEXP, SEXP maxiterSEXP, SEXP startvecSEXP, SEXP endvecSEXP) {
+RcppExport SEXP _ssCTPR_readScores(SEXP fileNameSEXP, SEXP columnsSEXP) {
     SEXP rcpp_result_gen;
     {
         Rcpp::RNGScope rcpp_rngScope_gen;
-        rcpp_result_gen = PROTECT(_ssCTPR_runElnet_try(lambdaSEXP, shrinkSEXP, lambda_ctSEXP, fileNameSEXP, rSEXP, adjSEXP, NSEXP, PSEXP, col_skip_posSEXP, col_skipSEXP, keepbytesSEXP, keepoffsetSEXP, thrSEXP, xSEXP, traceSEXP, maxiterSEXP, startvecSEXP, endvecSEXP));
+        rcpp_result_gen = PROTECT(_ssCTPR_readScores_try(fileNameSEXP, columnsSEXP));
     }
     Rboolean rcpp_isInterrupt_gen = Rf_inherits(rcpp_result_gen, "interrupted-error");
     if (rcpp_isInterrupt_gen) {
@@ -348,6 +610,39 @@ RcppExport SEXP _ssCTPR_runElnet(SEXP lambdaSEXP, SEXP shrinkSEXP, SEXP lambda_c
     UNPROTECT(1);
     return rcpp_result_gen;
 }
+// perfProfiling
+LogicalVector perfProfiling(bool enable);
+RcppExport SEXP _ssCTPR_perfProfiling(SEXP enableSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type enable(enableSEXP);
+    rcpp_result_gen = Rcpp::wrap(perfProfiling(enable));
+    return rcpp_result_gen;
+END_RCPP
+}
+// perfSummary
+DataFrame perfSummary(bool reset);
+RcppExport SEXP _ssCTPR_perfSummary(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(perfSummary(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// phaseTimers
+DataFrame phaseTimers(bool reset);
+RcppExport SEXP _ssCTPR_phaseTimers(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(phaseTimers(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 // validate (ensure exported C++ functions exist before calling them)
 static int _ssCTPR_RcppExport_validate(const char* sig) { 
@@ -359,8 +654,15 @@ static int _ssCTPR_RcppExport_validate(const char* sig) {
         signatures.insert("int(*elnet)(double,double,double,const arma::vec&,const arma::mat&,const arma::mat&,const arma::vec&,double,arma::vec&,arma::vec&,int,int)");
         signatures.insert("int(*repelnet)(double,double,double,arma::vec&,arma::mat&,arma::mat&,arma::vec&,double,arma::vec&,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&)");
         signatures.insert("arma::mat(*genotypeMatrix)(const std::string,int,int,arma::Col<int>,arma::Col<int>,arma::Col<int>,arma::Col<int>,const int)");
+        signatures.insert("std::string(*sampleMajorCache)(const std::string,int,int,int)");
         signatures.insert("arma::vec(*normalize)(arma::mat&)");
-        signatures.insert("List(*runElnet)(arma::vec&,double,double,const std::string,arma::mat&,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,double,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&)");
+        signatures.insert("List(*runElnet)(arma::vec&,double,double,const std::string,arma::mat&,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,double,arma::vec&,int,int,arma::Col<int>&,arma::Col<int>&,arma::Col<int>&,int,double,bool,double,double,arma::vec&,const std::string,double,int,bool,int,double)");
+        signatures.insert("IntegerVector(*threadBudget)(int,int)");
+        signatures.insert("int(*fistaVariants)(int)");
+        signatures.insert("int(*writeWeights)(const std::string,arma::mat&,int)");
+        signatures.insert("List(*readWeights)(const std::string,IntegerVector)");
+        signatures.insert("int(*writeScores)(const std::string,arma::mat&,IntegerVector,int)");
+        signatures.insert("List(*readScores)(const std::string,IntegerVector)");
     }
     return signatures.find(sig) != signatures.end();
 }
@@ -373,8 +675,15 @@ RcppExport SEXP _ssCTPR_RcppExport_registerCCallable() {
     R_RegisterCCallable("ssCTPR", "_ssCTPR_elnet", (DL_FUNC)_ssCTPR_elnet_try);
     R_RegisterCCallable("ssCTPR", "_ssCTPR_repelnet", (DL_FUNC)_ssCTPR_repelnet_try);
     R_RegisterCCallable("ssCTPR", "_ssCTPR_genotypeMatrix", (DL_FUNC)_ssCTPR_genotypeMatrix_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_sampleMajorCache", (DL_FUNC)_ssCTPR_sampleMajorCache_try);
     R_RegisterCCallable("ssCTPR", "_ssCTPR_normalize", (DL_FUNC)_ssCTPR_normalize_try);
     R_RegisterCCallable("ssCTPR", "_ssCTPR_runElnet", (DL_FUNC)_ssCTPR_runElnet_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_threadBudget", (DL_FUNC)_ssCTPR_threadBudget_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_fistaVariants", (DL_FUNC)_ssCTPR_fistaVariants_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_writeWeights", (DL_FUNC)_ssCTPR_writeWeights_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_readWeights", (DL_FUNC)_ssCTPR_readWeights_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_writeScores", (DL_FUNC)_ssCTPR_writeScores_try);
+    R_RegisterCCallable("ssCTPR", "_ssCTPR_readScores", (DL_FUNC)_ssCTPR_readScores_try);
     R_RegisterCCallable("ssCTPR", "_ssCTPR_RcppExport_validate", (DL_FUNC)_ssCTPR_RcppExport_validate);
     return R_NilValue;
 }
@@ -386,8 +695,18 @@ static const R_CallMethodDef CallEntries[] = {
     {"_ssCTPR_elnet", (DL_FUNC) &_ssCTPR_elnet, 12},
     {"_ssCTPR_repelnet", (DL_FUNC) &_ssCTPR_repelnet, 14},
     {"_ssCTPR_genotypeMatrix", (DL_FUNC) &_ssCTPR_genotypeMatrix, 8},
+    {"_ssCTPR_sampleMajorCache", (DL_FUNC) &_ssCTPR_sampleMajorCache, 4},
     {"_ssCTPR_normalize", (DL_FUNC) &_ssCTPR_normalize, 1},
-    {"_ssCTPR_runElnet", (DL_FUNC) &_ssCTPR_runElnet, 18},
+    {"_ssCTPR_runElnet", (DL_FUNC) &_ssCTPR_runElnet, 31},
+    {"_ssCTPR_threadBudget", (DL_FUNC) &_ssCTPR_threadBudget, 2},
+    {"_ssCTPR_fistaVariants", (DL_FUNC) &_ssCTPR_fistaVariants, 1},
+    {"_ssCTPR_writeWeights", (DL_FUNC) &_ssCTPR_writeWeights, 3},
+    {"_ssCTPR_readWeights", (DL_FUNC) &_ssCTPR_readWeights, 2},
+    {"_ssCTPR_writeScores", (DL_FUNC) &_ssCTPR_writeScores, 4},
+    {"_ssCTPR_readScores", (DL_FUNC) &_ssCTPR_readScores, 2},
+    {"_ssCTPR_perfProfiling", (DL_FUNC) &_ssCTPR_perfProfiling, 1},
+    {"_ssCTPR_perfSummary", (DL_FUNC) &_ssCTPR_perfSummary, 1},
+    {"_ssCTPR_phaseTimers", (DL_FUNC) &_ssCTPR_phaseTimers, 1},
     {"_ssCTPR_RcppExport_registerCCallable", (DL_FUNC) &_ssCTPR_RcppExport_registerCCallable, 0},
     {NULL, NULL, 0}
 };
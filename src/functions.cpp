@@ -17,102 +17,47 @@
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <vector>
 #include <RcppArmadillo.h>
+#include "phasetimer.h"
+#include "perfcounters.h"
+#include "kernels.h"
 
 // [[Rcpp::depends(RcppArmadillo)]]
 using namespace Rcpp;
 
+namespace {
+
+void checkRInterrupt() {
+  Rcpp::checkUserInterrupt();
+}
+
 /**
- Opens a Plink binary files
- 
- @s file name
- @BIT ifstream
- @return is plink file in major mode
+ Routes interrupts and output of the R-free kernels to R
  
  */
-
-bool openPlinkBinaryFile(const std::string s, std::ifstream &BIT) {
-  BIT.open(s.c_str(), std::ios::in | std::ios::binary);
-  if (!BIT.is_open()) {
-    throw "Cannot open the bed file";
+struct RKernelHooks {
+  RKernelHooks() {
+    ssctpr::setInterruptHook(checkRInterrupt);
+    ssctpr::setMessageStream(&Rcout);
+    ssctpr::setWarningStream(&Rcerr);
   }
-  
-  // 2) else check for 0.99 SNP/Ind coding
-  // 3) else print warning that file is too old
-  char ch[1];
-  BIT.read(ch, 1);
-  std::bitset<8> b;
-  b = ch[0];
-  bool bfile_SNP_major = false;
-  bool v1_bfile = true;
-  // If v1.00 file format
-  // Magic numbers for .bed file: 00110110 11011000 = v1.00 bed file
-  // std::cerr << "check magic number" << std::endl;
-  if ((b[2] && b[3] && b[5] && b[6]) && !(b[0] || b[1] || b[4] || b[7])) {
-    // Next number
-    BIT.read(ch, 1);
-    b = ch[0];
-    if ((b[0] && b[1] && b[3] && b[4]) && !(b[2] || b[5] || b[6] || b[7])) {
-      // Read SNP/Ind major coding
-      BIT.read(ch, 1);
-      b = ch[0];
-      if (b[0])
-        bfile_SNP_major = true;
-      else
-        bfile_SNP_major = false;
-      
-      // if (bfile_SNP_major) std::cerr << "Detected that binary PED file is
-      // v1.00 SNP-major mode" << std::endl;
-      // else std::cerr << "Detected that binary PED file is v1.00
-      // individual-major mode" << std::endl;
-      
-    } else
-      v1_bfile = false;
-    
-  } else
-    v1_bfile = false;
-  // Reset file if < v1
-  if (!v1_bfile) {
-    Rcerr << "Warning, old BED file <v1.00 : will try to recover..."
-          << std::endl;
-    Rcerr << "  but you should --make-bed from PED )" << std::endl;
-    BIT.close();
-    BIT.clear();
-    BIT.open(s.c_str(), std::ios::in | std::ios::binary);
-    BIT.read(ch, 1);
-    b = ch[0];
-  }
-  // If 0.99 file format
-  if ((!v1_bfile) && (b[1] || b[2] || b[3] || b[4] || b[5] || b[6] || b[7])) {
-    Rcerr << std::endl
-          << " *** Possible problem: guessing that BED is < v0.99      *** "
-          << std::endl;
-    Rcerr << " *** High chance of data corruption, spurious results    *** "
-          << std::endl;
-    Rcerr
-      << " *** Unless you are _sure_ this really is an old BED file *** "
-      << std::endl;
-    Rcerr << " *** you should recreate PED -> BED                      *** "
-          << std::endl
-          << std::endl;
-    bfile_SNP_major = false;
-    BIT.close();
-    BIT.clear();
-    BIT.open(s.c_str(), std::ios::in | std::ios::binary);
-  } else if (!v1_bfile) {
-    if (b[0])
-      bfile_SNP_major = true;
-    else
-      bfile_SNP_major = false;
-    Rcerr << "Binary PED file is v0.99" << std::endl;
-    if (bfile_SNP_major)
-      Rcerr << "Detected that binary PED file is in SNP-major mode"
-            << std::endl;
-      else
-        Rcerr << "Detected that binary PED file is in individual-major mode"
-              << std::endl;
-  }
-  return bfile_SNP_major;
+} rKernelHooks;
+
+ssctpr::BedSelection bedSelection(const arma::Col<int>& col_skip_pos, 
+                                  const arma::Col<int>& col_skip, 
+                                  const arma::Col<int>& keepbytes, 
+                                  const arma::Col<int>& keepoffset) {
+  ssctpr::BedSelection sel;
+  sel.col_skip_pos = col_skip_pos.memptr();
+  sel.col_skip = col_skip.memptr();
+  sel.nskip = col_skip_pos.n_elem;
+  sel.keepbytes = keepbytes.memptr();
+  sel.keepoffset = keepoffset.memptr();
+  sel.nkeep = keepbytes.n_elem;
+  return sel;
+}
+
 }
 
 //' Count number of lines in a text file
@@ -152,105 +97,13 @@ arma::mat multiBed3(const std::string fileName, int N, int P, const arma::mat in
                     arma::Col<int> keepbytes, arma::Col<int> keepoffset, 
                     const int trace) {
   
-  std::ifstream bedFile;
-  bool snpMajor = openPlinkBinaryFile(fileName, bedFile);
-  if (!snpMajor)
-    throw std::runtime_error("We currently have no plans of implementing the "
-                               "individual-major mode. Please use the snp-major "
-                               "format");
-  
-  int i = 0;
-  int ii = 0;
-  int iii = 0;
-  const bool colskip = (col_skip_pos.n_elem > 0);
-  unsigned long long int Nbytes = ceil(N / 4.0);
-  const bool selectrow = (keepbytes.n_elem > 0);
-  int n;
-  if (selectrow)
-    n = keepbytes.n_elem;
-  else
-    n = N;
-  int jj;
-  
-  arma::mat result = arma::mat(n, input.n_cols, arma::fill::zeros);
-  std::bitset<8> b; // Initiate the bit array
-  char ch[Nbytes];
-  
-  int chunk;
-  double step;
-  double Step = 0; 
-  if(trace > 0) {
-    chunk = input.n_rows / pow(10, trace); 
-    step = 100 / pow(10, trace); 
-    // Rcout << "Started C++ program \n"; 
-  }
-  
-  while (i < P) {
-    Rcpp::checkUserInterrupt();
-    if (colskip) {
-      if (ii < col_skip.n_elem) {
-        if (i == col_skip_pos[ii]) {
-          bedFile.seekg(col_skip[ii] * Nbytes, bedFile.cur);
-          i = i + col_skip[ii];
-          ii++;
-          continue;
-        }
-      }
-    }
-    
-    if(trace > 0) {
-      if (iii % chunk == 0) {
-        Rcout << Step << "% done\n";
-        Step = Step + step; 
-      }
-    }
-    
-    bedFile.read(ch, Nbytes); // Read the information
-    if (!bedFile)
-      throw std::runtime_error(
-          "Problem with the BED file...has the FAM/BIM file been changed?");
-    
-    int j = 0;
-    if (!selectrow) {
-      for (jj = 0; jj < Nbytes; jj++) {
-        b = ch[jj];
-        
-        int c = 0;
-        while (c < 7 && j < N) { // from the original PLINK: 7 because of 8 bits
-          int first = b[c++];
-          int second = b[c++];
-          if (first == 0) {
-            for (int k = 0; k < input.n_cols; k++) {
-              if (input(iii, k) != 0.0) {
-                result(j, k) += (2 - second) * input(iii, k);
-              }
-            }
-          }
-          j++;
-        }
-      }
-    } else {
-      for (jj = 0; jj < keepbytes.n_elem; jj++) {
-        b = ch[keepbytes[jj]];
-        
-        int c = keepoffset[jj];
-        int first = b[c++];
-        int second = b[c];
-        if (first == 0) {
-          for (int k = 0; k < input.n_cols; k++) {
-            if (input(iii, k) != 0.0) {
-              result(j, k) += (2 - second) * input(iii, k);
-            }
-          }
-        }
-        j++;
-      }
-    }
-    
-    i++;
-    iii++;
-  }
-  
+  ScopedPhase phase("score");
+  ScopedPerf perf("score");
+  ssctpr::BedSelection sel = bedSelection(col_skip_pos, col_skip, keepbytes, keepoffset);
+  arma::mat result(ssctpr::selectedSamples(N, sel), input.n_cols);
+  int read = ssctpr::multiBed3(fileName, N, P, input.memptr(), input.n_rows, 
+                               input.n_cols, sel, trace, result.memptr());
+  phase.add((double) read * ssctpr::bedBytes(N), read);
   return result;
 }
 
@@ -278,111 +131,14 @@ arma::mat multiBed3sp(const std::string fileName, int N, int P,
                       arma::Col<int> keepbytes, arma::Col<int> keepoffset, 
                       const int trace) {
   
-  std::ifstream bedFile;
-  bool snpMajor = openPlinkBinaryFile(fileName, bedFile);
-  if (!snpMajor)
-    throw std::runtime_error("We currently have no plans of implementing the "
-                               "individual-major mode. Please use the snp-major "
-                               "format");
-  
-  int i = 0;
-  int ii = 0;
-  int iii = 0;
-  int k = 0;
-  const bool colskip = (col_skip_pos.n_elem > 0);
-  unsigned long long int Nbytes = ceil(N / 4.0);
-  const bool selectrow = (keepbytes.n_elem > 0);
-  int n;
-  if (selectrow)
-    n = keepbytes.n_elem;
-  else
-    n = N;
-  int jj;
-  
-  arma::mat result = arma::mat(n, ncol, arma::fill::zeros);
-  std::bitset<8> b; // Initiate the bit array
-  char ch[Nbytes];
-  
-  int chunk;
-  double step;
-  double Step = 0; 
-  if(trace > 0) {
-    chunk = nonzeros.n_elem / pow(10, trace); 
-    step = 100 / pow(10, trace); 
-    // Rcout << "Started C++ program \n"; 
-  }
-  
-  while (i < P) {
-    Rcpp::checkUserInterrupt();
-    if (colskip) {
-      if (ii < col_skip.n_elem) {
-        if (i == col_skip_pos[ii]) {
-          bedFile.seekg(col_skip[ii] * Nbytes, bedFile.cur);
-          i = i + col_skip[ii];
-          ii++;
-          continue;
-        }
-      }
-    }
-    
-    if(trace > 0) {
-      if (iii % chunk == 0) {
-        Rcout << Step << "% done\n";
-        Step = Step + step; 
-      }
-    }
-    
-    bedFile.read(ch, Nbytes); // Read the information
-    if (!bedFile)
-      throw std::runtime_error(
-          "Problem with the BED file...has the FAM/BIM file been changed?");
-    
-    int j = 0;
-    if (!selectrow) {
-      for (jj = 0; jj < Nbytes; jj++) {
-        b = ch[jj];
-        
-        int c = 0;
-        while (c < 7 && j < N) { // from the original PLINK: 7 because of 8 bits
-          int first = b[c++];
-          int second = b[c++];
-          if(nonzeros[iii] > 0) {
-            if (first == 0) {
-              for (int kk = 0; kk < nonzeros[iii]; kk++) {
-                result(j, colpos[k]) += (2 - second) * beta[k];
-                k++;
-              }
-              k -= nonzeros[iii];
-            }
-          }
-          j++;
-        }
-      }
-    } else {
-      for (jj = 0; jj < keepbytes.n_elem; jj++) {
-        b = ch[keepbytes[jj]];
-        
-        int c = keepoffset[jj];
-        int first = b[c++];
-        int second = b[c];
-        if(nonzeros[iii] > 0) {
-          if (first == 0) {
-            for (int kk = 0; kk < nonzeros[iii]; kk++) {
-              result(j, colpos[k]) += (2 - second) * beta[k];
-              k++;
-            }
-            k -= nonzeros[iii];
-          }
-        }
-        j++;
-      }
-    }
-    
-    k += nonzeros[iii];
-    i++;
-    iii++;
-  }
-  
+  ScopedPhase phase("score");
+  ScopedPerf perf("score");
+  ssctpr::BedSelection sel = bedSelection(col_skip_pos, col_skip, keepbytes, keepoffset);
+  arma::mat result(ssctpr::selectedSamples(N, sel), ncol);
+  int read = ssctpr::multiBed3sp(fileName, N, P, beta.memptr(), nonzeros.memptr(), 
+                                 nonzeros.n_elem, colpos.memptr(), ncol, 
+                                 sel, trace, result.memptr());
+  phase.add((double) read * ssctpr::bedBytes(N), read);
   return result;
 }
 
@@ -409,8 +165,7 @@ arma::mat multiBed3sp(const std::string fileName, int N, int P,
 int elnet(double lambda1, double lambda2, double lambda_ct, const arma::vec& diag, const arma::mat& X, 
           const arma::mat& r, const arma::vec& adj, double thr, arma::vec& x, arma::vec& yhat, int trace, int maxiter)
 {
-  
-  
+  ScopedPerf perf("elnet");
   int n=X.n_rows; // number of samples
   int p=X.n_cols; // number of variants
   int traits=r.n_cols; // number of traits, including the primary trait 
@@ -420,80 +175,10 @@ int elnet(double lambda1, double lambda2, double lambda_ct, const arma::vec& dia
   if(yhat.n_elem != n) stop("yhat.n_elem != n");
   if(diag.n_elem != p) stop("diag.n_elem != p"); 
   
-  //Rcout << "Yingxi-elnet: ABC" << std::endl;
-  
-  double dlx_cur, dlx_pre,del,t,xj,ctp;
-  int j,i;
-  
-  // intermediate variables
-  arma::vec Lambda2(p); 
-  Lambda2.fill(lambda2);
-  arma::vec Lambda_ct(p); 
-  Lambda_ct=lambda_ct*adj;
-  
-  arma::vec denom=diag + Lambda2 + Lambda_ct; // denominator while updating beta coef
-  
-  //Rcout << "Yingxi-elnet: DEF" << std::endl;
-  
-  int conv=0;
-  int count=0;
-  dlx_pre=0.0;
-  for(int k=0;k<maxiter ;k++) {
-    dlx_cur=0.0;
-    for(j=0; j < p; j++) {
-      del=0.0;
-      xj=x(j);
-      x(j)=0.0;
-      t= diag(j) * xj + r(j,0) - arma::dot(X.col(j), yhat);
-      // t is u(j), Eq(7) in ms
-      // u(j) = r(j,0) - (dotproduct(X.col(j), (X * x - X.col(j) * xj))
-      //      = r(j,0) - (dotproduct(X.col(j), X * x)) + (docproduct(X.col(j), X.col(j) * xj))
-      //      = r(j,0) - (dotproduct(X.col(j), yhat)) + diag(j) * xj
-      
-      
-      // cross trait penalty
-      if(traits > 1){
-        ctp=r(j,1);
-        ctp*=lambda_ct;
-      } else{
-        ctp=0.0;
-      }
-   
-      // update the beta coef
-      if(std::abs(t+ctp)-lambda1 > 0.0){
-        if(t+ctp-lambda1 > 0.0){
-          x(j)=t-lambda1+ctp/denom(j);
-        } else{
-          x(j)=t+lambda1+ctp/denom(j);
-        }
-      }
-      
-      if(x(j)==xj) continue;
-      del=x(j)-xj;   // x(j) is new, xj is old
-      //dlx=std::max(dlx,std::abs(del));
-      
-      yhat += del*X.col(j); // update yhat
-      dlx_cur=std::max(dlx_cur,std::abs(del)); 
-    } 
-    if(std::abs(dlx_cur-dlx_pre)<1e-6){
-      count++;
-    } else{
-      count=0;
-    }
-    dlx_pre=dlx_cur;
-    checkUserInterrupt();
-    //if(trace > 1) Rcout << "Iteration: " << k << ": " << "dlx:" << dlx_cur << "  count:" << count << "\n";
-    
-    if(dlx_cur < thr) {
-      conv=1;
-      break;
-    }
-    if(count >= 50){
-      conv=1;
-      break;
-    }
-  }
-  return conv;
+  ssctpr::ElnetTelemetry tel;
+  return ssctpr::elnet(lambda1, lambda2, lambda_ct, diag.memptr(), X.memptr(), n, p, 
+                       r.memptr(), traits, p, adj.memptr(), thr, x.memptr(), 
+                       yhat.memptr(), trace, maxiter, tel);
 }
 
 //' performs elnet by blocks
@@ -520,36 +205,12 @@ int repelnet(double lambda1, double lambda2, double lambda_ct, arma::vec& diag,
              double thr, arma::vec& x, arma::vec& yhat, int trace, int maxiter, 
              arma::Col<int>& startvec, arma::Col<int>& endvec)
 {
-  
-  // Repeatedly call elnet by blocks
-  int nreps=startvec.n_elem;
-  int out=1;
-  
-  for(int i=0;i < startvec.n_elem; i++) {
-    
-    arma::vec xtouse=x.subvec(startvec(i), endvec(i));
-    arma::vec yhattouse=X.cols(startvec(i), endvec(i)) * xtouse;
-    
-    //Rcout << "Yingxi: ABC" << std::endl;
-    
-    int out2=elnet(lambda1, lambda2, lambda_ct,
-                   diag.subvec(startvec(i), endvec(i)), 
-                   X.cols(startvec(i), endvec(i)), 
-                   r.rows(startvec(i), endvec(i)),
-                   adj.subvec(startvec(i), endvec(i)),
-                   thr, xtouse, 
-                   yhattouse, trace - 1, maxiter);
-    //Rcout << "Yingxi: DEF" << std::endl;
-    
-    x.subvec(startvec(i), endvec(i))=xtouse; // update beta coef
-    yhat += yhattouse; 
-    
-    //Rcout << "Yingxi: GHI" << std::endl;
-    
-    if(trace > 0) Rcout << "Block: " << i << "\n";
-    out=std::min(out, out2);
-  }
-  return out; 
+  ScopedPerf perf("elnet");
+  std::vector<ssctpr::ElnetTelemetry> tel;
+  return ssctpr::repelnet(lambda1, lambda2, lambda_ct, diag.memptr(), X.memptr(), 
+                          X.n_rows, X.n_cols, r.memptr(), r.n_cols, adj.memptr(), 
+                          thr, x.memptr(), yhat.memptr(), trace, maxiter, 
+                          startvec.memptr(), endvec.memptr(), startvec.n_elem, tel);
 }
 
 //' imports genotypeMatrix
@@ -570,94 +231,35 @@ arma::mat genotypeMatrix(const std::string fileName, int N, int P,
                          arma::Col<int> keepbytes, arma::Col<int> keepoffset, 
                          const int fillmissing) {
   
-  std::ifstream bedFile;
-  bool snpMajor = openPlinkBinaryFile(fileName, bedFile);
-  
-  if (!snpMajor)
-    throw std::runtime_error("We currently have no plans of implementing the "
-                               "individual-major mode. Please use the snp-major "
-                               "format");
-  
-  int i = 0;
-  int ii = 0;
-  const bool colskip = (col_skip_pos.n_elem > 0);
-  unsigned long long int Nbytes = ceil(N / 4.0);
-  const bool selectrow = (keepbytes.n_elem > 0);
-  int n, p, nskip;
-  if (selectrow)
-    n = keepbytes.n_elem;
-  else
-    n = N;
-  
-  if (colskip) {
-    nskip = arma::accu(col_skip);
-    p = P - nskip;
-  }  else
-    p = P;
-  
-  int j, jj, iii;
-  
-  arma::mat genotypes = arma::mat(n, p, arma::fill::zeros);
-  std::bitset<8> b; // Initiate the bit array
-  char ch[Nbytes];
-  
-  iii=0;
-  while (i < P) {
-    // Rcout << i << std::endl;
-    Rcpp::checkUserInterrupt();
-    if (colskip) {
-      if (ii < col_skip.n_elem) {
-        if (i == col_skip_pos[ii]) {
-          bedFile.seekg(col_skip[ii] * Nbytes, bedFile.cur);
-          i = i + col_skip[ii];
-          ii++;
-          continue;
-        }
-      }
-    }
-    
-    bedFile.read(ch, Nbytes); // Read the information
-    if (!bedFile)
-      throw std::runtime_error(
-          "Problem with the BED file...has the FAM/BIM file been changed?");
-    
-    j = 0; 
-    if (!selectrow) {
-      for (jj = 0; jj < Nbytes; jj++) {
-        b = ch[jj];
-        
-        int c = 0;
-        while (c < 7 &&
-               j < N) { // from the original PLINK: 7 because of 8 bits
-          int first = b[c++];
-          int second = b[c++];
-          if (first == 0) {
-            genotypes(j, iii) = (2 - second);
-          }
-          if(fillmissing == 0 && first == 1 && second == 0) genotypes(j, iii) =arma::datum::nan;
-          j++;
-        }
-      }
-    } else {
-      for (jj = 0; jj < keepbytes.n_elem; jj++) {
-        b = ch[keepbytes[jj]];
-        
-        int c = keepoffset[jj];
-        int first = b[c++];
-        int second = b[c];
-        if (first == 0) {
-          genotypes(j, iii) = (2 - second);
-        }
-        if(fillmissing == 0 && first == 1 && second == 0) genotypes(j, iii) =arma::datum::nan;
-        j++;
-      }
-    }
-    i++;
-    iii++; 
-  }
+  ScopedPhase phase("decode");
+  ScopedPerf perf("decode");
+  ssctpr::BedSelection sel = bedSelection(col_skip_pos, col_skip, keepbytes, keepoffset);
+  arma::mat genotypes(ssctpr::selectedSamples(N, sel), ssctpr::selectedVariants(P, sel));
+  int read = ssctpr::genotypeMatrix(fileName, N, P, sel, fillmissing, 
+                                    genotypes.memptr());
+  phase.add((double) read * ssctpr::bedBytes(N), read);
   return genotypes;
 }
 
+//' Builds the sample-major cache of a bed file
+//' 
+//' @param fileName location of bed file
+//' @param N number of subjects 
+//' @param P number of positions 
+//' @param tileVariants number of variants per tile (a multiple of 4)
+//' @return the file name of the cache
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+std::string sampleMajorCache(const std::string fileName, int N, int P, 
+                             int tileVariants) {
+  
+  ScopedPhase phase("decode");
+  ssctpr::buildSampleMajorCache(fileName, N, P, tileVariants);
+  phase.add((double) P * ssctpr::bedBytes(N), P);
+  return ssctpr::sampleMajorCacheName(fileName);
+}
+
 
 //' normalize genotype matrix
 //' 
@@ -668,16 +270,12 @@ arma::mat genotypeMatrix(const std::string fileName, int N, int P,
 // [[Rcpp::export]]
 arma::vec normalize(arma::mat &genotypes)
 {
+  ScopedPhase phase("normalize");
   int k = genotypes.n_cols;
   int n = genotypes.n_rows;
+  phase.add(8.0 * n * k, k);
   arma::vec sd(k);
-  for (int i = 0; i < k; ++i) {
-    double m = arma::mean(genotypes.col(i));
-    arma::vec mm(n); mm.fill(m);
-    sd(i) = arma::stddev(genotypes.col(i));
-    // sd(i) = 1.0;
-    genotypes.col(i) = arma::normalise(genotypes.col(i) - mm);
-  }
+  ssctpr::normalize(genotypes.memptr(), n, k, sd.memptr());
   return sd; 
 }
 
@@ -701,7 +299,46 @@ arma::vec normalize(arma::mat &genotypes)
 //' @param maxiter maximal number of iterations
 //' @param startvec start position for each block
 //' @param endvec end position for each block
-//' @return a list of results
+//' @param sketch sketch size (or rank, 0: chosen from \code{variance}) of 
+//' each block (empty: no sketch)
+//' @param sketchMethod 0 = SRHT, 1 = sparse JL, 2 = low rank plus diagonal 
+//' (truncated randomized SVD)
+//' @param seed seed of the random projections (and of \code{subsample})
+//' @param sparse use a sparse LD matrix (pairs within \code{window} or with 
+//' r2 at least \code{r2})
+//' @param r2 r2 threshold of the sparse LD matrix
+//' @param window window of the sparse LD matrix (0: none)
+//' @param pos positions of the variants for \code{window}
+//' @param ldFile file the sparse LD matrix is read from if it matches, and 
+//' written to otherwise ("": not persisted)
+//' @param variance fraction of the variance of a block explained by the 
+//' automatic rank of \code{sketchMethod} 2
+//' @param solver block solver: 0 = coordinate descent, 1 = FISTA, 2 = coordinate 
+//' descent with FISTA where it does not converge, 3 = FISTA on the blocks at least 
+//' as wide as fistaVariants() and coordinate descent on the others (not used with 
+//' a sparse LD matrix)
+//' @param ridge start the blocks from their closed form ridge solution where it 
+//' has a lower objective than the warm start (full panel only)
+//' @param subsample number of reference samples of a coarse panel the blocks 
+//' without a warm start are first solved on, to start from that solution 
+//' where it has a lower objective (0: none; full panel only)
+//' @param carriers largest fraction of samples away from the most common 
+//' genotype of a variant solved on its carrier list (0: none; full panel only)
+//' @return a list of results, including \code{telemetry}, a data.frame with 
+//' one row per block and lambda giving the number of sweeps, coordinate updates, 
+//' the final maximum change, the active set size, the wall time (seconds), 
+//' the stopping rule (\code{"thr"}, \code{"plateau"} or \code{"maxiter"}), 
+//' whether the block started from its ridge solution or from its solution on 
+//' the coarse panel, the sweeps and time of the coarse solve and the 
+//' objective of the coarse solution minus the final one, 
+//' and with a sketch, \code{sketch}, a data.frame with the sketch size and 
+//' the estimated relative error of the LD matrix of each block, and with a 
+//' sparse LD matrix, \code{ld}, a data.frame with the number of stored 
+//' correlations and the factor the off-diagonal correlations were shrunk by 
+//' of each block, or with a low-rank panel, \code{ld}, a data.frame with the 
+//' rank, the fraction of variance explained and the estimated relative error 
+//' of the LD matrix of each block, and with \code{carriers}, \code{carriers}, 
+//' the number of variants solved on their carrier list
 //' @keywords internal
 //'  
 // [[Rcpp::export]]
@@ -710,79 +347,348 @@ List runElnet(arma::vec& lambda, double shrink, double lambda_ct, const std::str
               arma::Col<int>& col_skip_pos, arma::Col<int>& col_skip, 
               arma::Col<int>& keepbytes, arma::Col<int>& keepoffset, 
               double thr, arma::vec& x, int trace, int maxiter, 
-              arma::Col<int>& startvec, arma::Col<int>& endvec) {
+              arma::Col<int>& startvec, arma::Col<int>& endvec, 
+              arma::Col<int>& sketch, int sketchMethod, double seed, 
+              bool sparse, double r2, double window, arma::vec& pos, 
+              const std::string ldFile, double variance, int solver, 
+              bool ridge, int subsample, double carriers) {
   // a) read bed file
-  // b) standardize genotype matrix
+  // b) standardize genotype matrix (and sketch, truncate or threshold it by blocks)
   // c) multiply by constant factor
-  // d) perform elnet
+  // d) perform elnet (ssctpr::elnetPath, ssctpr::elnetPathSketched or 
+  //    ssctpr::elnetPathSparse)
   
   Rcout << "runElnet" << std::endl;
-  int i,j;
-  //int traits = r.n_cols; // number of traits, including the primary one
-  
-  arma::mat genotypes = genotypeMatrix(fileName, N, P, col_skip_pos, col_skip, keepbytes,
-                                       keepoffset, 1);
-  //Rcout << "Yingxi: (a) in runElnet" << std::endl;
-  int p = genotypes.n_cols;
-  if (genotypes.n_cols != r.n_rows) {
-    throw std::runtime_error("Number of positions in reference file is not "
-                               "equal the number of regression coefficients");
-  }
-  
-  arma::vec sd = normalize(genotypes);
-  //Rcout << "Yingxi: (b) in runElnet" << std::endl;
-  
-  genotypes *= sqrt(1.0 - shrink); // \tilde{X} in ms
-  //Rcout << "Yingxi: (c) in runElnet" << std::endl;
-  
-  arma::Col<int> conv(lambda.n_elem);
-  int len = r.n_rows; // number of variants
-  
-  arma::mat beta(len, lambda.n_elem);
-  arma::mat pred(genotypes.n_rows, lambda.n_elem); pred.zeros();
-  arma::vec out(lambda.n_elem);
-  arma::vec loss(lambda.n_elem);
-  arma::vec diag(r.n_rows); diag.fill(1.0 - shrink); 
   
-  for(j=0; j < diag.n_elem; j++) {
-    if(sd(j) == 0.0) diag(j) = 0.0;
-  }
-  
-  arma::vec fbeta(lambda.n_elem);
-  arma::vec yhat(genotypes.n_rows);
-  // yhat = genotypes * x;
-  
-  // Rcout << "Yingxi: Starting loop" << std::endl;
-  for (i = 0; i < lambda.n_elem; ++i) {
-    if (trace > 0)
-      Rcout << "lambda: " << lambda(i) << "\n" << std::endl;
-    out(i) =
-      repelnet(lambda(i), shrink, lambda_ct, diag,genotypes, r, adj, thr, x, yhat, trace-1, maxiter, 
-               startvec, endvec);
-    beta.col(i) = x;
-    for(j=0; j < r.n_rows; j++) {
-      if(sd(j) == 0.0) {
-        beta(j,i) *= shrink;
+  ssctpr::ElnetPath path;
+  arma::vec sd;
+  int n, p;
+  DataFrame sketchReport, ldReport;
+  if (sparse) {
+    const ssctpr::BedSelection sel = bedSelection(col_skip_pos, col_skip, 
+                                                  keepbytes, keepoffset);
+    n = ssctpr::selectedSamples(N, sel);
+    p = ssctpr::selectedVariants(P, sel);
+    if (p != (int) r.n_rows) {
+      throw std::runtime_error("Number of positions in reference file is not "
+                                 "equal the number of regression coefficients");
+    }
+    if (window > 0 && (int) pos.n_elem != p) {
+      throw std::runtime_error("One position is needed per variant");
+    }
+    ssctpr::SparseLD ld;
+    {
+      ScopedPhase phase("decode");
+      ScopedPerf perf("decode");
+      if (ldFile.empty() || 
+          !ssctpr::readSparseLD(ldFile, fileName, N, P, sel, startvec.memptr(), 
+                                endvec.memptr(), startvec.n_elem, window, r2, 
+                                ld)) {
+        phase.add((double) p * ssctpr::bedBytes(N), p);
+        ssctpr::sparseLD(fileName, N, P, sel, startvec.memptr(), 
+                         endvec.memptr(), startvec.n_elem, pos.memptr(), 
+                         window, r2, ld);
+        if (!ldFile.empty()) ssctpr::writeSparseLD(ldFile, ld);
       }
     }
-    //if (out(i) != 1) {
-    //  Rcout << "Yingxi: Not converging..." << std::endl;
-    //}
-    pred.col(i) = yhat;
-    loss(i) = arma::as_scalar(arma::sum(arma::pow(yhat, 2)) - 2.0 * arma::sum(x % r.col(0)));   
-    fbeta(i) =
-      arma::as_scalar(loss(i) + 2.0 * arma::sum(arma::abs(x)) * lambda(i) +
-      arma::sum(arma::pow(x, 2)) * shrink);
+    {
+      ScopedPhase phase("solve");
+      ScopedPerf perf("elnet");
+      phase.add(0, (double) p * lambda.n_elem);
+      ssctpr::elnetPathSparse(lambda.memptr(), lambda.n_elem, shrink, 
+                              lambda_ct, ld, r.memptr(), r.n_cols, 
+                              adj.memptr(), thr, x.memptr(), trace, maxiter, 
+                              path);
+    }
+    {
+      ScopedPhase phase("score");
+      ScopedPerf perf("score");
+      phase.add((double) p * ssctpr::bedBytes(N), p);
+      ssctpr::panelPredictions(fileName, N, P, sel, lambda.memptr(), 
+                               lambda.n_elem, shrink, r.memptr(), 
+                               &ld.mean[0], &ld.sd[0], p, path);
+    }
+    sd = arma::vec(ld.sd);
+    std::vector<int> block(startvec.n_elem);
+    std::vector<double> nnz(startvec.n_elem);
+    for (size_t b = 0; b < block.size(); b++) {
+      block[b] = b + 1;
+      nnz[b] = ld.rowptr[endvec[b] + 1] - ld.rowptr[startvec[b]];
+    }
+    ldReport = DataFrame::create(Named("block") = block, 
+                                 Named("nnz") = nnz, 
+                                 Named("offdiag") = ld.offdiag, 
+                                 Named("smallest") = ld.smallest);
+  } else if (sketch.n_elem > 0) {
+    const ssctpr::BedSelection sel = bedSelection(col_skip_pos, col_skip, 
+                                                  keepbytes, keepoffset);
+    n = ssctpr::selectedSamples(N, sel);
+    p = ssctpr::selectedVariants(P, sel);
+    if (p != (int) r.n_rows) {
+      throw std::runtime_error("Number of positions in reference file is not "
+                                 "equal the number of regression coefficients");
+    }
+    if (sketch.n_elem != startvec.n_elem) {
+      throw std::runtime_error("One sketch size is needed per block");
+    }
+    ssctpr::SketchedPanel panel;
+    {
+      ScopedPhase phase("decode");
+      ScopedPerf perf("decode");
+      phase.add((double) p * ssctpr::bedBytes(N), p);
+      if (sketchMethod == 2) {
+        ssctpr::lowRankGenotypes(fileName, N, P, sel, startvec.memptr(), 
+                                 endvec.memptr(), startvec.n_elem, 
+                                 sketch.memptr(), variance, 
+                                 (unsigned long long) seed, panel);
+      } else {
+        ssctpr::sketchGenotypes(fileName, N, P, sel, startvec.memptr(), 
+                                endvec.memptr(), startvec.n_elem, 
+                                sketch.memptr(), sketchMethod, 
+                                (unsigned long long) seed, panel);
+      }
+    }
+    const double scale = sqrt(1.0 - shrink); // \tilde{X} in ms
+    for (size_t i = 0; i < panel.X.size(); i++) panel.X[i] *= scale;
+    {
+      ScopedPhase phase("solve");
+      ScopedPerf perf("elnet");
+      phase.add(0, (double) p * lambda.n_elem);
+      ssctpr::elnetPathSketched(lambda.memptr(), lambda.n_elem, shrink, 
+                                lambda_ct, panel, p, r.memptr(), r.n_cols, 
+                                adj.memptr(), thr, x.memptr(), trace, maxiter, 
+                                solver, startvec.memptr(), endvec.memptr(), 
+                                startvec.n_elem, path);
+    }
+    {
+      ScopedPhase phase("score");
+      ScopedPerf perf("score");
+      phase.add((double) p * ssctpr::bedBytes(N), p);
+      ssctpr::panelPredictions(fileName, N, P, sel, lambda.memptr(), 
+                               lambda.n_elem, shrink, r.memptr(), 
+                               &panel.mean[0], &panel.sd[0], p, path);
+    }
+    sd = arma::vec(panel.sd);
+    std::vector<int> block(startvec.n_elem);
+    for (size_t b = 0; b < block.size(); b++) block[b] = b + 1;
+    if (sketchMethod == 2) {
+      ldReport = DataFrame::create(Named("block") = block, 
+                                   Named("k") = panel.k, 
+                                   Named("variance") = panel.variance, 
+                                   Named("ld.error") = panel.lderror);
+    } else {
+      sketchReport = DataFrame::create(Named("block") = block, 
+                                       Named("k") = panel.k, 
+                                       Named("ld.error") = panel.lderror);
+    }
+  } else {
+    arma::mat genotypes = genotypeMatrix(fileName, N, P, col_skip_pos, col_skip, 
+                                         keepbytes, keepoffset, 1);
+    n = genotypes.n_rows;
+    p = genotypes.n_cols;
+    if (genotypes.n_cols != r.n_rows) {
+      throw std::runtime_error("Number of positions in reference file is not "
+                                 "equal the number of regression coefficients");
+    }
+    
+    sd = normalize(genotypes);
+    
+    ScopedPhase phase("solve");
+    ScopedPerf perf("elnet");
+    phase.add(0, (double) p * lambda.n_elem);
+    ssctpr::RidgeBasis basis;
+    if (ridge) {
+      ssctpr::ridgeBasis(genotypes.memptr(), sd.memptr(), n, p, 
+                         startvec.memptr(), endvec.memptr(), startvec.n_elem, 
+                         basis);
+    }
+    
+    genotypes *= sqrt(1.0 - shrink); // \tilde{X} in ms
     
-    //for(int tt=1; tt<traits; tt++){
-    //  fbeta(i)+=(lambda_ct*arma::sum(arma::pow(r.col(tt)-x,2)));
-    //} need to modify??
+    ssctpr::elnetPath(lambda.memptr(), lambda.n_elem, shrink, lambda_ct, 
+                      genotypes.memptr(), sd.memptr(), n, p, 
+                      r.memptr(), r.n_cols, adj.memptr(), thr, x.memptr(), 
+                      trace, maxiter, solver, ridge ? &basis : 0, subsample, 
+                      (unsigned long long) seed, carriers, startvec.memptr(), 
+                      endvec.memptr(), startvec.n_elem, path);
   }
-  return List::create(Named("lambda") = lambda, 
-                      Named("beta") = beta,
-                      Named("conv") = out,
-                      Named("pred") = pred,
-                      Named("loss") = loss, 
-                      Named("fbeta") = fbeta, 
-                      Named("sd")= sd);
+  
+  arma::mat beta(path.beta.data(), p, lambda.n_elem);
+  arma::mat pred(path.pred.data(), n, lambda.n_elem);
+  arma::vec out(lambda.n_elem);
+  for(int i=0; i < (int) lambda.n_elem; i++) out(i) = path.conv[i];
+  
+  std::vector<int> telblock, telsweeps, telactive;
+  std::vector<double> tellambda, telupdates, telmaxdelta, teltime;
+  std::vector<std::string> telstop;
+  std::vector<bool> telridge, telcoarse;
+  std::vector<int> telcoarsesweeps;
+  std::vector<double> telcoarsetime, telcoarsegap;
+  const char* stopnames[] = {"maxiter", "thr", "plateau"};
+  for(size_t j=0; j < path.tel.size(); j++) {
+    const ssctpr::ElnetTelemetry& tel = path.tel[j];
+    // blocks are numbered from 1 within each lambda
+    telblock.push_back(j == 0 || path.tellambda[j] != path.tellambda[j-1] ? 
+                       1 : telblock.back() + 1);
+    tellambda.push_back(lambda(path.tellambda[j]));
+    telsweeps.push_back(tel.sweeps);
+    telupdates.push_back(tel.updates);
+    telmaxdelta.push_back(tel.maxdelta);
+    telactive.push_back(tel.active);
+    teltime.push_back(tel.time);
+    telstop.push_back(stopnames[tel.stop]);
+    telridge.push_back(tel.ridge);
+    telcoarse.push_back(tel.coarse);
+    telcoarsesweeps.push_back(tel.coarsesweeps);
+    telcoarsetime.push_back(tel.coarsetime);
+    telcoarsegap.push_back(tel.coarsegap);
+  }
+  DataFrame telemetry = DataFrame::create(Named("block") = telblock, 
+                                          Named("lambda") = tellambda, 
+                                          Named("sweeps") = telsweeps, 
+                                          Named("updates") = telupdates, 
+                                          Named("maxdelta") = telmaxdelta, 
+                                          Named("active") = telactive, 
+                                          Named("time") = teltime, 
+                                          Named("stop") = telstop, 
+                                          Named("ridge") = telridge, 
+                                          Named("coarse") = telcoarse, 
+                                          Named("coarse.sweeps") = telcoarsesweeps, 
+                                          Named("coarse.time") = telcoarsetime, 
+                                          Named("coarse.gap") = telcoarsegap, 
+                                          Named("stringsAsFactors") = false);
+  List result = List::create(Named("lambda") = lambda, 
+                             Named("beta") = beta,
+                             Named("conv") = out,
+                             Named("pred") = pred,
+                             Named("loss") = path.loss, 
+                             Named("fbeta") = path.fbeta, 
+                             Named("sd")= sd, 
+                             Named("telemetry") = telemetry);
+  if (sketch.n_elem > 0 && sketchMethod != 2) result.push_back(sketchReport, "sketch");
+  if (sparse || (sketch.n_elem > 0 && sketchMethod == 2)) result.push_back(ldReport, "ld");
+  if (carriers > 0) result.push_back(path.carriers, "carriers");
+  return result;
+}
+
+//' Set the native thread budget of the process
+//' 
+//' @param threads threads of the kernels (the block-parallel solves), or 0 to 
+//' keep the current budget
+//' @param blas threads of the BLAS and OpenMP outside the kernels, or 0 to 
+//' keep them
+//' @return the budget before the call, \code{threads} and \code{blas} 
+//' (\code{blas} is 0 if no BLAS with a thread setting is loaded)
+//' @details The kernel threads are a persistent pool, started on first use 
+//' and reused by later calls; only the block-parallel solves use it. The 
+//' kernels make no BLAS calls, so \code{blas} only matters to other code 
+//' in the process, e.g. to keep the BLAS of cluster workers single-threaded. 
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+IntegerVector threadBudget(int threads, int blas) {
+  IntegerVector previous = IntegerVector::create(Named("threads") = ssctpr::threads(), 
+                                                 Named("blas") = ssctpr::blasThreads());
+  if (threads > 0) ssctpr::setThreads(threads);
+  if (blas > 0) ssctpr::setBlasThreads(blas);
+  return previous;
+}
+
+// Joins the workers of the kernels before the library is unloaded
+extern "C" void R_unload_ssCTPR(DllInfo*) {
+  ssctpr::setThreads(1);
+}
+
+//' Set the block width from which solver "tuned" uses FISTA
+//' 
+//' @param variants width (variants) of the smallest block solved with FISTA, 
+//' 0 for coordinate descent on every block, or negative to keep the setting
+//' @return the width before the call
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+int fistaVariants(int variants) {
+  const int previous = ssctpr::fistaVariants();
+  if (variants >= 0) ssctpr::setFistaVariants(variants);
+  return previous;
+}
+
+//' Write columns of weights to a weights file
+//' 
+//' @param fileName the weights file (compressed sparse column)
+//' @param weights a matrix of weights, one column per lambda
+//' @param column first column written (0-based): the columns of the file 
+//' from it on are discarded, and 0 starts a new file
+//' @return the number of columns in the file
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+int writeWeights(const std::string fileName, arma::mat& weights, int column) {
+  return ssctpr::writeWeights(fileName, weights.memptr(), weights.n_rows, 
+                              weights.n_cols, column);
+}
+
+//' Read columns of a weights file
+//' 
+//' @param fileName the weights file
+//' @param columns the columns to read (0-based)
+//' @return a list of \code{rows} and \code{columns} (of the file) and the 
+//' compressed sparse column arrays \code{p}, \code{i} (0-based) and \code{x} 
+//' of the columns read
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+List readWeights(const std::string fileName, IntegerVector columns) {
+  int rows;
+  long long ncol;
+  std::vector<long long> colptr;
+  std::vector<int> row;
+  std::vector<double> value;
+  ssctpr::readWeights(fileName, columns.begin(), columns.size(), rows, ncol, 
+                      colptr, row, value);
+  return List::create(Named("rows") = rows, 
+                      Named("columns") = (double) ncol, 
+                      Named("p") = NumericVector(colptr.begin(), colptr.end()), 
+                      Named("i") = row, 
+                      Named("x") = value);
+}
+
+//' Write columns of scores to a scores file
+//' 
+//' @param fileName the scores file (column-major, with a sample index)
+//' @param scores a matrix of scores, one row per sample
+//' @param samples the rows of the .fam file of the samples (0-based)
+//' @param column first column written (0-based): the columns of the file 
+//' from it on are discarded, and 0 starts a new file
+//' @return the number of columns in the file
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+int writeScores(const std::string fileName, arma::mat& scores, 
+                IntegerVector samples, int column) {
+  if (samples.size() != (int) scores.n_rows) 
+    throw std::runtime_error("There must be one sample per row of scores");
+  return ssctpr::writeScores(fileName, scores.memptr(), samples.begin(), 
+                             scores.n_rows, scores.n_cols, column);
+}
+
+//' Read columns of a scores file
+//' 
+//' @param fileName the scores file
+//' @param columns the columns to read (0-based)
+//' @return a list of \code{samples} (the rows of the .fam file, 0-based), 
+//' \code{columns} (of the file) and the matrix of \code{scores} read
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+List readScores(const std::string fileName, IntegerVector columns) {
+  long long ncol;
+  std::vector<int> samples;
+  std::vector<double> scores;
+  ssctpr::readScores(fileName, columns.begin(), columns.size(), ncol, 
+                     samples, scores);
+  arma::mat m(scores.data(), samples.size(), columns.size());
+  return List::create(Named("samples") = samples, 
+                      Named("columns") = (double) ncol, 
+                      Named("scores") = m);
 }
@@ -0,0 +1,3480 @@
+/**
+ ssCTPR
+ kernels.cpp
+ Purpose: R-free kernels (BED decode, standardization, elnet, scoring)
+
+ @author Yingxi Yang
+
+ Reference: Mak et al (2017) Polygenic scores via penalized regression on summary statistics. Genetic Epidemiology 41(6) 469-480.
+
+ */
+
+#include <string>
+#include <bitset>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+// pext is dispatched at run time (see compactPext)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SSCTPR_PEXT 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+#include "kernels.h"
+
+namespace ssctpr {
+
+namespace {
+
+InterruptHook interruptHook = 0;
+std::atomic<bool> cancelFlag(false);
+// state of the polling thread
+std::thread::id pollingThread = std::this_thread::get_id();
+std::chrono::steady_clock::time_point lastPoll;
+bool polled = false;
+bool hookCancelled = false;
+int progressShown = -1;
+// progress of the open Progress with report
+std::atomic<int> progressCalls(0);
+std::atomic<long long> progressTotal(0), progressDone(0);
+std::ostream* messageStream = 0;
+std::ostream* warningStream = 0;
+
+struct NullBuffer : public std::streambuf {
+  int overflow(int c) { return c; }
+};
+NullBuffer nullBuffer;
+std::ostream nullStream(&nullBuffer);
+
+std::ostream& messages() {
+  const bool polling = std::this_thread::get_id() == pollingThread;
+  return messageStream && polling ? *messageStream : nullStream;
+}
+
+std::ostream& warnings() {
+  const bool polling = std::this_thread::get_id() == pollingThread;
+  return warningStream && polling ? *warningStream : nullStream;
+}
+
+void openSnpMajor(const std::string& fileName, std::ifstream& bedFile) {
+  bool snpMajor = openPlinkBinaryFile(fileName, bedFile);
+  if (!snpMajor)
+    throw std::runtime_error("We currently have no plans of implementing the "
+                               "individual-major mode. Please use the snp-major "
+                               "format");
+}
+
+/**
+ Bits of a byte kept by a 4-bit sample mask, packed to the low end: the
+ portable fallback of pext
+
+ */
+struct CompactTable {
+  unsigned char bits[16][256];
+  CompactTable() {
+    for (int m = 0; m < 16; m++) {
+      for (int b = 0; b < 256; b++) {
+        int out = 0, k = 0;
+        for (int s = 0; s < 4; s++) {
+          if (!(m >> s & 1)) continue;
+          out |= (b >> (2 * s) & 3) << k;
+          k += 2;
+        }
+        bits[m][b] = out;
+      }
+    }
+  }
+};
+
+/**
+ Dosages of the 4 samples of a BED byte (value) and of a 2-bit BED code
+ (code), with missing genotypes decoded as missing, so that the decode
+ loops do not test the missing policy per sample
+
+ */
+struct DosageTable {
+  double value[256][4];
+  double code[4];
+  explicit DosageTable(double missing) {
+    code[0] = 2.0;
+    code[1] = missing;
+    code[2] = 1.0;
+    code[3] = 0.0;
+    for (int b = 0; b < 256; b++)
+      for (int c = 0; c < 4; c++) value[b][c] = code[b >> (2 * c) & 3];
+  }
+};
+
+/**
+ Decodes the rowN samples of a packed BED row r into col: whole bytes
+ without a test per sample, then the samples of the last partial byte
+
+ */
+void decodeRow(const unsigned char* r, int rowN, const DosageTable& dosages,
+               double* col) {
+  const int full = rowN >> 2;
+  for (int b = 0; b < full; b++) {
+    const double* d = dosages.value[r[b]];
+    col[0] = d[0];
+    col[1] = d[1];
+    col[2] = d[2];
+    col[3] = d[3];
+    col += 4;
+  }
+  for (int c = 0; c < (rowN & 3); c++) col[c] = dosages.value[r[full]][c];
+}
+
+/**
+ Does the CPU have a fast pext? BMI2, but not AMD (or Hygon) before Zen 3
+ (family 0x19), which runs pext in microcode.
+
+ */
+bool fastPext() {
+#if defined(SSCTPR_PEXT)
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("bmi2")) return false;
+  unsigned int a, b, c, d;
+  if (!__get_cpuid(0, &a, &b, &c, &d)) return false;
+  const bool amd = b == 0x68747541 || b == 0x6f677948; // "Auth", "Hygo"
+  if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+  int family = (a >> 8) & 0xf;
+  if (family == 0xf) family += (a >> 20) & 0xff;
+  return !amd || family >= 0x19;
+#else
+  return false;
+#endif
+}
+
+std::atomic<bool> pextOn(fastPext());
+
+/**
+ Decode plan of a keep subset, compiled once per kernel call. compact() packs
+ the kept samples of a row into a row of n samples in the BED coding, which
+ then goes through the full-row decode. With pext (compactPext) the plan
+ holds the 64-bit words (32 samples) of a BED row with kept samples and
+ their pext masks; otherwise it holds the bytes with kept samples and their
+ 4-bit sample masks for CompactTable. Keep subsets out of file order
+ (ordered() is false) are gathered sample by sample into the same row, so
+ that the kernels decode and score every keep subset alike.
+
+ */
+class KeepPlan {
+public:
+  KeepPlan(int N, const BedSelection& sel)
+    : N_(N), ordered_(sel.nkeep > 0), pext_(compactPext()), sel_(sel) {
+    int last = -1;
+    for (int j = 0; j < sel.nkeep && ordered_; j++) {
+      const int pos = sel.keepbytes[j] * 4 + sel.keepoffset[j] / 2;
+      ordered_ = pos > last && pos < N;
+      last = pos;
+      const int unit = pext_ ? pos / 32 : pos / 4;
+      const unsigned long long mask = pext_ ? 3ULL << (pos % 32 * 2) :
+        1ULL << (pos % 4);
+      if (units_.empty() || units_.back() != unit) {
+        units_.push_back(unit);
+        masks_.push_back(0);
+        bits_.push_back(0);
+      }
+      masks_.back() |= mask;
+      bits_.back() += 2;
+    }
+  }
+
+  bool ordered() const { return ordered_; }
+
+  // out: at least bedBytes(nkeep) + 8 bytes
+  void compact(const char* in, char* out) const {
+    const unsigned char* row = (const unsigned char*) in;
+    unsigned char* dest = (unsigned char*) out;
+    if (!ordered_) {
+      std::memset(dest, 0, bedBytes(sel_.nkeep));
+      for (int j = 0; j < sel_.nkeep; j++) {
+        const int code = row[sel_.keepbytes[j]] >> sel_.keepoffset[j] & 3;
+        dest[j >> 2] |= code << ((j & 3) * 2);
+      }
+      return;
+    }
+#if defined(SSCTPR_PEXT)
+    if (pext_) {
+      compactWords(row, dest);
+      return;
+    }
+#endif
+    static const CompactTable table;
+    unsigned long long acc = 0;
+    int used = 0;
+    for (size_t u = 0; u < units_.size(); u++) {
+      acc |= (unsigned long long) table.bits[masks_[u]][row[units_[u]]] << used;
+      used += bits_[u];
+      if (used >= 56) {
+        for (; used >= 8; used -= 8, acc >>= 8) *dest++ = acc;
+      }
+    }
+    for (int b = 0; b * 8 < used; b++) *dest++ = acc >> (8 * b);
+  }
+
+private:
+  int N_;
+  bool ordered_, pext_;
+  BedSelection sel_;
+  std::vector<int> units_;
+  std::vector<unsigned long long> masks_;
+  std::vector<int> bits_;
+
+#if defined(SSCTPR_PEXT)
+  __attribute__((target("bmi2")))
+  void compactWords(const unsigned char* row, unsigned char* dest) const {
+    unsigned long long acc = 0;
+    int used = 0;
+    const unsigned long long Nbytes = bedBytes(N_);
+    for (size_t w = 0; w < units_.size(); w++) {
+      // little-endian load of the word, which may be the partial last one
+      const unsigned long long first = (unsigned long long) units_[w] * 8;
+      const int len = std::min(8ULL, Nbytes - first);
+      unsigned long long x = 0;
+      for (int b = 0; b < len; b++) x |= (unsigned long long) row[first + b] << (8 * b);
+      const unsigned long long v = _pext_u64(x, masks_[w]);
+      const int k = bits_[w];
+      acc |= v << used;
+      if (used + k >= 64) {
+        for (int b = 0; b < 8; b++) *dest++ = acc >> (8 * b);
+        acc = used ? v >> (64 - used) : 0;
+        used += k - 64;
+      } else {
+        used += k;
+      }
+    }
+    for (int b = 0; b * 8 < used; b++) *dest++ = acc >> (8 * b);
+  }
+#endif
+};
+
+/**
+ Header of the sample-major cache, followed by the tiles: N rows of
+ tileVariants / 4 bytes each (the last tile is padded)
+
+ */
+struct SampleMajorHeader {
+  char magic[8];
+  int version, N, P, tileVariants;
+  unsigned long long bedSize; // to detect a changed BED file
+};
+const char sampleMajorMagic[8] = {'s', 's', 'C', 'T', 'P', 'R', 's', 'm'};
+const int sampleMajorVersion = 1;
+
+// Scattered row reads cost this many times more per byte than streaming
+// whole variants
+const double sampleMajorReadCost = 4.0;
+
+/**
+ Opens the sample-major cache of fileName and reads its header
+
+ @return false if there is no cache, or it does not match the BED file
+ (then with a warning)
+
+ */
+bool openSampleMajorCache(const std::string& fileName, int N, int P,
+                          std::ifstream& in, SampleMajorHeader& h) {
+  const std::string cacheName = sampleMajorCacheName(fileName);
+  struct stat cache, bed;
+  if (stat(cacheName.c_str(), &cache) != 0) return false;
+  if (stat(fileName.c_str(), &bed) != 0) return false;
+  in.open(cacheName.c_str(), std::ios::in | std::ios::binary);
+  in.read((char*) &h, sizeof(h));
+  bool ok = in && std::memcmp(h.magic, sampleMajorMagic, 8) == 0 &&
+    h.version == sampleMajorVersion && h.N == N && h.P == P &&
+    h.tileVariants > 0 && h.tileVariants % 4 == 0 &&
+    h.bedSize == (unsigned long long) bed.st_size &&
+    cache.st_mtime >= bed.st_mtime;
+  if (ok) {
+    const unsigned long long tiles = (P + h.tileVariants - 1) / h.tileVariants;
+    ok = (unsigned long long) cache.st_size ==
+      sizeof(h) + tiles * N * (h.tileVariants / 4);
+  }
+  if (!ok) {
+    warnings() << "Ignoring " << cacheName
+               << ", which does not match " << fileName << std::endl;
+  }
+  return ok;
+}
+
+void requireSampleMajorCache(const std::string& fileName, int N, int P,
+                             std::ifstream& in, SampleMajorHeader& h) {
+  if (!openSampleMajorCache(fileName, N, P, in, h))
+    throw std::runtime_error("No up to date sample-major cache of " + fileName);
+}
+
+/**
+ Samples (rows of the BED file) read under a selection
+
+ */
+std::vector<int> keptSamples(int N, const BedSelection& sel) {
+  std::vector<int> samples(selectedSamples(N, sel));
+  for (size_t j = 0; j < samples.size(); j++) {
+    samples[j] = (sel.nkeep > 0) ?
+      sel.keepbytes[j] * 4 + sel.keepoffset[j] / 2 : (int) j;
+  }
+  return samples;
+}
+
+/**
+ Output column of each variant of the BED file, -1 if skipped
+
+ */
+std::vector<int> selectedColumns(int P, const BedSelection& sel) {
+  std::vector<int> column(P, -1);
+  int ii = 0, iii = 0;
+  for (int i = 0; i < P; ) {
+    if (ii < sel.nskip && i == sel.col_skip_pos[ii]) {
+      i += sel.col_skip[ii];
+      ii++;
+      continue;
+    }
+    column[i++] = iii++;
+  }
+  return column;
+}
+
+/**
+ Reads the rows of the samples in tile t, merging runs of consecutive
+ samples into one read
+
+ @rows samples.size() x (tileVariants / 4) bytes, row by row
+
+ */
+void readTileRows(std::ifstream& in, const SampleMajorHeader& h, int t,
+                  const std::vector<int>& samples, std::vector<unsigned char>& rows) {
+  const unsigned long long rowBytes = h.tileVariants / 4;
+  const unsigned long long tile = sizeof(h) + (unsigned long long) t * h.N * rowBytes;
+  rows.resize(samples.size() * rowBytes);
+  size_t j = 0;
+  while (j < samples.size()) {
+    size_t run = 1;
+    while (j + run < samples.size() && samples[j + run] == samples[j] + (int) run) run++;
+    in.seekg(tile + samples[j] * rowBytes);
+    in.read((char*) &rows[j * rowBytes], run * rowBytes);
+    if (!in)
+      throw std::runtime_error("Problem with the sample-major cache...has the "
+                                 "BED file been changed?");
+    j += run;
+  }
+}
+
+/**
+ Whether genotypeMatrix (nonzeros = 0) or multiBed3sp should read the
+ sample-major cache rather than the BED file
+
+ */
+bool preferSampleMajor(const std::string& fileName, int N, int P,
+                       const BedSelection& sel, const int* nonzeros, int nvariants) {
+  if (sel.nkeep == 0) return false;
+  std::ifstream in;
+  SampleMajorHeader h;
+  if (!openSampleMajorCache(fileName, N, P, in, h)) return false;
+  const std::vector<int> column = selectedColumns(P, sel);
+  const int V = h.tileVariants;
+  long long tiles = 0, variants = 0;
+  for (int v0 = 0; v0 < P; v0 += V) {
+    bool used = false;
+    for (int v = v0; v < std::min(P, v0 + V); v++) {
+      const int c = column[v];
+      if (c < 0) continue;
+      variants++;
+      used = used || !nonzeros || (c < nvariants && nonzeros[c] > 0);
+    }
+    tiles += used;
+  }
+  const double cache = (double) tiles * sel.nkeep * (V / 4);
+  return sampleMajorReadCost * cache < (double) variants * bedBytes(N);
+}
+
+/**
+ Adds the weights beta[k, k + nz) of one variant, times the dosages of the
+ rowN samples of its packed row r, to their columns colpos of result (n
+ rows). Bytes of four samples of the most common homozygous genotype are
+ skipped, so that a rare variant costs about its number of carriers: if it
+ is homozygous A1 (dosage 2), 2 * beta is added to offset[colpos] instead,
+ to be added to every row at the end, and the other samples get their
+ dosage minus 2.
+
+ */
+void scoreVariant(const unsigned char* r, int rowN, const double* beta,
+                  const int* colpos, int k, int nz, int n, double* result,
+                  double* offset) {
+  const int full = rowN >> 2;
+  int ones = 0, zeros = 0;
+  for (int b = 0; b < full; b++) {
+    ones += r[b] == 0xFF;
+    zeros += r[b] == 0x00;
+  }
+  const bool a1major = zeros > ones;
+  const unsigned char skip = a1major ? 0x00 : 0xFF;
+  if (a1major) {
+    for (int kk = k; kk < k + nz; kk++) offset[colpos[kk]] += 2 * beta[kk];
+  }
+  for (int b = 0; b < (rowN + 3) >> 2; b++) {
+    if (b < full && r[b] == skip) continue;
+    const int end = std::min(rowN, 4 * b + 4);
+    for (int j = 4 * b; j < end; j++) {
+      const int code = r[b] >> ((j & 3) * 2) & 3;
+      // missing or homozygous A2 have dosage 0
+      const int dosage = ((code & 1) ? 0 : 2 - (code >> 1)) - (a1major ? 2 : 0);
+      if (dosage == 0) continue;
+      for (int kk = k; kk < k + nz; kk++)
+        result[j + (size_t) colpos[kk] * n] += dosage * beta[kk];
+    }
+  }
+}
+
+/**
+ Adds offset[c] to the n rows of column c of result
+
+ */
+void addColumnOffsets(const std::vector<double>& offset, int n, double* result) {
+  for (size_t c = 0; c < offset.size(); c++) {
+    if (offset[c] == 0.0) continue;
+    double* col = result + c * n;
+    for (int j = 0; j < n; j++) col[j] += offset[c];
+  }
+}
+
+/**
+ Selection of the selected variants [from, to] (numbered as in the output
+ of genotypeMatrix); pos and len hold its col_skip_pos and col_skip
+
+ */
+BedSelection columnRange(int P, const BedSelection& sel,
+                         const std::vector<int>& column, int from, int to,
+                         std::vector<int>& pos, std::vector<int>& len) {
+  pos.clear();
+  len.clear();
+  for (int i = 0; i < P; ) {
+    const bool keep = column[i] >= from && column[i] <= to;
+    int l = 0;
+    while (i + l < P && (column[i + l] >= from && column[i + l] <= to) == keep) l++;
+    if (!keep) {
+      pos.push_back(i);
+      len.push_back(l);
+    }
+    i += l;
+  }
+  BedSelection range = sel;
+  range.nskip = pos.size();
+  range.col_skip_pos = pos.empty() ? 0 : &pos[0];
+  range.col_skip = len.empty() ? 0 : &len[0];
+  return range;
+}
+
+/**
+ Fast Walsh-Hadamard transform (unnormalized) of a, m a power of 2
+
+ */
+void fwht(double* a, int m) {
+  for (int h = 1; h < m; h *= 2) {
+    for (int i = 0; i < m; i += 2 * h) {
+      for (int j = i; j < i + h; j++) {
+        const double u = a[j], v = a[j + h];
+        a[j] = u + v;
+        a[j + h] = u - v;
+      }
+    }
+  }
+}
+
+/**
+ Sketch S X of the n x p matrix X, with S a k x n SRHT (method 0) or sparse
+ JL (method 1) projection drawn from rng; the columns of the k x p output
+ are rescaled to unit length
+
+ */
+void sketchColumns(const double* X, int n, int p, int k, int method,
+                   std::mt19937_64& rng, double* out) {
+  std::fill(out, out + (size_t) k * p, 0.0);
+  if (method == 0) {
+    int m = 1;
+    while (m < n) m *= 2;
+    std::vector<double> sign(n), buffer(m);
+    for (int i = 0; i < n; i++) sign[i] = (rng() & 1) ? 1.0 : -1.0;
+    // k distinct rows of the transform
+    std::vector<int> rows(m);
+    for (int i = 0; i < m; i++) rows[i] = i;
+    for (int i = 0; i < k; i++)
+      std::swap(rows[i], rows[i + rng() % (m - i)]);
+    const double scale = 1.0 / sqrt((double) k);
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      for (int i = 0; i < n; i++) buffer[i] = sign[i] * Xj[i];
+      std::fill(buffer.begin() + n, buffer.end(), 0.0);
+      fwht(&buffer[0], m);
+      double* Sj = out + (size_t) j * k;
+      for (int i = 0; i < k; i++) Sj[i] = buffer[rows[i]] * scale;
+    }
+  } else {
+    // each sample goes to one row in each of s segments of the k rows
+    const int s = std::min(k, 4);
+    std::vector<int> row((size_t) n * s);
+    std::vector<double> value((size_t) n * s);
+    for (int i = 0; i < n; i++) {
+      for (int t = 0; t < s; t++) {
+        const int first = (long long) k * t / s, last = (long long) k * (t + 1) / s;
+        row[(size_t) i * s + t] = first + rng() % (last - first);
+        value[(size_t) i * s + t] = ((rng() & 1) ? 1.0 : -1.0) / sqrt((double) s);
+      }
+    }
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      double* Sj = out + (size_t) j * k;
+      for (int i = 0; i < n; i++) {
+        if (Xj[i] == 0.0) continue;
+        for (int t = 0; t < s; t++)
+          Sj[row[(size_t) i * s + t]] += value[(size_t) i * s + t] * Xj[i];
+      }
+    }
+  }
+  for (int j = 0; j < p; j++) {
+    double* Sj = out + (size_t) j * k;
+    double ss = 0.0;
+    for (int i = 0; i < k; i++) ss += Sj[i] * Sj[i];
+    if (ss == 0.0) continue;
+    const double norm = sqrt(ss);
+    for (int i = 0; i < k; i++) Sj[i] /= norm;
+  }
+}
+
+/**
+ Relative Frobenius error ||S'S + D - X'X|| / ||X'X|| of the LD matrix of
+ the k x p sketch S of the n x p matrix X, with D = diag(residual) (0 if
+ residual is 0), estimated with random sign probes g (E ||A g||^2 = ||A||^2)
+
+ */
+double sketchError(const double* X, int n, const double* S, int k, int p,
+                   const double* residual, std::mt19937_64& rng) {
+  const int probes = 8;
+  std::vector<double> g(p), u(n), v(k);
+  double num = 0.0, den = 0.0;
+  for (int q = 0; q < probes; q++) {
+    for (int j = 0; j < p; j++) g[j] = (rng() & 1) ? 1.0 : -1.0;
+    std::fill(u.begin(), u.end(), 0.0);
+    std::fill(v.begin(), v.end(), 0.0);
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      const double* Sj = S + (size_t) j * k;
+      for (int i = 0; i < n; i++) u[i] += g[j] * Xj[i];
+      for (int i = 0; i < k; i++) v[i] += g[j] * Sj[i];
+    }
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      const double* Sj = S + (size_t) j * k;
+      double a = 0.0, b = 0.0;
+      for (int i = 0; i < n; i++) a += Xj[i] * u[i];
+      for (int i = 0; i < k; i++) b += Sj[i] * v[i];
+      if (residual) b += residual[j] * g[j];
+      num += (b - a) * (b - a);
+      den += a * a;
+    }
+  }
+  return den > 0.0 ? sqrt(num / den) : 0.0;
+}
+
+/**
+ Header of a sparse LD file, followed by startvec, endvec (int), offdiag,
+ smallest (double), rowptr (long long), col (int), value, mean and sd
+ (double)
+
+ */
+struct SparseLDHeader {
+  char magic[8];
+  int version, n, p, nblocks;
+  double r2, window;
+  unsigned long long selection;
+  long long nnz;
+};
+const char sparseLDMagic[8] = {'s', 's', 'C', 'T', 'P', 'R', 'l', 'd'};
+const int sparseLDVersion = 2;
+
+void fnv1a(unsigned long long& h, const void* data, size_t len) {
+  const unsigned char* c = (const unsigned char*) data;
+  for (size_t i = 0; i < len; i++) h = (h ^ c[i]) * 1099511628211ULL;
+}
+
+/**
+ FNV-1a hash of the size and time of the BED file, N, P and the selection
+
+ */
+unsigned long long selectionFingerprint(const std::string& fileName, int N, int P,
+                                        const BedSelection& sel) {
+  struct stat bed;
+  if (stat(fileName.c_str(), &bed) != 0)
+    throw std::runtime_error("Cannot open " + fileName);
+  const long long size = bed.st_size, time = bed.st_mtime;
+  unsigned long long h = 14695981039346656037ULL;
+  fnv1a(h, &size, sizeof(size));
+  fnv1a(h, &time, sizeof(time));
+  fnv1a(h, &N, sizeof(N));
+  fnv1a(h, &P, sizeof(P));
+  if (sel.nskip > 0) {
+    fnv1a(h, sel.col_skip_pos, sizeof(int) * sel.nskip);
+    fnv1a(h, sel.col_skip, sizeof(int) * sel.nskip);
+  }
+  if (sel.nkeep > 0) {
+    fnv1a(h, sel.keepbytes, sizeof(int) * sel.nkeep);
+    fnv1a(h, sel.keepoffset, sizeof(int) * sel.nkeep);
+  }
+  return h;
+}
+
+double dotProduct(const double* a, const double* b, int n) {
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += a[i] * b[i];
+    s1 += a[i + 1] * b[i + 1];
+    s2 += a[i + 2] * b[i + 2];
+    s3 += a[i + 3] * b[i + 3];
+  }
+  for (; i < n; i++) s0 += a[i] * b[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+/**
+ Orthonormalizes the m columns of the n x m matrix Q in place (modified
+ Gram-Schmidt, twice); columns in the span of the previous ones become 0
+
+ */
+void orthonormalize(double* Q, int n, int m) {
+  for (int c = 0; c < m; c++) {
+    double* Qc = Q + (size_t) c * n;
+    const double before = sqrt(dotProduct(Qc, Qc, n));
+    for (int pass = 0; pass < 2; pass++) {
+      for (int d = 0; d < c; d++) {
+        const double* Qd = Q + (size_t) d * n;
+        const double a = dotProduct(Qc, Qd, n);
+        for (int i = 0; i < n; i++) Qc[i] -= a * Qd[i];
+      }
+    }
+    const double norm = sqrt(dotProduct(Qc, Qc, n));
+    if (norm <= 1e-10 * before || norm == 0.0) {
+      std::fill(Qc, Qc + n, 0.0);
+      continue;
+    }
+    for (int i = 0; i < n; i++) Qc[i] /= norm;
+  }
+}
+
+/**
+ Eigendecomposition of the symmetric m x m matrix A (destroyed) by
+ Householder reduction to a tridiagonal matrix and the implicit QL method
+ (tred2 and tql2 of EISPACK): the eigenvalues in decreasing order and the
+ eigenvectors as the columns of V
+
+ */
+void symmetricEigen(std::vector<double>& A, int m, std::vector<double>& values,
+                    std::vector<double>& V) {
+  V.swap(A);
+  values.assign(m, 0.0);
+  if (m == 0) return;
+  // V(i, j) is row i, column j (column-major)
+  auto at = [&](int i, int j) -> double& { return V[(size_t) j * m + i]; };
+  std::vector<double>& d = values;
+  std::vector<double> e(m, 0.0);
+
+  // tridiagonal reduction, accumulating the transformations in V
+  for (int j = 0; j < m; j++) d[j] = at(m - 1, j);
+  for (int i = m - 1; i > 0; i--) {
+    double scale = 0.0, h = 0.0;
+    for (int k = 0; k < i; k++) scale += std::abs(d[k]);
+    if (scale == 0.0) {
+      e[i] = d[i - 1];
+      for (int j = 0; j < i; j++) {
+        d[j] = at(i - 1, j);
+        at(i, j) = 0.0;
+        at(j, i) = 0.0;
+      }
+    } else {
+      for (int k = 0; k < i; k++) {
+        d[k] /= scale;
+        h += d[k] * d[k];
+      }
+      double f = d[i - 1];
+      double g = f > 0.0 ? -sqrt(h) : sqrt(h);
+      e[i] = scale * g;
+      h -= f * g;
+      d[i - 1] = f - g;
+      for (int j = 0; j < i; j++) e[j] = 0.0;
+      for (int j = 0; j < i; j++) {
+        f = d[j];
+        at(j, i) = f;
+        g = e[j] + at(j, j) * f;
+        for (int k = j + 1; k < i; k++) {
+          g += at(k, j) * d[k];
+          e[k] += at(k, j) * f;
+        }
+        e[j] = g;
+      }
+      f = 0.0;
+      for (int j = 0; j < i; j++) {
+        e[j] /= h;
+        f += e[j] * d[j];
+      }
+      const double hh = f / (h + h);
+      for (int j = 0; j < i; j++) e[j] -= hh * d[j];
+      for (int j = 0; j < i; j++) {
+        f = d[j];
+        g = e[j];
+        double* Vj = &at(0, j);
+        for (int k = j; k < i; k++) Vj[k] -= f * e[k] + g * d[k];
+        d[j] = at(i - 1, j);
+        at(i, j) = 0.0;
+      }
+    }
+    d[i] = h;
+  }
+  for (int i = 0; i < m - 1; i++) {
+    at(m - 1, i) = at(i, i);
+    at(i, i) = 1.0;
+    const double h = d[i + 1];
+    double* Vi1 = &at(0, i + 1);
+    if (h != 0.0) {
+      for (int k = 0; k <= i; k++) d[k] = Vi1[k] / h;
+      for (int j = 0; j <= i; j++) {
+        double* Vj = &at(0, j);
+        double g = 0.0;
+        for (int k = 0; k <= i; k++) g += Vi1[k] * Vj[k];
+        for (int k = 0; k <= i; k++) Vj[k] -= g * d[k];
+      }
+    }
+    for (int k = 0; k <= i; k++) Vi1[k] = 0.0;
+  }
+  for (int j = 0; j < m; j++) {
+    d[j] = at(m - 1, j);
+    at(m - 1, j) = 0.0;
+  }
+  at(m - 1, m - 1) = 1.0;
+  e[0] = 0.0;
+
+  // implicit QL iterations on the tridiagonal matrix
+  for (int i = 1; i < m; i++) e[i - 1] = e[i];
+  e[m - 1] = 0.0;
+  double f = 0.0, tst1 = 0.0;
+  const double eps = std::numeric_limits<double>::epsilon();
+  for (int l = 0; l < m; l++) {
+    tst1 = std::max(tst1, std::abs(d[l]) + std::abs(e[l]));
+    int k = l;
+    while (k < m - 1 && std::abs(e[k]) > eps * tst1) k++;
+    if (k > l) {
+      for (int iter = 0; iter < 60; iter++) {
+        double g = d[l];
+        double q = (d[l + 1] - g) / (2.0 * e[l]);
+        double r = std::hypot(q, 1.0);
+        if (q < 0) r = -r;
+        d[l] = e[l] / (q + r);
+        d[l + 1] = e[l] * (q + r);
+        const double dl1 = d[l + 1];
+        double h = g - d[l];
+        for (int i = l + 2; i < m; i++) d[i] -= h;
+        f += h;
+        q = d[k];
+        double c = 1.0, c2 = 1.0, c3 = 1.0, s = 0.0, s2 = 0.0;
+        const double el1 = e[l + 1];
+        for (int i = k - 1; i >= l; i--) {
+          c3 = c2;
+          c2 = c;
+          s2 = s;
+          g = c * e[i];
+          h = c * q;
+          r = std::hypot(q, e[i]);
+          e[i + 1] = s * r;
+          s = e[i] / r;
+          c = q / r;
+          q = c * d[i] - s * g;
+          d[i + 1] = h + s * (c * g + s * d[i]);
+          double* Vi = &at(0, i), *Vi1 = &at(0, i + 1);
+          for (int j = 0; j < m; j++) {
+            h = Vi1[j];
+            Vi1[j] = s * Vi[j] + c * h;
+            Vi[j] = c * Vi[j] - s * h;
+          }
+        }
+        q = -s * s2 * c3 * el1 * e[l] / dl1;
+        e[l] = s * q;
+        d[l] = c * q;
+        if (std::abs(e[l]) <= eps * tst1) break;
+      }
+    }
+    d[l] += f;
+    e[l] = 0.0;
+  }
+
+  std::vector<int> order(m);
+  for (int i = 0; i < m; i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return d[a] > d[b];
+  });
+  std::vector<double> sortedValues(m), sorted((size_t) m * m);
+  for (int i = 0; i < m; i++) {
+    sortedValues[i] = d[order[i]];
+    std::copy(&V[(size_t) order[i] * m], &V[(size_t) order[i] * m] + m,
+              &sorted[(size_t) i * m]);
+  }
+  values.swap(sortedValues);
+  V.swap(sorted);
+}
+
+/**
+ Randomized SVD of the n x p matrix X with l columns (two power iterations):
+ the l x p matrix B = Q'X with the orthonormal n x l basis Q of the range,
+ rotated so that its rows are the right singular vectors scaled by the
+ singular values, in decreasing order; values are the squared singular
+ values
+
+ */
+void randomizedSVD(const double* X, int n, int p, int l, std::mt19937_64& rng,
+                   std::vector<double>& B, std::vector<double>& values) {
+  std::normal_distribution<double> normal;
+  std::vector<double> Y((size_t) n * l, 0.0), Z((size_t) p * l);
+  for (size_t i = 0; i < Z.size(); i++) Z[i] = normal(rng);
+  for (int it = 0; it < 3; it++) {
+    // Y = X Z
+    std::fill(Y.begin(), Y.end(), 0.0);
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      for (int c = 0; c < l; c++) {
+        const double z = Z[(size_t) c * p + j];
+        if (z == 0.0) continue;
+        double* Yc = &Y[(size_t) c * n];
+        for (int i = 0; i < n; i++) Yc[i] += z * Xj[i];
+      }
+    }
+    orthonormalize(&Y[0], n, l);
+    if (it == 2) break;
+    // Z = X' Y
+    for (int j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      for (int c = 0; c < l; c++) Z[(size_t) c * p + j] = dotProduct(Xj, &Y[(size_t) c * n], n);
+    }
+    orthonormalize(&Z[0], p, l);
+  }
+  // B = Q' X (l x p), then rotate by the eigenvectors of B B'
+  std::vector<double> Bq((size_t) l * p);
+  for (int j = 0; j < p; j++) {
+    const double* Xj = X + (size_t) j * n;
+    for (int c = 0; c < l; c++) Bq[(size_t) j * l + c] = dotProduct(&Y[(size_t) c * n], Xj, n);
+  }
+  std::vector<double> C((size_t) l * l, 0.0), V;
+  for (int j = 0; j < p; j++) {
+    const double* Bj = &Bq[(size_t) j * l];
+    for (int c = 0; c < l; c++)
+      for (int d = 0; d < l; d++) C[(size_t) d * l + c] += Bj[c] * Bj[d];
+  }
+  symmetricEigen(C, l, values, V);
+  B.assign((size_t) l * p, 0.0);
+  for (int j = 0; j < p; j++) {
+    const double* Bj = &Bq[(size_t) j * l];
+    for (int c = 0; c < l; c++) B[(size_t) j * l + c] = dotProduct(&V[(size_t) c * l], Bj, l);
+  }
+}
+
+/**
+ Rows of one block of a sparse LD matrix while it is built: (column within
+ the block, correlation), by ascending column
+
+ */
+typedef std::vector<std::vector<std::pair<int, double> > > SparseRows;
+
+/**
+ Smallest eigenvalue of a symmetric sparse matrix, estimated by Lanczos
+ with full reorthogonalization (at most 64 steps) and bisection on the
+ tridiagonal matrix. The estimate is at least the true eigenvalue. Rows
+ without any non-zero (monomorphic variants) are left out: their eigenvalue
+ 0 is not changed by shrinking.
+
+ */
+double smallestEigenvalue(const SparseRows& rows) {
+  const int p = rows.size();
+  const int m = std::min(p, 64);
+  std::vector<double> Q((size_t) (m + 1) * p, 0.0), alpha(m), beta(m + 1, 0.0);
+  std::mt19937_64 rng(1);
+  double norm = 0.0;
+  for (int i = 0; i < p; i++) {
+    const double sign = (rng() & 1) ? 1.0 : -1.0;
+    bool empty = true;
+    for (size_t e = 0; e < rows[i].size() && empty; e++) empty = rows[i][e].second == 0.0;
+    if (empty) continue;
+    Q[i] = sign;
+    norm += 1.0;
+  }
+  if (norm == 0.0) return 0.0;
+  for (int i = 0; i < p; i++) Q[i] /= sqrt(norm);
+  int steps = 0;
+  std::vector<double> w(p);
+  for (int k = 0; k < m; k++) {
+    const double* q = &Q[(size_t) k * p];
+    for (int i = 0; i < p; i++) {
+      double s = 0.0;
+      for (size_t e = 0; e < rows[i].size(); e++) s += rows[i][e].second * q[rows[i][e].first];
+      w[i] = s;
+    }
+    alpha[k] = dotProduct(&w[0], q, p);
+    for (int l = 0; l <= k; l++) {
+      const double* ql = &Q[(size_t) l * p];
+      const double c = dotProduct(&w[0], ql, p);
+      for (int i = 0; i < p; i++) w[i] -= c * ql[i];
+    }
+    steps = k + 1;
+    beta[k + 1] = sqrt(dotProduct(&w[0], &w[0], p));
+    if (beta[k + 1] < 1e-10) break;
+    double* next = &Q[(size_t) (k + 1) * p];
+    for (int i = 0; i < p; i++) next[i] = w[i] / beta[k + 1];
+  }
+  // bisection on the number of eigenvalues of T below x (Sturm sequence)
+  double lo = 0.0, hi = 0.0;
+  for (int k = 0; k < steps; k++) {
+    const double radius = (k > 0 ? beta[k] : 0.0) + (k + 1 < steps ? beta[k + 1] : 0.0);
+    lo = std::min(lo, alpha[k] - radius);
+    hi = std::max(hi, alpha[k] + radius);
+  }
+  for (int it = 0; it < 100 && hi - lo > 1e-10; it++) {
+    const double x = 0.5 * (lo + hi);
+    int below = 0;
+    double d = 1.0;
+    for (int k = 0; k < steps; k++) {
+      d = alpha[k] - x - (k > 0 ? beta[k] * beta[k] / d : 0.0);
+      if (d == 0.0) d = -1e-300;
+      if (d < 0.0) below++;
+    }
+    if (below > 0) hi = x; else lo = x;
+  }
+  return hi;
+}
+
+/**
+ Per-variant constants of the coordinate updates of a block, as arrays:
+ ctp = lambda_ct r(j,1), the cross trait penalty (0 for a single trait),
+ and shift = ctp / (diag + lambda2 + lambda_ct adj), what it adds to a
+ non-zero coefficient.
+
+ */
+struct CoordinateConstants {
+  std::vector<double> ctp, shift;
+  CoordinateConstants(const double* diag, double lambda2, double lambda_ct,
+                      const double* r, int traits, int ldr, const double* adj,
+                      int p) : ctp(p, 0.0), shift(p, 0.0) {
+    if (traits < 2) return;
+    for (int j = 0; j < p; j++) {
+      ctp[j] = lambda_ct * r[j + ldr];
+      shift[j] = ctp[j] / (diag[j] + lambda2 + lambda_ct * adj[j]);
+    }
+  }
+};
+
+/**
+ The coordinate update of elnet from t = u(j): soft thresholding of
+ t + ctp at lambda1, shifted by shift; CrossTrait false drops ctp and shift
+ (a single trait)
+
+ */
+template <bool CrossTrait>
+inline double coordinateUpdate(double t, double lambda1, double ctp,
+                               double shift) {
+  const double u = CrossTrait ? t + ctp : t;
+  if (std::abs(u) - lambda1 <= 0.0) return 0.0;
+  const double x = u - lambda1 > 0.0 ? t - lambda1 : t + lambda1;
+  return CrossTrait ? x + shift : x;
+}
+
+/**
+ elnet on the variants from, ..., from + p - 1 of a sparse LD matrix; g is
+ the gradient scale * LD * x of the block instead of yhat. The updates are
+ those of elnet, but cost the number of LD neighbours of the variant.
+ elnetSparse runs the instantiation for the number of traits.
+
+ */
+template <bool CrossTrait>
+int elnetSparseKernel(double lambda1, double lambda2, double lambda_ct,
+                      const double* diag, const SparseLD& ld, double scale,
+                      int from, int p, const double* r, int traits, int ldr,
+                      const double* adj, double thr, double* x, double* g,
+                      int maxiter, ElnetTelemetry& tel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  double dlx_cur, dlx_pre,del,t,xj;
+  int j;
+
+  const CoordinateConstants constants(diag, lambda2, lambda_ct, r, traits,
+                                      ldr, adj, p);
+
+  int conv=0;
+  int count=0;
+  long long updates=0;
+  dlx_pre=0.0;
+  dlx_cur=0.0;
+  tel.stop=0;
+  for(int k=0;k<maxiter ;k++) {
+    tel.sweeps=k+1;
+    dlx_cur=0.0;
+    for(j=0; j < p; j++) {
+      del=0.0;
+      xj=x[j];
+      x[j]=0.0;
+      // g(j) = dotproduct(X.col(j), X * x), as in elnet
+      t= diag[j] * xj + r[j] - g[j];
+
+      x[j]=coordinateUpdate<CrossTrait>(t, lambda1, constants.ctp[j],
+                                        constants.shift[j]);
+
+      if(x[j]==xj) continue;
+      del=x[j]-xj;
+      updates++;
+
+      const long long end=ld.rowptr[from + j + 1];
+      for(long long e=ld.rowptr[from + j]; e < end; e++)
+        g[ld.col[e] - from] += scale * ld.value[e] * del;
+      dlx_cur=std::max(dlx_cur,std::abs(del));
+    }
+    if(std::abs(dlx_cur-dlx_pre)<1e-6){
+      count++;
+    } else{
+      count=0;
+    }
+    dlx_pre=dlx_cur;
+    checkInterrupt();
+
+    if(dlx_cur < thr) {
+      conv=1;
+      tel.stop=1;
+      break;
+    }
+    if(count >= 50){
+      conv=1;
+      tel.stop=2;
+      break;
+    }
+  }
+
+  tel.updates=updates;
+  tel.maxdelta=dlx_cur;
+  tel.active=0;
+  for(j=0; j < p; j++) {
+    if(x[j] != 0.0) tel.active++;
+  }
+  tel.time=std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return conv;
+}
+
+int elnetSparse(double lambda1, double lambda2, double lambda_ct, const double* diag,
+                const SparseLD& ld, double scale, int from, int p,
+                const double* r, int traits, int ldr, const double* adj,
+                double thr, double* x, double* g, int maxiter, ElnetTelemetry& tel)
+{
+  if(traits > 1)
+    return elnetSparseKernel<true>(lambda1, lambda2, lambda_ct, diag, ld, scale,
+                                   from, p, r, traits, ldr, adj, thr, x, g,
+                                   maxiter, tel);
+  return elnetSparseKernel<false>(lambda1, lambda2, lambda_ct, diag, ld, scale,
+                                  from, p, r, traits, ldr, adj, thr, x, g,
+                                  maxiter, tel);
+}
+
+}
+
+void setInterruptHook(InterruptHook hook) {
+  interruptHook = hook;
+  pollingThread = std::this_thread::get_id();
+}
+
+void checkInterrupt() {
+  if (std::this_thread::get_id() == pollingThread) {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!polled || std::chrono::duration<double>(now - lastPoll).count() >= pollInterval) {
+      polled = true;
+      lastPoll = now;
+      if (progressCalls.load(std::memory_order_relaxed) > 0) {
+        const long long total = progressTotal.load(std::memory_order_relaxed);
+        const long long done = progressDone.load(std::memory_order_relaxed);
+        const int percent = total > 0 ? (int) (100 * std::min(done, total) / total) : 100;
+        if (percent != progressShown) messages() << percent << "% done\n";
+        progressShown = percent;
+      }
+      if (interruptHook) {
+        try {
+          interruptHook();
+        } catch (...) {
+          // the next call polls again, to clear the flag once it passes
+          hookCancelled = true;
+          polled = false;
+          cancelFlag.store(true, std::memory_order_relaxed);
+          throw;
+        }
+        if (hookCancelled) {
+          hookCancelled = false;
+          cancelFlag.store(false, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+  if (cancelFlag.load(std::memory_order_relaxed)) throw Cancelled();
+}
+
+void requestCancel() {
+  cancelFlag.store(true, std::memory_order_relaxed);
+}
+
+void resetCancel() {
+  cancelFlag.store(false, std::memory_order_relaxed);
+}
+
+void progressStep(long long units) {
+  progressDone.fetch_add(units, std::memory_order_relaxed);
+}
+
+Progress::Progress(long long total, bool report) : report_(report) {
+  if (!report_) return;
+  if (progressCalls.fetch_add(1) == 0) {
+    progressTotal.store(0);
+    progressDone.store(0);
+    if (std::this_thread::get_id() == pollingThread) progressShown = -1;
+  }
+  progressTotal.fetch_add(total);
+}
+
+Progress::~Progress() {
+  if (report_) progressCalls.fetch_sub(1);
+}
+
+namespace {
+
+// whether the thread is running a range of parallelFor
+thread_local bool inRange = false;
+
+/**
+ The workers of parallelFor. run() hands a job to the workers through a
+ generation counter; each worker (and the caller) takes ranges until none
+ is left.
+
+ */
+class ThreadPool {
+public:
+  ThreadPool() : threads_(1), generation_(0), job_(0), ranges_(0), next_(0),
+    remaining_(0), stop_(false) {}
+  ~ThreadPool() { resize(1); }
+
+  std::mutex busy;
+
+  int threads() const { return threads_.load(std::memory_order_relaxed); }
+
+  // with busy held
+  void resize(int threads) {
+    if (std::max(1, threads) == threads_.load()) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (size_t t = 0; t < workers_.size(); t++) workers_[t].join();
+    workers_.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = false;
+    }
+    threads_.store(std::max(1, threads));
+  }
+
+  // with busy held
+  void run(int ranges, const std::function<void(int, int, int)>& fn, int n) {
+    if (workers_.size() + 1 < (size_t) threads_.load()) {
+      for (int t = workers_.size() + 1; t < threads_.load(); t++)
+        workers_.push_back(std::thread(&ThreadPool::work, this));
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &fn;
+      n_ = n;
+      ranges_ = ranges;
+      next_ = 0;
+      remaining_ = ranges;
+      error_ = std::exception_ptr();
+      cancelled_ = std::exception_ptr();
+      generation_++;
+    }
+    wake_.notify_all();
+    takeRanges();
+    // the caller keeps polling while the workers finish their ranges; an
+    // interrupt cancels them, and is rethrown once they are done
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::chrono::duration<double> poll(pollInterval);
+    while (!done_.wait_for(lock, poll, [this] { return remaining_ == 0; })) {
+      lock.unlock();
+      std::exception_ptr interrupt;
+      try {
+        checkInterrupt();
+      } catch (Cancelled&) {
+      } catch (...) {
+        requestCancel();
+        interrupt = std::current_exception();
+      }
+      lock.lock();
+      if (interrupt && !error_) error_ = interrupt;
+    }
+    job_ = 0;
+    if (error_ || cancelled_) {
+      resetCancel();
+      std::rethrow_exception(error_ ? error_ : cancelled_);
+    }
+  }
+
+private:
+  std::atomic<int> threads_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_, done_;
+  unsigned long long generation_;
+  const std::function<void(int, int, int)>* job_;
+  int n_, ranges_, next_, remaining_;
+  bool stop_;
+  std::exception_ptr error_, cancelled_;
+
+  void takeRanges() {
+    for (;;) {
+      int r;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (next_ >= ranges_) return;
+        r = next_++;
+      }
+      const int from = (int) ((long long) n_ * r / ranges_);
+      const int to = (int) ((long long) n_ * (r + 1) / ranges_);
+      inRange = true;
+      try {
+        (*job_)(r, from, to);
+      } catch (Cancelled&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!cancelled_) cancelled_ = std::current_exception();
+      } catch (...) {
+        requestCancel();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+      }
+      inRange = false;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--remaining_ == 0) done_.notify_all();
+    }
+  }
+
+  void work() {
+    unsigned long long seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stop_ || (generation_ != seen && job_); });
+        if (stop_) return;
+        seen = generation_;
+      }
+      takeRanges();
+    }
+  }
+};
+
+ThreadPool pool;
+
+/**
+ Thread setters and getters of the BLAS libraries, looked up once in the
+ loaded libraries
+
+ */
+struct BlasThreading {
+  typedef void (*SetInt)(int);
+  typedef int (*GetInt)();
+  typedef void (*SetLong)(long);
+  typedef long (*GetLong)();
+  SetInt setOpenBlas, setMkl;
+  GetInt getOpenBlas, getMkl;
+  SetLong setBlis;
+  GetLong getBlis;
+  BlasThreading() : setOpenBlas(0), setMkl(0), getOpenBlas(0), getMkl(0),
+    setBlis(0), getBlis(0) {
+#if !defined(_WIN32)
+    setOpenBlas = (SetInt) dlsym(RTLD_DEFAULT, "openblas_set_num_threads");
+    getOpenBlas = (GetInt) dlsym(RTLD_DEFAULT, "openblas_get_num_threads");
+    setMkl = (SetInt) dlsym(RTLD_DEFAULT, "MKL_Set_Num_Threads");
+    getMkl = (GetInt) dlsym(RTLD_DEFAULT, "MKL_Get_Max_Threads");
+    setBlis = (SetLong) dlsym(RTLD_DEFAULT, "bli_thread_set_num_threads");
+    getBlis = (GetLong) dlsym(RTLD_DEFAULT, "bli_thread_get_num_threads");
+#endif
+  }
+};
+
+const BlasThreading& blasThreading() {
+  static const BlasThreading blas;
+  return blas;
+}
+
+}
+
+void setThreads(int threads) {
+  std::lock_guard<std::mutex> busy(pool.busy);
+  pool.resize(threads);
+}
+
+int threads() {
+  return pool.threads();
+}
+
+void parallelFor(int n, int ranges, const std::function<void(int, int, int)>& fn) {
+  if (n <= 0) return;
+  ranges = std::max(1, std::min(n, ranges));
+  std::unique_lock<std::mutex> busy(pool.busy, std::defer_lock);
+  if (ranges > 1 && !inRange && busy.try_lock()) {
+    pool.run(ranges, fn, n);
+    return;
+  }
+  for (int r = 0; r < ranges; r++)
+    fn(r, (int) ((long long) n * r / ranges), (int) ((long long) n * (r + 1) / ranges));
+}
+
+int blasThreads() {
+  const BlasThreading& blas = blasThreading();
+  if (blas.getOpenBlas) return blas.getOpenBlas();
+  if (blas.getMkl) return blas.getMkl();
+  if (blas.getBlis) return (int) blas.getBlis();
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 0;
+#endif
+}
+
+void setBlasThreads(int threads) {
+  const BlasThreading& blas = blasThreading();
+  threads = std::max(1, threads);
+  if (blas.setOpenBlas) blas.setOpenBlas(threads);
+  if (blas.setMkl) blas.setMkl(threads);
+  if (blas.setBlis) blas.setBlis(threads);
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+void setMessageStream(std::ostream* out) {
+  messageStream = out;
+}
+
+void setWarningStream(std::ostream* out) {
+  warningStream = out;
+}
+
+bool openPlinkBinaryFile(const std::string s, std::ifstream &BIT) {
+  BIT.open(s.c_str(), std::ios::in | std::ios::binary);
+  if (!BIT.is_open()) {
+    throw "Cannot open the bed file";
+  }
+
+  // 2) else check for 0.99 SNP/Ind coding
+  // 3) else print warning that file is too old
+  char ch[1];
+  BIT.read(ch, 1);
+  std::bitset<8> b;
+  b = ch[0];
+  bool bfile_SNP_major = false;
+  bool v1_bfile = true;
+  // If v1.00 file format
+  // Magic numbers for .bed file: 00110110 11011000 = v1.00 bed file
+  // std::cerr << "check magic number" << std::endl;
+  if ((b[2] && b[3] && b[5] && b[6]) && !(b[0] || b[1] || b[4] || b[7])) {
+    // Next number
+    BIT.read(ch, 1);
+    b = ch[0];
+    if ((b[0] && b[1] && b[3] && b[4]) && !(b[2] || b[5] || b[6] || b[7])) {
+      // Read SNP/Ind major coding
+      BIT.read(ch, 1);
+      b = ch[0];
+      if (b[0])
+        bfile_SNP_major = true;
+      else
+        bfile_SNP_major = false;
+
+      // if (bfile_SNP_major) std::cerr << "Detected that binary PED file is
+      // v1.00 SNP-major mode" << std::endl;
+      // else std::cerr << "Detected that binary PED file is v1.00
+      // individual-major mode" << std::endl;
+
+    } else
+      v1_bfile = false;
+
+  } else
+    v1_bfile = false;
+  // Reset file if < v1
+  if (!v1_bfile) {
+    warnings() << "Warning, old BED file <v1.00 : will try to recover..."
+               << std::endl;
+    warnings() << "  but you should --make-bed from PED )" << std::endl;
+    BIT.close();
+    BIT.clear();
+    BIT.open(s.c_str(), std::ios::in | std::ios::binary);
+    BIT.read(ch, 1);
+    b = ch[0];
+  }
+  // If 0.99 file format
+  if ((!v1_bfile) && (b[1] || b[2] || b[3] || b[4] || b[5] || b[6] || b[7])) {
+    warnings() << std::endl
+               << " *** Possible problem: guessing that BED is < v0.99      *** "
+               << std::endl;
+    warnings() << " *** High chance of data corruption, spurious results    *** "
+               << std::endl;
+    warnings()
+      << " *** Unless you are _sure_ this really is an old BED file *** "
+      << std::endl;
+    warnings() << " *** you should recreate PED -> BED                      *** "
+               << std::endl
+               << std::endl;
+    bfile_SNP_major = false;
+    BIT.close();
+    BIT.clear();
+    BIT.open(s.c_str(), std::ios::in | std::ios::binary);
+  } else if (!v1_bfile) {
+    if (b[0])
+      bfile_SNP_major = true;
+    else
+      bfile_SNP_major = false;
+    warnings() << "Binary PED file is v0.99" << std::endl;
+    if (bfile_SNP_major)
+      warnings() << "Detected that binary PED file is in SNP-major mode"
+                 << std::endl;
+      else
+        warnings() << "Detected that binary PED file is in individual-major mode"
+                   << std::endl;
+  }
+  return bfile_SNP_major;
+}
+
+unsigned long long bedBytes(int N) {
+  return ceil(N / 4.0);
+}
+
+int selectedSamples(int N, const BedSelection& sel) {
+  return (sel.nkeep > 0) ? sel.nkeep : N;
+}
+
+int selectedVariants(int P, const BedSelection& sel) {
+  int nskip = 0;
+  for (int i = 0; i < sel.nskip; i++) nskip += sel.col_skip[i];
+  return P - nskip;
+}
+
+void setCompactPext(bool on) {
+#if defined(SSCTPR_PEXT)
+  pextOn.store(on && __builtin_cpu_supports("bmi2"));
+#else
+  pextOn.store(false);
+#endif
+}
+
+bool compactPext() {
+  return pextOn.load();
+}
+
+int genotypeMatrix(const std::string& fileName, int N, int P,
+                   const BedSelection& sel, int fillmissing, double* genotypes) {
+
+  if (preferSampleMajor(fileName, N, P, sel, 0, 0))
+    return genotypeMatrixSampleMajor(fileName, N, P, sel, fillmissing, genotypes);
+
+  std::ifstream bedFile;
+  openSnpMajor(fileName, bedFile);
+
+  int i = 0;
+  int ii = 0;
+  const bool colskip = (sel.nskip > 0);
+  unsigned long long int Nbytes = bedBytes(N);
+  const bool selectrow = (sel.nkeep > 0);
+  const int n = selectedSamples(N, sel);
+
+  int iii;
+
+  // every column read is decoded in full, so genotypes is not cleared first
+  std::vector<char> ch(Nbytes);
+  const KeepPlan plan(N, sel);
+  std::vector<char> packed(bedBytes(n) + 8);
+  // a keep subset is packed into a row of n samples
+  const char* row = selectrow ? &packed[0] : &ch[0];
+  const DosageTable dosages(fillmissing == 0 ? NAN : 0.0);
+
+  iii=0;
+  while (i < P) {
+    checkInterrupt();
+    if (colskip) {
+      if (ii < sel.nskip) {
+        if (i == sel.col_skip_pos[ii]) {
+          bedFile.seekg(sel.col_skip[ii] * Nbytes, bedFile.cur);
+          i = i + sel.col_skip[ii];
+          ii++;
+          continue;
+        }
+      }
+    }
+
+    bedFile.read(&ch[0], Nbytes); // Read the information
+    if (!bedFile)
+      throw std::runtime_error(
+          "Problem with the BED file...has the FAM/BIM file been changed?");
+
+    if (selectrow) plan.compact(&ch[0], &packed[0]);
+    decodeRow((const unsigned char*) row, n, dosages,
+              genotypes + (size_t) iii * n);
+    i++;
+    iii++;
+  }
+  return iii;
+}
+
+int multiBed3(const std::string& fileName, int N, int P,
+              const double* input, int nrow, int ncol,
+              const BedSelection& sel, int trace, double* result) {
+
+  std::ifstream bedFile;
+  openSnpMajor(fileName, bedFile);
+
+  int i = 0;
+  int ii = 0;
+  int iii = 0;
+  const bool colskip = (sel.nskip > 0);
+  unsigned long long int Nbytes = bedBytes(N);
+  const bool selectrow = (sel.nkeep > 0);
+  const int n = selectedSamples(N, sel);
+
+  std::fill(result, result + (size_t) n * ncol, 0.0);
+  std::vector<char> ch(Nbytes);
+  const KeepPlan plan(N, sel);
+  std::vector<char> packed(bedBytes(n) + 8);
+  // a keep subset is packed into a row of n samples
+  const char* row = selectrow ? &packed[0] : &ch[0];
+  // missing genotypes add nothing
+  const DosageTable dosages(0.0);
+  std::vector<double> dosage(n);
+  Progress progress(nrow, trace > 0);
+
+  while (i < P) {
+    checkInterrupt();
+    if (colskip) {
+      if (ii < sel.nskip) {
+        if (i == sel.col_skip_pos[ii]) {
+          bedFile.seekg(sel.col_skip[ii] * Nbytes, bedFile.cur);
+          i = i + sel.col_skip[ii];
+          ii++;
+          continue;
+        }
+      }
+    }
+
+    progress.step();
+
+    bedFile.read(&ch[0], Nbytes); // Read the information
+    if (!bedFile)
+      throw std::runtime_error(
+          "Problem with the BED file...has the FAM/BIM file been changed?");
+
+    // the row is decoded once, and added to the columns with a weight
+    bool decoded = false;
+    for (int k = 0; k < ncol; k++) {
+      const double w = input[iii + (size_t) k * nrow];
+      if (w == 0.0) continue;
+      if (!decoded) {
+        if (selectrow) plan.compact(&ch[0], &packed[0]);
+        decodeRow((const unsigned char*) row, n, dosages, &dosage[0]);
+        decoded = true;
+      }
+      double* out = result + (size_t) k * n;
+      for (int j = 0; j < n; j++) out[j] += dosage[j] * w;
+    }
+
+    i++;
+    iii++;
+  }
+
+  return iii;
+}
+
+int multiBed3sp(const std::string& fileName, int N, int P,
+                const double* beta, const int* nonzeros, int nvariants,
+                const int* colpos, int ncol,
+                const BedSelection& sel, int trace, double* result) {
+
+  if (preferSampleMajor(fileName, N, P, sel, nonzeros, nvariants))
+    return multiBed3spSampleMajor(fileName, N, P, beta, nonzeros, nvariants,
+                                  colpos, ncol, sel, trace, result);
+
+  std::ifstream bedFile;
+  openSnpMajor(fileName, bedFile);
+
+  int i = 0;
+  int ii = 0;
+  int iii = 0;
+  int k = 0;
+  const bool colskip = (sel.nskip > 0);
+  unsigned long long int Nbytes = bedBytes(N);
+  const bool selectrow = (sel.nkeep > 0);
+  const int n = selectedSamples(N, sel);
+
+  std::fill(result, result + (size_t) n * ncol, 0.0);
+  std::vector<char> ch(Nbytes);
+  const KeepPlan plan(N, sel);
+  std::vector<char> packed(bedBytes(n) + 8);
+  // a keep subset is packed into a row of n samples
+  const char* row = selectrow ? &packed[0] : &ch[0];
+  std::vector<double> offset(ncol, 0.0);
+  Progress progress(nvariants, trace > 0);
+
+  while (i < P) {
+    checkInterrupt();
+    if (colskip) {
+      if (ii < sel.nskip) {
+        if (i == sel.col_skip_pos[ii]) {
+          bedFile.seekg(sel.col_skip[ii] * Nbytes, bedFile.cur);
+          i = i + sel.col_skip[ii];
+          ii++;
+          continue;
+        }
+      }
+    }
+
+    progress.step();
+
+    bedFile.read(&ch[0], Nbytes); // Read the information
+    if (!bedFile)
+      throw std::runtime_error(
+          "Problem with the BED file...has the FAM/BIM file been changed?");
+
+    // variants without weights are neither packed nor decoded
+    const int nz = nonzeros[iii];
+    if (nz > 0) {
+      if (selectrow) plan.compact(&ch[0], &packed[0]);
+      scoreVariant((const unsigned char*) row, n, beta, colpos, k, nz, n,
+                   result, offset.data());
+    }
+
+    k += nonzeros[iii];
+    i++;
+    iii++;
+  }
+  addColumnOffsets(offset, n, result);
+
+  return iii;
+}
+
+int multiBed3spBuffer(const char* bed, int N, int P,
+                      const double* beta, const int* nonzeros, int nvariants,
+                      const int* colpos, int ncol,
+                      const BedSelection& sel, double* result) {
+
+  const unsigned long long Nbytes = bedBytes(N);
+  const bool selectrow = (sel.nkeep > 0);
+  const int n = selectedSamples(N, sel);
+  std::fill(result, result + (size_t) n * ncol, 0.0);
+  const KeepPlan plan(N, sel);
+  std::vector<char> packed(bedBytes(n) + 8);
+  std::vector<double> offset(ncol, 0.0);
+
+  int i = 0;   // variant in the file
+  int ii = 0;  // skip run
+  int iii = 0; // variant read
+  int k = 0;   // weight
+  while (i < P) {
+    if (ii < sel.nskip && i == sel.col_skip_pos[ii]) {
+      i += sel.col_skip[ii];
+      ii++;
+      continue;
+    }
+    if (iii >= nvariants)
+      throw std::runtime_error("More variants selected than rows of weights");
+
+    const int nz = nonzeros[iii];
+    if (nz > 0) {
+      const unsigned char* ch = (const unsigned char*) bed + (size_t) i * Nbytes;
+      if (selectrow) {
+        plan.compact((const char*) ch, &packed[0]);
+        ch = (const unsigned char*) &packed[0];
+      }
+      scoreVariant(ch, n, beta, colpos, k, nz, n, result, offset.data());
+    }
+    k += nz;
+    i++;
+    iii++;
+  }
+  addColumnOffsets(offset, n, result);
+  return iii;
+}
+
+std::string sampleMajorCacheName(const std::string& fileName) {
+  const std::string ext = ".bed";
+  if (fileName.size() >= ext.size() &&
+      fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0)
+    return fileName.substr(0, fileName.size() - ext.size()) + ".smc";
+  return fileName + ".smc";
+}
+
+void buildSampleMajorCache(const std::string& fileName, int N, int P,
+                           int tileVariants) {
+  if (tileVariants <= 0 || tileVariants % 4 != 0)
+    throw std::runtime_error("tileVariants should be a positive multiple of 4");
+  std::ifstream bedFile;
+  openSnpMajor(fileName, bedFile);
+  const unsigned long long Nbytes = bedBytes(N);
+  struct stat bed;
+  if (stat(fileName.c_str(), &bed) != 0 ||
+      (unsigned long long) bed.st_size < 3 + Nbytes * P)
+    throw std::runtime_error("Problem with the BED file...has the FAM/BIM file been changed?");
+
+  const std::string cacheName = sampleMajorCacheName(fileName);
+  const std::string tmpName = cacheName + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ios::out | std::ios::binary);
+  if (!out) throw std::runtime_error("Cannot write " + tmpName);
+  SampleMajorHeader h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, sampleMajorMagic, 8);
+  h.version = sampleMajorVersion;
+  h.N = N;
+  h.P = P;
+  h.tileVariants = tileVariants;
+  h.bedSize = bed.st_size;
+  out.write((const char*) &h, sizeof(h));
+
+  // transpose a tile in passes over at most 64MB of the BED file
+  const unsigned long long rowBytes = tileVariants / 4;
+  const unsigned long long chunk = std::max(1ULL, (64ULL << 20) / tileVariants);
+  std::vector<unsigned char> in, rows;
+  for (int v0 = 0; v0 < P; v0 += tileVariants) {
+    checkInterrupt();
+    const int w = std::min(tileVariants, P - v0);
+    for (unsigned long long b0 = 0; b0 < Nbytes; b0 += chunk) {
+      const unsigned long long len = std::min(chunk, Nbytes - b0);
+      in.resize(w * len);
+      for (int v = 0; v < w; v++) {
+        bedFile.seekg(3 + (v0 + v) * Nbytes + b0);
+        bedFile.read((char*) &in[v * len], len);
+      }
+      if (!bedFile)
+        throw std::runtime_error("Problem with the BED file...has the FAM/BIM file been changed?");
+      const int s0 = b0 * 4;
+      const int s1 = std::min((unsigned long long) N, (b0 + len) * 4);
+      rows.assign((s1 - s0) * rowBytes, 0);
+      for (int v = 0; v < w; v++) {
+        const unsigned char* col = &in[v * len];
+        const int shift = (v & 3) * 2;
+        for (int s = s0; s < s1; s++) {
+          const int code = (col[(s >> 2) - b0] >> ((s & 3) * 2)) & 3;
+          rows[(s - s0) * rowBytes + (v >> 2)] |= code << shift;
+        }
+      }
+      out.write((const char*) &rows[0], rows.size());
+    }
+  }
+  out.close();
+  if (!out) throw std::runtime_error("Cannot write " + tmpName);
+  std::remove(cacheName.c_str());
+  if (std::rename(tmpName.c_str(), cacheName.c_str()) != 0)
+    throw std::runtime_error("Cannot write " + cacheName);
+}
+
+int genotypeMatrixSampleMajor(const std::string& fileName, int N, int P,
+                              const BedSelection& sel, int fillmissing,
+                              double* genotypes) {
+  std::ifstream in;
+  SampleMajorHeader h;
+  requireSampleMajorCache(fileName, N, P, in, h);
+  const int n = selectedSamples(N, sel);
+  const int p = selectedVariants(P, sel);
+  std::fill(genotypes, genotypes + (size_t) n * p, 0.0);
+  const DosageTable dosages(fillmissing == 0 ? NAN : 0.0);
+
+  const std::vector<int> samples = keptSamples(N, sel);
+  const std::vector<int> column = selectedColumns(P, sel);
+  const int V = h.tileVariants;
+  const size_t rowBytes = V / 4;
+  std::vector<unsigned char> rows;
+  for (int t = 0, v0 = 0; v0 < P; t++, v0 += V) {
+    const int v1 = std::min(P, v0 + V);
+    bool used = false;
+    for (int v = v0; v < v1 && !used; v++) used = column[v] >= 0;
+    if (!used) continue;
+    checkInterrupt();
+    readTileRows(in, h, t, samples, rows);
+    for (int v = v0; v < v1; v++) {
+      if (column[v] < 0) continue;
+      double* col = genotypes + (size_t) column[v] * n;
+      const unsigned char* row = &rows[(v - v0) >> 2];
+      const int shift = ((v - v0) & 3) * 2;
+      for (int j = 0; j < n; j++)
+        col[j] = dosages.code[(row[j * rowBytes] >> shift) & 3];
+    }
+  }
+  return p;
+}
+
+int multiBed3spSampleMajor(const std::string& fileName, int N, int P,
+                           const double* beta, const int* nonzeros, int nvariants,
+                           const int* colpos, int ncol,
+                           const BedSelection& sel, int trace, double* result) {
+  std::ifstream in;
+  SampleMajorHeader h;
+  requireSampleMajorCache(fileName, N, P, in, h);
+  const int n = selectedSamples(N, sel);
+  const int p = selectedVariants(P, sel);
+  if (p > nvariants)
+    throw std::runtime_error("More variants selected than rows of weights");
+  std::fill(result, result + (size_t) n * ncol, 0.0);
+
+  std::vector<int> first(p + 1, 0); // first weight of each selected variant
+  for (int c = 0; c < p; c++) first[c + 1] = first[c] + nonzeros[c];
+  const std::vector<int> samples = keptSamples(N, sel);
+  const std::vector<int> column = selectedColumns(P, sel);
+  const int V = h.tileVariants;
+  const size_t rowBytes = V / 4;
+  std::vector<unsigned char> rows;
+  std::vector<int> used;
+  Progress progress(p, trace > 0);
+  for (int t = 0, v0 = 0; v0 < P; t++, v0 += V) {
+    const int v1 = std::min(P, v0 + V);
+    used.clear();
+    for (int v = v0; v < v1; v++) {
+      if (column[v] < 0) continue;
+      progress.step(); // by selected variant, as the SNP-major path
+      if (nonzeros[column[v]] > 0) used.push_back(v);
+    }
+    if (used.empty()) continue;
+    checkInterrupt();
+    readTileRows(in, h, t, samples, rows);
+    for (int j = 0; j < n; j++) {
+      const unsigned char* row = &rows[j * rowBytes];
+      for (size_t u = 0; u < used.size(); u++) {
+        const int v = used[u] - v0;
+        const int code = (row[v >> 2] >> ((v & 3) * 2)) & 3;
+        if (code & 1) continue; // missing or homozygous A2
+        const double dosage = 2 - (code >> 1);
+        const int c = column[used[u]];
+        for (int k = first[c]; k < first[c + 1]; k++)
+          result[j + (size_t) colpos[k] * n] += dosage * beta[k];
+      }
+    }
+  }
+  return p;
+}
+
+void normalize(double* genotypes, int n, int k, double* sd) {
+  for (int i = 0; i < k; ++i) {
+    double* col = genotypes + (size_t) i * n;
+    double m = 0.0;
+    for (int j = 0; j < n; j++) m += col[j];
+    m /= n;
+    double ss = 0.0;
+    for (int j = 0; j < n; j++) {
+      col[j] -= m;
+      ss += col[j] * col[j];
+    }
+    sd[i] = (n > 1) ? sqrt(ss / (n - 1)) : 0.0;
+    // scale to unit length, leaving all-zero columns as they are
+    double norm = sqrt(ss);
+    if (norm != 0.0) {
+      for (int j = 0; j < n; j++) col[j] /= norm;
+    }
+  }
+}
+
+namespace {
+
+/**
+ elnet for one (CrossTrait false) or more traits, instantiated for both so
+ that the trait count is not tested per coordinate
+
+ */
+template <bool CrossTrait>
+int elnetKernel(double lambda1, double lambda2, double lambda_ct,
+                const double* diag, const double* X, int n, int p,
+                const double* r, int traits, int ldr, const double* adj,
+                double thr, double* x, double* yhat, int trace, int maxiter,
+                ElnetTelemetry& tel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  double dlx_cur, dlx_pre,del,t,xj;
+  int j,i;
+
+  // constants of the updates
+  const CoordinateConstants constants(diag, lambda2, lambda_ct, r, traits,
+                                      ldr, adj, p);
+
+  int conv=0;
+  int count=0;
+  long long updates=0;
+  dlx_pre=0.0;
+  dlx_cur=0.0;
+  tel.stop=0;
+  for(int k=0;k<maxiter ;k++) {
+    tel.sweeps=k+1;
+    dlx_cur=0.0;
+    for(j=0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      del=0.0;
+      xj=x[j];
+      x[j]=0.0;
+      double dot=0.0;
+      for(i=0; i < n; i++) dot += Xj[i] * yhat[i];
+      t= diag[j] * xj + r[j] - dot;
+      // t is u(j), Eq(7) in ms
+      // u(j) = r(j,0) - (dotproduct(X.col(j), (X * x - X.col(j) * xj))
+      //      = r(j,0) - (dotproduct(X.col(j), X * x)) + (docproduct(X.col(j), X.col(j) * xj))
+      //      = r(j,0) - (dotproduct(X.col(j), yhat)) + diag(j) * xj
+
+
+      // update the beta coef, with the cross trait penalty
+      x[j]=coordinateUpdate<CrossTrait>(t, lambda1, constants.ctp[j],
+                                        constants.shift[j]);
+
+      if(x[j]==xj) continue;
+      del=x[j]-xj;   // x(j) is new, xj is old
+      updates++;
+
+      for(i=0; i < n; i++) yhat[i] += del*Xj[i]; // update yhat
+      dlx_cur=std::max(dlx_cur,std::abs(del));
+    }
+    if(std::abs(dlx_cur-dlx_pre)<1e-6){
+      count++;
+    } else{
+      count=0;
+    }
+    dlx_pre=dlx_cur;
+    checkInterrupt();
+
+    if(dlx_cur < thr) {
+      conv=1;
+      tel.stop=1;
+      break;
+    }
+    if(count >= 50){
+      conv=1;
+      tel.stop=2;
+      break;
+    }
+  }
+
+  tel.updates=updates;
+  tel.maxdelta=dlx_cur;
+  tel.active=0;
+  for(j=0; j < p; j++) {
+    if(x[j] != 0.0) tel.active++;
+  }
+  tel.time=std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return conv;
+}
+
+}
+
+int elnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel)
+{
+  if(traits > 1)
+    return elnetKernel<true>(lambda1, lambda2, lambda_ct, diag, X, n, p, r,
+                             traits, ldr, adj, thr, x, yhat, trace, maxiter, tel);
+  return elnetKernel<false>(lambda1, lambda2, lambda_ct, diag, X, n, p, r,
+                            traits, ldr, adj, thr, x, yhat, trace, maxiter, tel);
+}
+
+int fista(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int j;
+
+  // the thresholding of elnet, with lambda1 and the cross trait penalty
+  // scaled by the step size: its fixed points are those of elnet
+  std::vector<double> denom(p), ctp(p, 0.0), offdiag(p);
+  for(j=0; j < p; j++) {
+    denom[j] = diag[j] + lambda2 + lambda_ct*adj[j];
+    if(traits > 1) ctp[j] = lambda_ct * r[j + ldr];
+    // coordinate descent takes a unit step: the Hessian is X'X plus the
+    // diagonal that makes its diagonal 1
+    offdiag[j] = 1.0 - diag[j];
+  }
+
+  // step size 1/L, L the largest eigenvalue of the Hessian (power iteration,
+  // with a margin as it converges from below)
+  std::vector<double> v(p), Xv(n), g(p);
+  for(j=0; j < p; j++) v[j] = (j % 2) ? 1.0 : -1.0;
+  double L = 0.0;
+  for(int it=0; it < 30; it++) {
+    const double norm = sqrt(dotProduct(&v[0], &v[0], p));
+    if(norm == 0.0) break;
+    for(j=0; j < p; j++) v[j] /= norm;
+    std::fill(Xv.begin(), Xv.end(), 0.0);
+    for(j=0; j < p; j++) {
+      if(v[j] == 0.0) continue;
+      const double* Xj = X + (size_t) j * n;
+      for(int i=0; i < n; i++) Xv[i] += v[j] * Xj[i];
+    }
+    for(j=0; j < p; j++) g[j] = dotProduct(X + (size_t) j * n, &Xv[0], n) + offdiag[j] * v[j];
+    L = dotProduct(&v[0], &g[0], p);
+    v.swap(g);
+  }
+  const double eta = 1.0 / std::max(1.1 * L, 1e-12);
+
+  // x (with X x in yhat) and the extrapolated point y (with X y in Xy)
+  std::vector<double> y(x, x + p), Xy(yhat, yhat + n), xn(p), Xd(n);
+  double tk = 1.0, step = 0.0, best = HUGE_VAL;
+  long long updates = 0;
+  int conv = 0, bestk = 0, k;
+  tel.stop = 0;
+  for(k=0; k < maxiter; k++) {
+    // proximal gradient step from y
+    step = 0.0;
+    std::fill(Xd.begin(), Xd.end(), 0.0);
+    double restart = 0.0;
+    for(j=0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      const double grad = dotProduct(Xj, &Xy[0], n) + offdiag[j] * y[j] - r[j];
+      const double t = y[j] - eta * grad;
+      const double c = eta * ctp[j], l = eta * lambda1;
+      xn[j] = 0.0;
+      if(std::abs(t+c)-l > 0.0){
+        if(t+c-l > 0.0){
+          xn[j]=t-l+c/denom[j];
+        } else{
+          xn[j]=t+l+c/denom[j];
+        }
+      }
+      step = std::max(step, std::abs(xn[j] - y[j]) / eta);
+      const double del = xn[j] - x[j];
+      restart += (y[j] - xn[j]) * del;
+      if(del == 0.0) continue;
+      updates++;
+      for(int i=0; i < n; i++) Xd[i] += del * Xj[i];
+    }
+    // momentum, reset when it points uphill (adaptive restart)
+    double beta = 0.0;
+    if(restart > 0.0) {
+      tk = 1.0;
+    } else {
+      const double tn = 0.5 * (1.0 + sqrt(1.0 + 4.0 * tk * tk));
+      beta = (tk - 1.0) / tn;
+      tk = tn;
+    }
+    for(j=0; j < p; j++) {
+      y[j] = xn[j] + beta * (xn[j] - x[j]);
+      x[j] = xn[j];
+    }
+    for(int i=0; i < n; i++) {
+      yhat[i] += Xd[i];
+      Xy[i] = yhat[i] + beta * Xd[i];
+    }
+    checkInterrupt();
+    if(trace > 0) messages() << "fista " << k << ": " << step << "\n";
+    if(step < thr) {
+      conv = 1;
+      tel.stop = 1;
+      k++;
+      break;
+    }
+    // the cross trait term makes the thresholding discontinuous, and the
+    // iterations can cycle around its jumps: stop when they stall
+    if(step < best) {
+      best = step;
+      bestk = k;
+    } else if(k - bestk >= 50) {
+      k++;
+      break;
+    }
+  }
+
+  tel.sweeps = k;
+  tel.updates = updates;
+  tel.maxdelta = step;
+  // a stalled solve is finished by coordinate descent from where it stopped
+  if(!conv && k < maxiter) {
+    ElnetTelemetry cd;
+    conv = elnet(lambda1, lambda2, lambda_ct, diag, X, n, p, r, traits, ldr,
+                 adj, thr, x, yhat, trace, maxiter - k, cd);
+    tel.sweeps += cd.sweeps;
+    tel.updates += cd.updates;
+    tel.maxdelta = cd.maxdelta;
+    tel.stop = cd.stop;
+  }
+  tel.active = 0;
+  for(j=0; j < p; j++) {
+    if(x[j] != 0.0) tel.active++;
+  }
+  tel.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return conv;
+}
+
+void carrierColumns(const double* X, int n, int p, double maxfraction,
+                    CarrierColumns& cc)
+{
+  cc.column.assign(p, -1);
+  cc.start.assign(1, 0);
+  cc.row.clear();
+  cc.delta.clear();
+  cc.base.clear();
+  cc.deltasum.clear();
+  cc.colsum.assign(p, 0.0);
+  const int maxcarriers = (int) (maxfraction * n);
+  for (int j = 0; j < p; j++) {
+    const double* Xj = X + (size_t) j * n;
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += Xj[i];
+    cc.colsum[j] = sum;
+    if (maxcarriers < 1) continue;
+    // a base with at most maxcarriers carriers is one of the first
+    // maxcarriers + 1 values; try those in order of appearance, giving up on
+    // each as soon as it has too many carriers (a genotype column has at
+    // most 4 values: 0, 1, 2 and the fill of missing ones)
+    double tried[4];
+    int ntried = 0, next = 0;
+    bool rare = false;
+    double base = 0.0;
+    while (!rare && ntried < 4 && next <= maxcarriers && next < n) {
+      base = tried[ntried++] = Xj[next];
+      int carriers = 0;
+      for (int i = 0; i < n && carriers <= maxcarriers; i++) carriers += Xj[i] != base;
+      rare = carriers <= maxcarriers;
+      while (next <= maxcarriers && next < n &&
+             std::find(tried, tried + ntried, Xj[next]) != tried + ntried)
+        next++;
+    }
+    if (!rare) continue;
+    double deltasum = 0.0;
+    for (int i = 0; i < n; i++) {
+      if (Xj[i] == base) continue;
+      cc.row.push_back(i);
+      cc.delta.push_back(Xj[i] - base);
+      deltasum += Xj[i] - base;
+    }
+    cc.column[j] = cc.base.size();
+    cc.base.push_back(base);
+    cc.deltasum.push_back(deltasum);
+    cc.start.push_back(cc.row.size());
+  }
+}
+
+namespace {
+
+/**
+ elnet on the columns from, ..., from + p - 1 of the carrier lists cc (X
+ is still the block of the dense matrix, for its dense columns). yhat is
+ kept as yt + off with a scalar offset off, so that the visit of a column
+ with a carrier list costs O(carriers): X_j'yhat is base (sum(yt) + n off)
+ plus the carrier terms, and yhat += del X_j adds del base to off and
+ del delta to the carriers of yt. elnetCarriers runs the instantiation for
+ the number of traits.
+
+ */
+template <bool CrossTrait>
+int elnetCarriersKernel(double lambda1, double lambda2, double lambda_ct,
+                        const double* diag, const double* X, int n, int p,
+                        const double* r, int traits, int ldr, const double* adj,
+                        double thr, double* x, double* yhat, int trace,
+                        int maxiter, const CarrierColumns& cc, int from,
+                        ElnetTelemetry& tel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  double dlx_cur, dlx_pre,del,t,xj;
+  int j,i;
+
+  const CoordinateConstants constants(diag, lambda2, lambda_ct, r, traits,
+                                      ldr, adj, p);
+
+  // yhat = yt + off, with sumyt = sum(yt)
+  double* yt = yhat;
+  double off = 0.0, sumyt = 0.0;
+  for(i=0; i < n; i++) sumyt += yt[i];
+
+  int conv=0;
+  int count=0;
+  long long updates=0;
+  dlx_pre=0.0;
+  dlx_cur=0.0;
+  tel.stop=0;
+  for(int k=0;k<maxiter ;k++) {
+    tel.sweeps=k+1;
+    dlx_cur=0.0;
+    for(j=0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      const int c = cc.column[from + j];
+      del=0.0;
+      xj=x[j];
+      x[j]=0.0;
+      double dot=0.0;
+      if(c < 0) {
+        for(i=0; i < n; i++) dot += Xj[i] * yt[i];
+        dot += off * cc.colsum[from + j];
+      } else {
+        for(size_t e=cc.start[c]; e < cc.start[c + 1]; e++)
+          dot += cc.delta[e] * yt[cc.row[e]];
+        dot += off * cc.deltasum[c] + cc.base[c] * (sumyt + n * off);
+      }
+      t= diag[j] * xj + r[j] - dot;
+
+      x[j]=coordinateUpdate<CrossTrait>(t, lambda1, constants.ctp[j],
+                                        constants.shift[j]);
+
+      if(x[j]==xj) continue;
+      del=x[j]-xj;
+      updates++;
+
+      if(c < 0) {
+        for(i=0; i < n; i++) yt[i] += del*Xj[i];
+        sumyt += del * cc.colsum[from + j];
+      } else {
+        for(size_t e=cc.start[c]; e < cc.start[c + 1]; e++)
+          yt[cc.row[e]] += del * cc.delta[e];
+        off += del * cc.base[c];
+        sumyt += del * cc.deltasum[c];
+      }
+      dlx_cur=std::max(dlx_cur,std::abs(del));
+    }
+    if(std::abs(dlx_cur-dlx_pre)<1e-6){
+      count++;
+    } else{
+      count=0;
+    }
+    dlx_pre=dlx_cur;
+    checkInterrupt();
+
+    if(dlx_cur < thr) {
+      conv=1;
+      tel.stop=1;
+      break;
+    }
+    if(count >= 50){
+      conv=1;
+      tel.stop=2;
+      break;
+    }
+  }
+  for(i=0; i < n; i++) yt[i] += off;
+
+  tel.updates=updates;
+  tel.maxdelta=dlx_cur;
+  tel.active=0;
+  for(j=0; j < p; j++) {
+    if(x[j] != 0.0) tel.active++;
+  }
+  tel.time=std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return conv;
+}
+
+int elnetCarriers(double lambda1, double lambda2, double lambda_ct,
+                  const double* diag, const double* X, int n, int p,
+                  const double* r, int traits, int ldr, const double* adj,
+                  double thr, double* x, double* yhat, int trace, int maxiter,
+                  const CarrierColumns& cc, int from, ElnetTelemetry& tel)
+{
+  if(traits > 1)
+    return elnetCarriersKernel<true>(lambda1, lambda2, lambda_ct, diag, X, n, p,
+                                     r, traits, ldr, adj, thr, x, yhat, trace,
+                                     maxiter, cc, from, tel);
+  return elnetCarriersKernel<false>(lambda1, lambda2, lambda_ct, diag, X, n, p,
+                                    r, traits, ldr, adj, thr, x, yhat, trace,
+                                    maxiter, cc, from, tel);
+}
+
+}
+
+namespace {
+
+std::atomic<int> fistaFrom(0);
+
+}
+
+void setFistaVariants(int variants) {
+  fistaFrom.store(std::max(0, variants));
+}
+
+int fistaVariants() {
+  return fistaFrom.load();
+}
+
+int blockSolver(int solver, int variants) {
+  if(solver != solverTuned) return solver;
+  const int from=fistaVariants();
+  return (from > 0 && variants >= from) ? solverFISTA : solverCD;
+}
+
+int solveBlock(int solver, double lambda1, double lambda2, double lambda_ct,
+               const double* diag, const double* X, int n, int p,
+               const double* r, int traits, int ldr, const double* adj,
+               double thr, double* x, double* yhat, int trace, int maxiter,
+               ElnetTelemetry& tel)
+{
+  solver=blockSolver(solver, p);
+  if(solver == solverFISTA) {
+    return fista(lambda1, lambda2, lambda_ct, diag, X, n, p, r, traits, ldr,
+                 adj, thr, x, yhat, trace, maxiter, tel);
+  }
+  int conv=elnet(lambda1, lambda2, lambda_ct, diag, X, n, p, r, traits, ldr,
+                 adj, thr, x, yhat, trace, maxiter, tel);
+  if(conv || solver != solverAuto) return conv;
+
+  // coordinate descent did not converge: go on with FISTA from its point
+  ElnetTelemetry acc;
+  conv=fista(lambda1, lambda2, lambda_ct, diag, X, n, p, r, traits, ldr,
+             adj, thr, x, yhat, trace, maxiter, acc);
+  tel.sweeps += acc.sweeps;
+  tel.updates += acc.updates;
+  tel.maxdelta = acc.maxdelta;
+  tel.active = acc.active;
+  tel.time += acc.time;
+  tel.stop = acc.stop;
+  return conv;
+}
+
+int repelnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+             const double* X, int n, int p, const double* r, int traits,
+             const double* adj, double thr, double* x, double* yhat,
+             int trace, int maxiter,
+             const int* startvec, const int* endvec, int nblocks,
+             std::vector<ElnetTelemetry>& tel)
+{
+  return repelnetSolver(lambda1, lambda2, lambda_ct, diag, X, n, p, r, traits,
+                        adj, thr, x, yhat, trace, maxiter, solverCD, 0,
+                        startvec, endvec, nblocks, tel);
+}
+
+int repelnetSolver(double lambda1, double lambda2, double lambda_ct,
+                   const double* diag, const double* X, int n, int p,
+                   const double* r, int traits, const double* adj, double thr,
+                   double* x, double* yhat, int trace, int maxiter, int solver,
+                   const CarrierColumns* carriers,
+                   const int* startvec, const int* endvec, int nblocks,
+                   std::vector<ElnetTelemetry>& tel)
+{
+
+  // Repeatedly call elnet by blocks, the blocks split between the threads
+  // (threads()); each range of blocks sums its X_b x_b, and the sums are
+  // added to yhat in range order
+  std::vector<int> conv(nblocks, 1);
+  std::vector<ElnetTelemetry> blocktel(nblocks);
+  const int ranges = std::max(1, std::min(nblocks, threads()));
+  std::vector<std::vector<double> > partial(ranges);
+  parallelFor(nblocks, ranges, [&](int range, int from, int to) {
+    std::vector<double>& yrange = partial[range];
+    yrange.assign(n, 0.0);
+    std::vector<double> yhattouse(n);
+    for(int i=from;i < to; i++) {
+
+      const int s=startvec[i];
+      const int len=endvec[i] - s + 1;
+      const double* Xb=X + (size_t) s * n;
+
+      // yhattouse = X.cols(s, e) * x.subvec(s, e)
+      std::fill(yhattouse.begin(), yhattouse.end(), 0.0);
+      for(int j=0; j < len; j++) {
+        const double xj=x[s + j];
+        if(xj == 0.0) continue;
+        const double* Xj=Xb + (size_t) j * n;
+        for(int k=0; k < n; k++) yhattouse[k] += xj * Xj[k];
+      }
+
+      conv[i]=carriers && blockSolver(solver, len) == solverCD ?
+        elnetCarriers(lambda1, lambda2, lambda_ct, diag + s, Xb, n, len, r + s,
+                      traits, p, adj + s, thr, x + s, &yhattouse[0], trace - 1,
+                      maxiter, *carriers, s, blocktel[i]) :
+        solveBlock(solver, lambda1, lambda2, lambda_ct, diag + s, Xb, n, len,
+                   r + s, traits, p, adj + s, thr, x + s, &yhattouse[0],
+                   trace - 1, maxiter, blocktel[i]);
+
+      for(int k=0; k < n; k++) yrange[k] += yhattouse[k];
+
+      if(trace > 0) messages() << "Block: " << i << "\n";
+    }
+  });
+  for(size_t range=0; range < partial.size(); range++) {
+    if(partial[range].empty()) continue;
+    for(int k=0; k < n; k++) yhat[k] += partial[range][k];
+  }
+  tel.insert(tel.end(), blocktel.begin(), blocktel.end());
+  int out=1;
+  for(int i=0; i < nblocks; i++) out=std::min(out, conv[i]);
+  return out;
+}
+
+namespace {
+
+/**
+ The smooth part of the objective of elnet on a block of len columns of X:
+ ||X x||^2 + sum (1 - diag) x^2 - 2 x'b, with b = r + ctp/denom the right
+ hand side of the ridge solution (work: n)
+
+ */
+double blockQuadratic(const double* X, int n, int len, const double* x,
+                      const double* diag, const double* b,
+                      std::vector<double>& work) {
+  work.assign(n, 0.0);
+  double q = 0.0;
+  for (int j = 0; j < len; j++) {
+    if (x[j] == 0.0) continue;
+    const double* Xj = X + (size_t) j * n;
+    for (int i = 0; i < n; i++) work[i] += x[j] * Xj[i];
+    q += (1.0 - diag[j]) * x[j] * x[j] - 2.0 * x[j] * b[j];
+  }
+  return q + dotProduct(&work[0], &work[0], n);
+}
+
+/**
+ sum |x|
+
+ */
+double l1Norm(const double* x, int n) {
+  double s = 0.0;
+  for (int i = 0; i < n; i++) s += std::abs(x[i]);
+  return s;
+}
+
+}
+
+void elnetPath(const double* lambda, int nlambda, double shrink, double lambda_ct,
+               const double* X, const double* sd, int n, int p,
+               const double* r, int traits, const double* adj, double thr,
+               double* x, int trace, int maxiter, int solver,
+               const RidgeBasis* ridge, int subsample, unsigned long long seed,
+               double carriers,
+               const int* startvec, const int* endvec, int nblocks,
+               ElnetPath& path)
+{
+  int i,j;
+  std::vector<double> diag(p, 1.0 - shrink);
+  for(j=0; j < p; j++) {
+    if(sd[j] == 0.0) diag[j] = 0.0;
+  }
+  const bool coarse = subsample > 0 && subsample < n;
+
+  // carrier lists of the rare variants
+  CarrierColumns cc;
+  if(carriers > 0.0) carrierColumns(X, n, p, carriers, cc);
+  path.carriers = cc.base.size();
+
+  // right hand side of the ridge solution, for the objectives of the starts
+  std::vector<double> rhs, work;
+  if(ridge || coarse) {
+    rhs.assign(r, r + p);
+    if(traits > 1) {
+      for(j=0; j < p; j++)
+        rhs[j] += lambda_ct * r[j + p] / (diag[j] + shrink + lambda_ct * adj[j]);
+    }
+  }
+
+  // ridge solution of each block, with the smooth part and the L1 norm of
+  // its objective (which do not depend on lambda)
+  std::vector<double> xridge, ridgeq(nblocks), ridgel1(nblocks, 0.0);
+  if(ridge) {
+    xridge.resize(p);
+    ridgeSolution(*ridge, shrink, lambda_ct, sd, p, r, traits, adj, startvec,
+                  endvec, nblocks, &xridge[0]);
+    for(int b=0; b < nblocks; b++) {
+      const int len=endvec[b] - startvec[b] + 1;
+      const int s=startvec[b];
+      ridgeq[b]=blockQuadratic(X + (size_t) s * n, n, len, &xridge[s], &diag[s],
+                               &rhs[s], work);
+      ridgel1[b]=l1Norm(&xridge[s], len);
+    }
+  }
+
+  // coarse panel: a random subsample of the rows of X, with its columns
+  // rescaled to the norms of those of X so that diag stays exact
+  std::vector<double> Xs, diags, xs, ys;
+  if(coarse) {
+    std::vector<int> rows(n);
+    for(i=0; i < n; i++) rows[i]=i;
+    std::mt19937_64 rng(seed);
+    for(i=0; i < subsample; i++) {
+      std::uniform_int_distribution<int> pick(i, n - 1);
+      std::swap(rows[i], rows[pick(rng)]);
+    }
+    rows.resize(subsample);
+    std::sort(rows.begin(), rows.end());
+    Xs.assign((size_t) subsample * p, 0.0);
+    diags=diag;
+    for(j=0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      double* Xsj = &Xs[(size_t) j * subsample];
+      for(i=0; i < subsample; i++) Xsj[i] = Xj[rows[i]];
+      const double ss=dotProduct(Xsj, Xsj, subsample);
+      if(ss == 0.0) {
+        diags[j]=0.0;
+        continue;
+      }
+      const double scale=sqrt(dotProduct(Xj, Xj, n) / ss);
+      for(i=0; i < subsample; i++) Xsj[i] *= scale;
+    }
+  }
+
+  path.beta.assign((size_t) p * nlambda, 0.0);
+  path.pred.assign((size_t) n * nlambda, 0.0);
+  path.loss.assign(nlambda, 0.0);
+  path.fbeta.assign(nlambda, 0.0);
+  path.conv.assign(nlambda, 0);
+  path.tel.clear();
+  path.tellambda.clear();
+
+  std::vector<double> yhat(n, 0.0);
+  std::vector<ElnetTelemetry> tel;
+  for(i=0; i < nlambda; ++i) {
+    if(trace > 0) messages() << "lambda: " << lambda[i] << "\n" << std::endl;
+    // start each block from whichever of x, its ridge solution and, without
+    // a warm start, its solution on the coarse panel has the lowest
+    // objective at this lambda (from a warm start, the coarse solution is
+    // further from the solution on the full panel than x)
+    std::vector<ElnetTelemetry> start(nblocks);
+    std::vector<double> coarsef(nblocks, 0.0);
+    for(int b=0; (ridge || coarse) && b < nblocks; b++) {
+      const int s=startvec[b], len=endvec[b] - s + 1;
+      const double* Xb=X + (size_t) s * n;
+      double f=blockQuadratic(Xb, n, len, x + s, &diag[s], &rhs[s], work) +
+        2.0 * lambda[i] * l1Norm(x + s, len);
+      if(ridge && ridgeq[b] + 2.0 * lambda[i] * ridgel1[b] < f) {
+        f=ridgeq[b] + 2.0 * lambda[i] * ridgel1[b];
+        std::copy(&xridge[s], &xridge[s] + len, x + s);
+        start[b].ridge=1;
+      }
+      if(coarse && l1Norm(x + s, len) == 0.0) {
+        xs.assign(x + s, x + s + len);
+        ys.assign(subsample, 0.0);
+        for(j=0; j < len; j++) {
+          if(xs[j] == 0.0) continue;
+          const double* Xj=&Xs[(size_t) (s + j) * subsample];
+          for(int k=0; k < subsample; k++) ys[k] += xs[j] * Xj[k];
+        }
+        ElnetTelemetry ctel;
+        elnet(lambda[i], shrink, lambda_ct, &diags[s],
+              &Xs[(size_t) s * subsample], subsample, len, r + s, traits, p,
+              adj + s, thr, &xs[0], &ys[0], trace - 2, maxiter, ctel);
+        start[b].coarsesweeps=ctel.sweeps;
+        start[b].coarsetime=ctel.time;
+        coarsef[b]=blockQuadratic(Xb, n, len, &xs[0], &diag[s], &rhs[s], work) +
+          2.0 * lambda[i] * l1Norm(&xs[0], len);
+        if(coarsef[b] < f) {
+          std::copy(xs.begin(), xs.end(), x + s);
+          start[b].ridge=0;
+          start[b].coarse=1;
+        }
+      }
+    }
+    tel.clear();
+    path.conv[i] = repelnetSolver(lambda[i], shrink, lambda_ct, &diag[0], X, n,
+                                  p, r, traits, adj, thr, x, &yhat[0], trace-1,
+                                  maxiter, solver, carriers > 0.0 ? &cc : 0,
+                                  startvec, endvec, nblocks, tel);
+    for(j=0; j < (int) tel.size(); j++) {
+      tel[j].ridge=start[j].ridge;
+      tel[j].coarse=start[j].coarse;
+      tel[j].coarsesweeps=start[j].coarsesweeps;
+      tel[j].coarsetime=start[j].coarsetime;
+      if(coarse) {
+        const int s=startvec[j], len=endvec[j] - s + 1;
+        tel[j].coarsegap=coarsef[j] -
+          (blockQuadratic(X + (size_t) s * n, n, len, x + s, &diag[s], &rhs[s],
+                          work) + 2.0 * lambda[i] * l1Norm(x + s, len));
+      }
+      path.tel.push_back(tel[j]);
+      path.tellambda.push_back(i);
+    }
+
+    double* beta = &path.beta[(size_t) i * p];
+    for(j=0; j < p; j++) {
+      beta[j] = x[j];
+      if(sd[j] == 0.0) beta[j] *= shrink;
+    }
+    std::copy(yhat.begin(), yhat.end(), path.pred.begin() + (size_t) i * n);
+
+    double yy=0.0, xr=0.0, l1=0.0, l2=0.0;
+    for(j=0; j < n; j++) yy += yhat[j] * yhat[j];
+    for(j=0; j < p; j++) {
+      xr += x[j] * r[j];
+      l1 += std::abs(x[j]);
+      l2 += x[j] * x[j];
+    }
+    path.loss[i] = yy - 2.0 * xr;
+    path.fbeta[i] = path.loss[i] + 2.0 * l1 * lambda[i] + l2 * shrink;
+  }
+}
+
+void ridgeBasis(const double* X, const double* sd, int n, int p,
+                const int* startvec, const int* endvec, int nblocks,
+                RidgeBasis& basis)
+{
+  basis.start.assign(nblocks + 1, 0);
+  basis.k.assign(nblocks, 0);
+  basis.offset.assign(nblocks, 0);
+  basis.column.clear();
+  basis.values.clear();
+  basis.vectors.clear();
+  for (int b = 0; b < nblocks; b++) {
+    std::vector<int> cols;
+    for (int j = startvec[b]; j <= endvec[b]; j++) {
+      if (sd[j] != 0.0) cols.push_back(j);
+    }
+    const int m = cols.size();
+    std::vector<double> A, values, V;
+    if (m <= n) {
+      // eigenvectors of X'X
+      A.assign((size_t) m * m, 0.0);
+      for (int a = 0; a < m; a++) {
+        const double* Xa = X + (size_t) cols[a] * n;
+        for (int c = a; c < m; c++) {
+          const double v = dotProduct(Xa, X + (size_t) cols[c] * n, n);
+          A[(size_t) c * m + a] = v;
+          A[(size_t) a * m + c] = v;
+        }
+      }
+      symmetricEigen(A, m, values, V);
+    } else {
+      // more variants than samples: X'X = V D V' with V = X'U D^-1/2, from
+      // the eigenvectors U of the n x n matrix X X'
+      A.assign((size_t) n * n, 0.0);
+      for (int a = 0; a < m; a++) {
+        const double* Xa = X + (size_t) cols[a] * n;
+        for (int c = 0; c < n; c++) {
+          const double xc = Xa[c];
+          if (xc == 0.0) continue;
+          double* Ac = &A[(size_t) c * n];
+          for (int i = 0; i < n; i++) Ac[i] += xc * Xa[i];
+        }
+      }
+      std::vector<double> U;
+      symmetricEigen(A, n, values, U);
+      int k = 0;
+      while (k < n && values[k] > 1e-10 * values[0]) k++;
+      values.resize(k);
+      V.assign((size_t) m * k, 0.0);
+      for (int c = 0; c < k; c++) {
+        const double* Uc = &U[(size_t) c * n];
+        const double scale = 1.0 / sqrt(values[c]);
+        for (int a = 0; a < m; a++) {
+          V[(size_t) c * m + a] = scale * dotProduct(X + (size_t) cols[a] * n, Uc, n);
+        }
+      }
+    }
+    basis.k[b] = values.size();
+    basis.offset[b] = basis.vectors.size();
+    basis.column.insert(basis.column.end(), cols.begin(), cols.end());
+    basis.values.insert(basis.values.end(), values.begin(), values.end());
+    basis.vectors.insert(basis.vectors.end(), V.begin(), V.end());
+    basis.start[b + 1] = basis.column.size();
+    checkInterrupt();
+  }
+}
+
+void ridgeSolution(const RidgeBasis& basis, double shrink, double lambda_ct,
+                   const double* sd, int p, const double* r, int traits,
+                   const double* adj, const int* startvec, const int* endvec,
+                   int nblocks, double* x)
+{
+  std::vector<double> rhs, w;
+  int valuestart = 0;
+  for (int b = 0; b < nblocks; b++) {
+    // r + ctp/denom, and the variants with sd == 0 (diag = 0: their row of
+    // the system is x(j) = r(j) + ctp/denom)
+    for (int j = startvec[b]; j <= endvec[b]; j++) {
+      const double diag = sd[j] == 0.0 ? 0.0 : 1.0 - shrink;
+      x[j] = r[j];
+      if (traits > 1)
+        x[j] += lambda_ct * r[j + p] / (diag + shrink + lambda_ct * adj[j]);
+    }
+    const int from = basis.start[b], m = basis.start[b + 1] - from;
+    const int k = basis.k[b];
+    const int* cols = &basis.column[from];
+    const double* V = &basis.vectors[basis.offset[b]];
+    const double* values = &basis.values[valuestart];
+    valuestart += k;
+    rhs.resize(m);
+    for (int a = 0; a < m; a++) rhs[a] = x[cols[a]];
+
+    // ((1-s) X'X + s I)^-1 rhs = V diag(1/((1-s) d + s)) V' rhs, plus
+    // (I - V V') rhs / s on the complement of V
+    w.resize(k);
+    for (int c = 0; c < k; c++) w[c] = dotProduct(V + (size_t) c * m, &rhs[0], m);
+    std::vector<double> sol(m, 0.0);
+    const bool complement = k < m;
+    if (complement) {
+      for (int a = 0; a < m; a++) sol[a] = rhs[a] / shrink;
+    }
+    for (int c = 0; c < k; c++) {
+      const double* Vc = V + (size_t) c * m;
+      const double coef = w[c] / ((1.0 - shrink) * values[c] + shrink) -
+        (complement ? w[c] / shrink : 0.0);
+      for (int a = 0; a < m; a++) sol[a] += coef * Vc[a];
+    }
+    for (int a = 0; a < m; a++) x[cols[a]] = sol[a];
+  }
+}
+
+void sketchGenotypes(const std::string& fileName, int N, int P,
+                     const BedSelection& sel,
+                     const int* startvec, const int* endvec, int nblocks,
+                     const int* k, int method, unsigned long long seed,
+                     SketchedPanel& panel)
+{
+  if (method != 0 && method != 1)
+    throw std::runtime_error("Unknown sketch method");
+  const int n = selectedSamples(N, sel);
+  const int p = selectedVariants(P, sel);
+  const std::vector<int> column = selectedColumns(P, sel);
+
+  panel.offset.assign(nblocks, 0);
+  panel.k.assign(nblocks, 0);
+  panel.mean.assign(p, 0.0);
+  panel.sd.assign(p, 0.0);
+  panel.lderror.assign(nblocks, 0.0);
+  size_t total = 0;
+  for (int b = 0; b < nblocks; b++) {
+    if (k[b] < 1) throw std::runtime_error("Sketch sizes must be positive");
+    panel.k[b] = std::min(k[b], n);
+    panel.offset[b] = total;
+    total += (size_t) panel.k[b] * (endvec[b] - startvec[b] + 1);
+  }
+  panel.X.assign(total, 0.0);
+
+  std::vector<int> pos, len;
+  std::vector<double> G;
+  for (int b = 0; b < nblocks; b++) {
+    const int s = startvec[b];
+    const int l = endvec[b] - s + 1;
+    const BedSelection range = columnRange(P, sel, column, s, endvec[b], pos, len);
+    G.resize((size_t) n * l);
+    genotypeMatrix(fileName, N, P, range, 1, &G[0]);
+    for (int j = 0; j < l; j++) {
+      const double* Gj = &G[(size_t) j * n];
+      double m = 0.0;
+      for (int i = 0; i < n; i++) m += Gj[i];
+      panel.mean[s + j] = m / n;
+    }
+    normalize(&G[0], n, l, &panel.sd[s]);
+
+    double* out = &panel.X[panel.offset[b]];
+    const int kb = panel.k[b];
+    if (kb == n) {
+      std::copy(G.begin(), G.end(), out);
+      continue;
+    }
+    std::mt19937_64 rng(seed + 0x9E3779B97F4A7C15ULL * (b + 1));
+    sketchColumns(&G[0], n, l, kb, method, rng, out);
+    panel.lderror[b] = sketchError(&G[0], n, out, kb, l, 0, rng);
+  }
+}
+
+void lowRankGenotypes(const std::string& fileName, int N, int P,
+                      const BedSelection& sel,
+                      const int* startvec, const int* endvec, int nblocks,
+                      const int* k, double variance, unsigned long long seed,
+                      SketchedPanel& panel)
+{
+  if (!(variance > 0.0 && variance <= 1.0))
+    throw std::runtime_error("The fraction of variance must be in (0, 1]");
+  const int n = selectedSamples(N, sel);
+  const int p = selectedVariants(P, sel);
+  const std::vector<int> column = selectedColumns(P, sel);
+
+  panel.X.clear();
+  panel.offset.assign(nblocks, 0);
+  panel.k.assign(nblocks, 0);
+  panel.mean.assign(p, 0.0);
+  panel.sd.assign(p, 0.0);
+  panel.lderror.assign(nblocks, 0.0);
+  panel.residual.assign(p, 0.0);
+  panel.variance.assign(nblocks, 1.0);
+
+  std::vector<int> pos, len;
+  std::vector<double> G, B, values;
+  for (int b = 0; b < nblocks; b++) {
+    if (k[b] < 0) throw std::runtime_error("Ranks must not be negative");
+    const int s = startvec[b];
+    const int l = endvec[b] - s + 1;
+    const BedSelection range = columnRange(P, sel, column, s, endvec[b], pos, len);
+    G.resize((size_t) n * l);
+    genotypeMatrix(fileName, N, P, range, 1, &G[0]);
+    for (int j = 0; j < l; j++) {
+      const double* Gj = &G[(size_t) j * n];
+      double m = 0.0;
+      for (int i = 0; i < n; i++) m += Gj[i];
+      panel.mean[s + j] = m / n;
+    }
+    normalize(&G[0], n, l, &panel.sd[s]);
+    double total = 0.0;
+    for (int j = 0; j < l; j++) total += panel.sd[s + j] == 0.0 ? 0.0 : 1.0;
+
+    // rank k[b], or (k[b] = 0) the smallest one explaining the fraction
+    // variance of the block, doubling the size of the SVD until it does
+    std::mt19937_64 rng(seed + 0x9E3779B97F4A7C15ULL * (b + 1));
+    const int full = std::min(n, l);
+    int size = k[b] > 0 ? std::min(k[b] + 10, full) : std::min(64, full);
+    int kb;
+    for (;;) {
+      randomizedSVD(&G[0], n, l, size, rng, B, values);
+      if (k[b] > 0) {
+        kb = std::min(k[b], size);
+        break;
+      }
+      double captured = 0.0;
+      for (kb = 0; kb < size && captured < variance * total; kb++)
+        captured += std::max(values[kb], 0.0);
+      // keep 10 columns beyond the rank, as with a given rank
+      if ((captured >= variance * total && kb + 10 <= size) || size == full) break;
+      size = std::min(2 * size, full);
+    }
+    kb = std::max(kb, 1);
+
+    panel.k[b] = kb;
+    panel.offset[b] = panel.X.size();
+    panel.X.resize(panel.X.size() + (size_t) kb * l);
+    double* out = &panel.X[panel.offset[b]];
+    double captured = 0.0;
+    for (int j = 0; j < l; j++) {
+      const double* Bj = &B[(size_t) j * size];
+      std::copy(Bj, Bj + kb, out + (size_t) j * kb);
+      const double ss = dotProduct(Bj, Bj, kb);
+      captured += ss;
+      // the diagonal of the LD matrix stays exact
+      if (panel.sd[s + j] != 0.0) panel.residual[s + j] = std::max(1.0 - ss, 0.0);
+    }
+    panel.variance[b] = total > 0.0 ? captured / total : 1.0;
+    panel.lderror[b] = sketchError(&G[0], n, out, kb, l, &panel.residual[s], rng);
+  }
+}
+
+void elnetPathSketched(const double* lambda, int nlambda, double shrink,
+                       double lambda_ct, const SketchedPanel& panel, int p,
+                       const double* r, int traits, const double* adj, double thr,
+                       double* x, int trace, int maxiter, int solver,
+                       const int* startvec, const int* endvec, int nblocks,
+                       ElnetPath& path)
+{
+  int i,j;
+  // with a residual diagonal D, the LD matrix of a block is X'X + D; as D
+  // only adds to the diagonal, its self-term is left out of diag
+  const bool residual = !panel.residual.empty();
+  std::vector<double> diag(p, 1.0 - shrink);
+  for(j=0; j < p; j++) {
+    if(panel.sd[j] == 0.0) diag[j] = 0.0;
+    else if(residual) diag[j] *= 1.0 - panel.residual[j];
+  }
+
+  path.beta.assign((size_t) p * nlambda, 0.0);
+  path.pred.clear();
+  path.loss.assign(nlambda, 0.0);
+  path.fbeta.assign(nlambda, 0.0);
+  path.conv.assign(nlambda, 0);
+  path.tel.clear();
+  path.tellambda.clear();
+
+  std::vector<double> yhat;
+  for(i=0; i < nlambda; ++i) {
+    if(trace > 0) messages() << "lambda: " << lambda[i] << "\n" << std::endl;
+    int conv=1;
+    double yy=0.0;
+    for(int b=0; b < nblocks; b++) {
+      const int s=startvec[b];
+      const int len=endvec[b] - s + 1;
+      const int kb=panel.k[b];
+      const double* Xb=&panel.X[panel.offset[b]];
+
+      // yhat = X.cols(s, e) * x.subvec(s, e) on the sketch
+      yhat.assign(kb, 0.0);
+      for(j=0; j < len; j++) {
+        const double xj=x[s + j];
+        if(xj == 0.0) continue;
+        const double* Xj=Xb + (size_t) j * kb;
+        for(int k=0; k < kb; k++) yhat[k] += xj * Xj[k];
+      }
+
+      ElnetTelemetry blocktel;
+      const int out=solveBlock(solver, lambda[i], shrink, lambda_ct, &diag[s],
+                               Xb, kb, len, r + s, traits, p, adj + s, thr,
+                               x + s, &yhat[0], trace - 2, maxiter, blocktel);
+      path.tel.push_back(blocktel);
+      path.tellambda.push_back(i);
+      conv=std::min(conv, out);
+      for(int k=0; k < kb; k++) yy += yhat[k] * yhat[k];
+      if(trace > 1) messages() << "Block: " << b << "\n";
+    }
+    path.conv[i]=conv;
+
+    double* beta = &path.beta[(size_t) i * p];
+    for(j=0; j < p; j++) {
+      beta[j] = x[j];
+      if(panel.sd[j] == 0.0) beta[j] *= shrink;
+    }
+
+    double xr=0.0, l1=0.0, l2=0.0;
+    for(j=0; j < p; j++) {
+      if(residual) yy += (1.0 - shrink) * panel.residual[j] * x[j] * x[j];
+      xr += x[j] * r[j];
+      l1 += std::abs(x[j]);
+      l2 += x[j] * x[j];
+    }
+    path.loss[i] = yy - 2.0 * xr;
+    path.fbeta[i] = path.loss[i] + 2.0 * l1 * lambda[i] + l2 * shrink;
+  }
+}
+
+void appendSparseLD(const double* X, int n, int p, int from, const double* pos,
+                    double window, double r2, SparseLD& ld)
+{
+  if (ld.rowptr.empty()) ld.rowptr.push_back(0);
+  if ((int) ld.rowptr.size() != from + 1)
+    throw std::runtime_error("Sparse LD blocks must be appended in order");
+  SparseRows rows(p);
+  bool dropped = false;
+  for (int j = 0; j < p; j++) {
+    checkInterrupt();
+    const double* Xj = X + (size_t) j * n;
+    rows[j].push_back(std::make_pair(j, dotProduct(Xj, Xj, n)));
+    for (int k = j + 1; k < p; k++) {
+      const double c = dotProduct(Xj, X + (size_t) k * n, n);
+      const bool near = window > 0.0 && std::abs(pos[k] - pos[j]) <= window;
+      if (!near && (c == 0.0 || c * c < r2)) {
+        dropped = dropped || c != 0.0;
+        continue;
+      }
+      rows[j].push_back(std::make_pair(k, c));
+      rows[k].push_back(std::make_pair(j, c));
+    }
+  }
+  // Thresholding can make the block indefinite, and coordinate descent then
+  // diverges. The off-diagonal correlations are shrunk towards 0 until the
+  // smallest eigenvalue is at least ldMargin (a complete block is left as
+  // is). The estimate is an upper bound, so the shrunk block is estimated
+  // again, and shrunk further while it is still negative.
+  const double ldMargin = 0.05;
+  double offdiag = 1.0;
+  double smallest = std::numeric_limits<double>::quiet_NaN();
+  if (dropped) {
+    smallest = smallestEigenvalue(rows);
+    for (int round = 0; round < 20 && smallest < (round == 0 ? ldMargin : 0.0); round++) {
+      // the eigenvalues of I + f (R - I) are 1 + f (lambda - 1)
+      const double f = (1.0 - ldMargin) / (1.0 - smallest);
+      for (int j = 0; j < p; j++) {
+        for (size_t e = 0; e < rows[j].size(); e++)
+          if (rows[j][e].first != j) rows[j][e].second *= f;
+      }
+      offdiag *= f;
+      smallest = smallestEigenvalue(rows);
+    }
+  }
+  ld.offdiag.push_back(offdiag);
+  ld.smallest.push_back(smallest);
+  for (int j = 0; j < p; j++) {
+    for (size_t e = 0; e < rows[j].size(); e++) {
+      ld.col.push_back(from + rows[j][e].first);
+      ld.value.push_back(rows[j][e].second);
+    }
+    ld.rowptr.push_back(ld.col.size());
+    std::vector<std::pair<int, double> >().swap(rows[j]);
+  }
+}
+
+void sparseLD(const std::string& fileName, int N, int P, const BedSelection& sel,
+              const int* startvec, const int* endvec, int nblocks,
+              const double* pos, double window, double r2, SparseLD& ld)
+{
+  const int n = selectedSamples(N, sel);
+  const int p = selectedVariants(P, sel);
+  const std::vector<int> column = selectedColumns(P, sel);
+
+  ld = SparseLD();
+  ld.n = n;
+  ld.r2 = r2;
+  ld.window = window;
+  ld.startvec.assign(startvec, startvec + nblocks);
+  ld.endvec.assign(endvec, endvec + nblocks);
+  ld.mean.assign(p, 0.0);
+  ld.sd.assign(p, 0.0);
+  ld.selection = selectionFingerprint(fileName, N, P, sel);
+
+  std::vector<int> skippos, skiplen;
+  std::vector<double> G;
+  for (int b = 0; b < nblocks; b++) {
+    const int s = startvec[b];
+    const int l = endvec[b] - s + 1;
+    if (b == 0 ? s != 0 : s != endvec[b - 1] + 1)
+      throw std::runtime_error("Blocks must cover the variants in order");
+    const BedSelection range = columnRange(P, sel, column, s, endvec[b],
+                                           skippos, skiplen);
+    G.resize((size_t) n * l);
+    genotypeMatrix(fileName, N, P, range, 1, &G[0]);
+    for (int j = 0; j < l; j++) {
+      const double* Gj = &G[(size_t) j * n];
+      double m = 0.0;
+      for (int i = 0; i < n; i++) m += Gj[i];
+      ld.mean[s + j] = m / n;
+    }
+    normalize(&G[0], n, l, &ld.sd[s]);
+    appendSparseLD(&G[0], n, l, s, window > 0.0 ? pos + s : 0, window, r2, ld);
+  }
+  if ((int) ld.rowptr.size() != p + 1)
+    throw std::runtime_error("Blocks must cover the variants in order");
+}
+
+void writeSparseLD(const std::string& ldFile, const SparseLD& ld)
+{
+  const std::string tmpName = ldFile + ".tmp";
+  std::ofstream out(tmpName.c_str(), std::ios::out | std::ios::binary);
+  if (!out) throw std::runtime_error("Cannot write " + tmpName);
+  SparseLDHeader h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, sparseLDMagic, 8);
+  h.version = sparseLDVersion;
+  h.n = ld.n;
+  h.p = ld.mean.size();
+  h.nblocks = ld.startvec.size();
+  h.r2 = ld.r2;
+  h.window = ld.window;
+  h.selection = ld.selection;
+  h.nnz = ld.col.size();
+  out.write((const char*) &h, sizeof(h));
+  out.write((const char*) &ld.startvec[0], sizeof(int) * h.nblocks);
+  out.write((const char*) &ld.endvec[0], sizeof(int) * h.nblocks);
+  out.write((const char*) &ld.offdiag[0], sizeof(double) * h.nblocks);
+  out.write((const char*) &ld.smallest[0], sizeof(double) * h.nblocks);
+  out.write((const char*) &ld.rowptr[0], sizeof(long long) * (h.p + 1));
+  out.write((const char*) &ld.col[0], sizeof(int) * h.nnz);
+  out.write((const char*) &ld.value[0], sizeof(double) * h.nnz);
+  out.write((const char*) &ld.mean[0], sizeof(double) * h.p);
+  out.write((const char*) &ld.sd[0], sizeof(double) * h.p);
+  out.close();
+  if (!out) throw std::runtime_error("Cannot write " + tmpName);
+  std::remove(ldFile.c_str());
+  if (std::rename(tmpName.c_str(), ldFile.c_str()) != 0)
+    throw std::runtime_error("Cannot write " + ldFile);
+}
+
+bool readSparseLD(const std::string& ldFile, const std::string& fileName,
+                  int N, int P, const BedSelection& sel,
+                  const int* startvec, const int* endvec, int nblocks,
+                  double window, double r2, SparseLD& ld)
+{
+  struct stat st;
+  if (stat(ldFile.c_str(), &st) != 0) return false;
+  std::ifstream in(ldFile.c_str(), std::ios::in | std::ios::binary);
+  SparseLDHeader h;
+  in.read((char*) &h, sizeof(h));
+  const int p = selectedVariants(P, sel);
+  bool ok = in && std::memcmp(h.magic, sparseLDMagic, 8) == 0 &&
+    h.version == sparseLDVersion && h.n == selectedSamples(N, sel) &&
+    h.p == p && h.nblocks == nblocks && h.r2 == r2 && h.window == window &&
+    h.selection == selectionFingerprint(fileName, N, P, sel) && h.nnz >= 0 &&
+    (unsigned long long) st.st_size == sizeof(h) +
+      (2 * sizeof(int) + 2 * sizeof(double)) * nblocks +
+      sizeof(long long) * (p + 1) + (sizeof(int) + sizeof(double)) * h.nnz +
+      2 * sizeof(double) * p;
+  if (ok) {
+    ld = SparseLD();
+    ld.n = h.n;
+    ld.r2 = h.r2;
+    ld.window = h.window;
+    ld.selection = h.selection;
+    ld.startvec.resize(nblocks);
+    ld.endvec.resize(nblocks);
+    ld.offdiag.resize(nblocks);
+    ld.smallest.resize(nblocks);
+    ld.rowptr.resize(p + 1);
+    ld.col.resize(h.nnz);
+    ld.value.resize(h.nnz);
+    ld.mean.resize(p);
+    ld.sd.resize(p);
+    in.read((char*) &ld.startvec[0], sizeof(int) * nblocks);
+    in.read((char*) &ld.endvec[0], sizeof(int) * nblocks);
+    in.read((char*) &ld.offdiag[0], sizeof(double) * nblocks);
+    in.read((char*) &ld.smallest[0], sizeof(double) * nblocks);
+    in.read((char*) &ld.rowptr[0], sizeof(long long) * (p + 1));
+    in.read((char*) &ld.col[0], sizeof(int) * h.nnz);
+    in.read((char*) &ld.value[0], sizeof(double) * h.nnz);
+    in.read((char*) &ld.mean[0], sizeof(double) * p);
+    in.read((char*) &ld.sd[0], sizeof(double) * p);
+    ok = in && ld.rowptr[0] == 0 && ld.rowptr[p] == h.nnz &&
+      std::equal(startvec, startvec + nblocks, ld.startvec.begin()) &&
+      std::equal(endvec, endvec + nblocks, ld.endvec.begin());
+  }
+  if (!ok) {
+    warnings() << "Ignoring " << ldFile << ", which does not match " << fileName
+               << " and the LD settings" << std::endl;
+  }
+  return ok;
+}
+
+int repelnetSparse(double lambda1, double lambda2, double lambda_ct,
+                   const double* diag, const SparseLD& ld, double scale,
+                   const double* r, int traits, const double* adj, double thr,
+                   double* x, int trace, int maxiter,
+                   const int* startvec, const int* endvec, int nblocks,
+                   std::vector<ElnetTelemetry>& tel)
+{
+  const int p = ld.rowptr.size() - 1;
+  int out=1;
+  std::vector<double> g;
+  for(int i=0;i < nblocks; i++) {
+    const int s=startvec[i];
+    const int len=endvec[i] - s + 1;
+
+    // g = scale * LD.block(s, e) * x.subvec(s, e)
+    g.assign(len, 0.0);
+    for(int j=0; j < len; j++) {
+      const double xj=x[s + j];
+      if(xj == 0.0) continue;
+      for(long long e=ld.rowptr[s + j]; e < ld.rowptr[s + j + 1]; e++)
+        g[ld.col[e] - s] += scale * ld.value[e] * xj;
+    }
+
+    ElnetTelemetry blocktel;
+    int out2=elnetSparse(lambda1, lambda2, lambda_ct, diag + s, ld, scale, s, len,
+                         r + s, traits, p, adj + s, thr, x + s, &g[0],
+                         maxiter, blocktel);
+    tel.push_back(blocktel);
+
+    if(trace > 0) messages() << "Block: " << i << "\n";
+    out=std::min(out, out2);
+  }
+  return out;
+}
+
+void elnetPathSparse(const double* lambda, int nlambda, double shrink,
+                     double lambda_ct, const SparseLD& ld,
+                     const double* r, int traits, const double* adj, double thr,
+                     double* x, int trace, int maxiter, ElnetPath& path)
+{
+  int i,j;
+  const int p = ld.sd.size();
+  std::vector<double> diag(p, 1.0 - shrink);
+  for(j=0; j < p; j++) {
+    if(ld.sd[j] == 0.0) diag[j] = 0.0;
+  }
+
+  path.beta.assign((size_t) p * nlambda, 0.0);
+  path.pred.clear();
+  path.loss.assign(nlambda, 0.0);
+  path.fbeta.assign(nlambda, 0.0);
+  path.conv.assign(nlambda, 0);
+  path.tel.clear();
+  path.tellambda.clear();
+
+  std::vector<ElnetTelemetry> tel;
+  for(i=0; i < nlambda; ++i) {
+    if(trace > 0) messages() << "lambda: " << lambda[i] << "\n" << std::endl;
+    tel.clear();
+    path.conv[i] = repelnetSparse(lambda[i], shrink, lambda_ct, &diag[0], ld,
+                                  1.0 - shrink, r, traits, adj, thr, x,
+                                  trace-1, maxiter, &ld.startvec[0],
+                                  &ld.endvec[0], ld.startvec.size(), tel);
+    for(j=0; j < (int) tel.size(); j++) {
+      path.tel.push_back(tel[j]);
+      path.tellambda.push_back(i);
+    }
+
+    double* beta = &path.beta[(size_t) i * p];
+    for(j=0; j < p; j++) {
+      beta[j] = x[j];
+      if(ld.sd[j] == 0.0) beta[j] *= shrink;
+    }
+
+    // x' LD x within the blocks
+    double yy=0.0, xr=0.0, l1=0.0, l2=0.0;
+    for(j=0; j < p; j++) {
+      if(x[j] == 0.0) continue;
+      double g=0.0;
+      for(long long e=ld.rowptr[j]; e < ld.rowptr[j + 1]; e++)
+        g += ld.value[e] * x[ld.col[e]];
+      yy += (1.0 - shrink) * x[j] * g;
+    }
+    for(j=0; j < p; j++) {
+      xr += x[j] * r[j];
+      l1 += std::abs(x[j]);
+      l2 += x[j] * x[j];
+    }
+    path.loss[i] = yy - 2.0 * xr;
+    path.fbeta[i] = path.loss[i] + 2.0 * l1 * lambda[i] + l2 * shrink;
+  }
+}
+
+void panelPredictions(const std::string& fileName, int N, int P,
+                      const BedSelection& sel, const double* lambda,
+                      int nlambda, double shrink, const double* r,
+                      const double* mean, const double* sd, int p,
+                      ElnetPath& path)
+{
+  const int n = selectedSamples(N, sel);
+  // X beta = G (beta / norm) - sum(mean * beta / norm), norm = sd sqrt(n - 1)
+  std::vector<double> w((size_t) p * nlambda, 0.0), shift(nlambda, 0.0);
+  const double scale = sqrt(1.0 - shrink);
+  for (int i = 0; i < nlambda; i++) {
+    for (int j = 0; j < p; j++) {
+      if (sd[j] == 0.0) continue;
+      const double wj = scale * path.beta[(size_t) i * p + j] /
+        (sd[j] * sqrt(n - 1.0));
+      w[(size_t) i * p + j] = wj;
+      shift[i] += wj * mean[j];
+    }
+  }
+  path.pred.assign((size_t) n * nlambda, 0.0);
+  multiBed3(fileName, N, P, &w[0], p, nlambda, sel, 0, &path.pred[0]);
+
+  std::vector<double> yhat(n, 0.0);
+  for (int i = 0; i < nlambda; i++) {
+    double* pred = &path.pred[(size_t) i * n];
+    double yy = 0.0;
+    for (int j = 0; j < n; j++) {
+      yhat[j] += pred[j] - shift[i];
+      pred[j] = yhat[j];
+      yy += yhat[j] * yhat[j];
+    }
+    double xr = 0.0, l1 = 0.0, l2 = 0.0;
+    for (int j = 0; j < p; j++) {
+      double xj = path.beta[(size_t) i * p + j];
+      if (sd[j] == 0.0) xj /= shrink;
+      xr += xj * r[j];
+      l1 += std::abs(xj);
+      l2 += xj * xj;
+    }
+    path.loss[i] = yy - 2.0 * xr;
+    path.fbeta[i] = path.loss[i] + 2.0 * l1 * lambda[i] + l2 * shrink;
+  }
+}
+
+namespace {
+
+/**
+ Headers of the weights and scores files (see writeWeights, writeScores)
+
+ */
+struct WeightsHeader {
+  char magic[8];
+  int version, rows;
+  long long columns, nonzeros;
+};
+const char weightsMagic[8] = {'s', 's', 'C', 'T', 'P', 'R', 'c', 's'};
+const int weightsVersion = 1;
+
+struct ScoresHeader {
+  char magic[8];
+  int version, rows;
+  long long columns;
+};
+const char scoresMagic[8] = {'s', 's', 'C', 'T', 'P', 'R', 's', 'c'};
+const int scoresVersion = 1;
+
+template <typename Header>
+Header readHeader(std::istream& in, const std::string& fileName,
+                  const char* magic, int version)
+{
+  Header h;
+  in.read((char*) &h, sizeof(h));
+  if (!in || std::memcmp(h.magic, magic, 8) != 0 || h.version != version ||
+      h.rows < 0 || h.columns < 0)
+    throw std::runtime_error(fileName + " is not a file of this version of ssCTPR");
+  return h;
+}
+
+/**
+ Cuts off what is left of the columns discarded by a shorter rewrite
+
+ */
+void truncateFile(const std::string& fileName, unsigned long long size)
+{
+#if !defined(_WIN32)
+  if (truncate(fileName.c_str(), size) != 0)
+    throw std::runtime_error("Cannot write " + fileName);
+#endif
+}
+
+}
+
+long long writeWeights(const std::string& fileName, const double* weights,
+                       int p, int ncol, long long column)
+{
+  const std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+  std::fstream f;
+  WeightsHeader h;
+  std::vector<long long> colptr(1, 0);
+  if (column > 0) {
+    f.open(fileName.c_str(), mode);
+    if (!f) throw std::runtime_error("Cannot open " + fileName);
+    h = readHeader<WeightsHeader>(f, fileName, weightsMagic, weightsVersion);
+    if (h.rows != p)
+      throw std::runtime_error(fileName + " has weights of another number of variants");
+    if (column > h.columns)
+      throw std::runtime_error(fileName + " has fewer columns than written");
+    // Rebuild the pointers from the columns kept, as the footer may be stale
+    for (long long j = 0; j < column; j++) {
+      int nnz = 0;
+      f.read((char*) &nnz, sizeof(int));
+      if (!f) throw std::runtime_error(fileName + " has fewer columns than written");
+      colptr.push_back(colptr.back() + nnz);
+      f.seekg((std::streamoff) (sizeof(int) + sizeof(double)) * nnz, std::ios::cur);
+    }
+  } else {
+    f.open(fileName.c_str(), mode | std::ios::trunc);
+    if (!f) throw std::runtime_error("Cannot write " + fileName);
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, weightsMagic, 8);
+    h.version = weightsVersion;
+    h.rows = p;
+  }
+
+  f.seekp(sizeof(h) + sizeof(int) * column +
+          (sizeof(int) + sizeof(double)) * colptr.back());
+  std::vector<int> row;
+  std::vector<double> value;
+  for (int k = 0; k < ncol; k++) {
+    const double* w = weights + (size_t) k * p;
+    row.clear();
+    value.clear();
+    for (int j = 0; j < p; j++) {
+      if (w[j] == 0.0) continue;
+      row.push_back(j);
+      value.push_back(w[j]);
+    }
+    const int nnz = row.size();
+    f.write((const char*) &nnz, sizeof(int));
+    if (nnz > 0) {
+      f.write((const char*) &row[0], sizeof(int) * nnz);
+      f.write((const char*) &value[0], sizeof(double) * nnz);
+    }
+    colptr.push_back(colptr.back() + nnz);
+  }
+  h.columns = colptr.size() - 1;
+  h.nonzeros = colptr.back();
+  f.write((const char*) &colptr[0], sizeof(long long) * colptr.size());
+  const unsigned long long size = f.tellp();
+  f.seekp(0);
+  f.write((const char*) &h, sizeof(h));
+  f.close();
+  if (!f) throw std::runtime_error("Cannot write " + fileName);
+  truncateFile(fileName, size);
+  return h.columns;
+}
+
+void readWeights(const std::string& fileName, const int* cols, int ncol,
+                 int& rows, long long& columns, std::vector<long long>& colptr,
+                 std::vector<int>& row, std::vector<double>& value)
+{
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  const WeightsHeader h =
+    readHeader<WeightsHeader>(in, fileName, weightsMagic, weightsVersion);
+  rows = h.rows;
+  columns = h.columns;
+  std::vector<long long> ptr(h.columns + 1);
+  in.seekg(sizeof(h) + sizeof(int) * h.columns +
+           (sizeof(int) + sizeof(double)) * h.nonzeros);
+  in.read((char*) &ptr[0], sizeof(long long) * ptr.size());
+  if (!in || ptr[0] != 0 || ptr[h.columns] != h.nonzeros)
+    throw std::runtime_error(fileName + " is truncated");
+
+  colptr.assign(1, 0);
+  row.clear();
+  value.clear();
+  for (int k = 0; k < ncol; k++) {
+    const int j = cols[k];
+    if (j < 0 || j >= h.columns)
+      throw std::runtime_error(fileName + " has no such column");
+    const long long nnz = ptr[j + 1] - ptr[j];
+    const size_t at = row.size();
+    row.resize(at + nnz);
+    value.resize(at + nnz);
+    in.seekg(sizeof(h) + sizeof(int) * (j + 1) +
+             (sizeof(int) + sizeof(double)) * ptr[j]);
+    if (nnz > 0) {
+      in.read((char*) &row[at], sizeof(int) * nnz);
+      in.read((char*) &value[at], sizeof(double) * nnz);
+    }
+    colptr.push_back(colptr.back() + nnz);
+  }
+  if (!in) throw std::runtime_error(fileName + " is truncated");
+}
+
+long long writeScores(const std::string& fileName, const double* scores,
+                      const int* samples, int n, int ncol, long long column)
+{
+  const std::ios::openmode mode = std::ios::in | std::ios::out | std::ios::binary;
+  std::fstream f;
+  ScoresHeader h;
+  if (column > 0) {
+    f.open(fileName.c_str(), mode);
+    if (!f) throw std::runtime_error("Cannot open " + fileName);
+    h = readHeader<ScoresHeader>(f, fileName, scoresMagic, scoresVersion);
+    std::vector<int> previous(n);
+    if (h.rows == n && n > 0) f.read((char*) &previous[0], sizeof(int) * n);
+    if (h.rows != n || !f || !std::equal(samples, samples + n, previous.begin()))
+      throw std::runtime_error(fileName + " has scores of other samples");
+    if (column > h.columns)
+      throw std::runtime_error(fileName + " has fewer columns than written");
+  } else {
+    f.open(fileName.c_str(), mode | std::ios::trunc);
+    if (!f) throw std::runtime_error("Cannot write " + fileName);
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, scoresMagic, 8);
+    h.version = scoresVersion;
+    h.rows = n;
+    f.seekp(sizeof(h));
+    f.write((const char*) samples, sizeof(int) * n);
+  }
+  f.seekp(sizeof(h) + sizeof(int) * n + sizeof(double) * n * column);
+  f.write((const char*) scores, sizeof(double) * n * ncol);
+  h.columns = column + ncol;
+  const unsigned long long size = f.tellp();
+  f.seekp(0);
+  f.write((const char*) &h, sizeof(h));
+  f.close();
+  if (!f) throw std::runtime_error("Cannot write " + fileName);
+  truncateFile(fileName, size);
+  return h.columns;
+}
+
+void readScores(const std::string& fileName, const int* cols, int ncol,
+                long long& columns, std::vector<int>& samples,
+                std::vector<double>& scores)
+{
+  std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  const ScoresHeader h =
+    readHeader<ScoresHeader>(in, fileName, scoresMagic, scoresVersion);
+  const size_t n = h.rows;
+  columns = h.columns;
+  samples.resize(n);
+  if (n > 0) in.read((char*) &samples[0], sizeof(int) * n);
+  scores.resize(n * ncol);
+  for (int k = 0; k < ncol; k++) {
+    const int j = cols[k];
+    if (j < 0 || j >= h.columns)
+      throw std::runtime_error(fileName + " has no such column");
+    // Runs of consecutive columns are read at once
+    int l = 1;
+    while (k + l < ncol && cols[k + l] == j + l && j + l < h.columns) l++;
+    in.seekg(sizeof(h) + sizeof(int) * n + sizeof(double) * n * j);
+    if (n > 0) in.read((char*) &scores[n * k], sizeof(double) * n * l);
+    k += l - 1;
+  }
+  if (!in) throw std::runtime_error(fileName + " is truncated");
+}
+
+}
@@ -0,0 +1,720 @@
+/**
+ ssCTPR
+ kernels.h
+ Purpose: R-free kernels (BED decode, standardization, elnet, scoring) shared
+ by the Rcpp layer in functions.cpp and the standalone tools
+
+ @author Yingxi Yang
+
+ Matrices are column-major raw arrays, as in armadillo (memptr).
+
+ */
+#ifndef SSCTPR_KERNELS_H
+#define SSCTPR_KERNELS_H
+
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <functional>
+#include <vector>
+
+namespace ssctpr {
+
+/**
+ Cancellation, safe to use from any thread. checkInterrupt() is called once
+ per variant and once per sweep; on most calls it is a relaxed atomic load
+ of the cancellation flag, and it throws Cancelled once the flag is set.
+ Only the polling thread (the one that installed the hook, else the one
+ that loaded the kernels) calls the hook, at most every pollInterval
+ seconds, and prints the progress of the kernels called with trace > 0.
+ The Rcpp layer installs Rcpp::checkUserInterrupt: an interrupt propagates
+ on the polling thread and cancels the other threads until the hook next
+ returns normally. requestCancel() and resetCancel() set and clear the
+ flag directly.
+
+ */
+typedef void (*InterruptHook)();
+void setInterruptHook(InterruptHook hook);
+void checkInterrupt();
+void requestCancel();
+void resetCancel();
+const double pollInterval = 0.25;
+
+struct Cancelled : public std::runtime_error {
+  Cancelled() : std::runtime_error("Cancelled") {}
+};
+
+/**
+ Progress of a kernel call over total units (e.g. variants), printed as
+ "N% done" by the polling thread while a Progress with report is open.
+ step() is a relaxed atomic add, so the threads of a call can share one.
+
+ */
+void progressStep(long long units);
+
+class Progress {
+public:
+  Progress(long long total, bool report);
+  ~Progress();
+  void step() { if (report_) progressStep(1); }
+private:
+  bool report_;
+  Progress(const Progress&);
+  Progress& operator=(const Progress&);
+};
+
+/**
+ Native threads of the kernels. The process has one budget (setThreads, 1
+ by default) and a persistent pool of budget - 1 workers, started on first
+ use and reused by later calls (setThreads(1) stops them). parallelFor(n,
+ ranges, fn) splits [0, n) into that many contiguous ranges (at most n;
+ callers pass threads()), calls fn(range, from, to) on the calling thread
+ and the workers, and returns when all ranges are done. The first exception
+ of a range cancels the others (checkInterrupt) and is rethrown. A
+ parallelFor from inside a range, or while another thread holds the pool,
+ runs its ranges on the calling thread (same ranges, so the same result).
+
+ */
+void setThreads(int threads);
+int threads();
+void parallelFor(int n, int ranges,
+                 const std::function<void(int, int, int)>& fn);
+
+/**
+ Threads of the BLAS (OpenBLAS, MKL or BLIS, whichever is loaded, found at
+ run time) and of OpenMP. blasThreads() is 0 if neither is found. The
+ kernels make no BLAS calls; this only keeps the BLAS of other code in the
+ process, e.g. of cluster workers, from oversubscribing the cores.
+
+ */
+int blasThreads();
+void setBlasThreads(int threads);
+
+/**
+ Streams for trace output and warnings. Output is discarded if not set, and
+ on threads other than the polling thread (R's output is not thread-safe).
+
+ */
+void setMessageStream(std::ostream* out);
+void setWarningStream(std::ostream* out);
+
+/**
+ Variants to skip and samples to keep when reading a BED file
+
+ @col_skip_pos which variants should we skip
+ @col_skip how many variants to skip at col_skip_pos
+ @nskip length of col_skip_pos and col_skip (0 = read all)
+ @keepbytes which bytes to keep
+ @keepoffset the bit offset within each of keepbytes
+ @nkeep length of keepbytes and keepoffset (0 = keep all)
+
+ */
+struct BedSelection {
+  const int* col_skip_pos;
+  const int* col_skip;
+  int nskip;
+  const int* keepbytes;
+  const int* keepoffset;
+  int nkeep;
+  BedSelection() : col_skip_pos(0), col_skip(0), nskip(0),
+    keepbytes(0), keepoffset(0), nkeep(0) {}
+};
+
+/**
+ Solver telemetry for a single call of elnet (one block, one lambda)
+
+ @sweeps number of passes over the coordinates
+ @updates number of coordinates whose value changed
+ @maxdelta largest absolute change in the last sweep
+ @active number of non-zero coefficients on exit
+ @time wall time in seconds
+ @stop why the solver stopped: 0 = maxiter, 1 = thr, 2 = 50-sweep plateau
+ @ridge 1 if elnetPath started the block from its ridge solution
+ @coarse 1 if elnetPath started the block from its solution on the coarse
+ panel (elnetPath with subsample), whose sweeps and time are coarsesweeps
+ and coarsetime
+ @coarsegap objective of the coarse solution minus the final objective
+
+ */
+struct ElnetTelemetry {
+  int sweeps;
+  long long updates;
+  double maxdelta;
+  int active;
+  double time;
+  int stop;
+  int ridge;
+  int coarse;
+  int coarsesweeps;
+  double coarsetime;
+  double coarsegap;
+  ElnetTelemetry() : sweeps(0), updates(0), maxdelta(0.0), active(0),
+    time(0.0), stop(0), ridge(0), coarse(0), coarsesweeps(0),
+    coarsetime(0.0), coarsegap(0.0) {}
+};
+
+/**
+ Opens a Plink binary files
+
+ @s file name
+ @BIT ifstream
+ @return is plink file in major mode
+
+ */
+bool openPlinkBinaryFile(const std::string s, std::ifstream &BIT);
+
+/**
+ Number of bytes per variant in a BED file of N samples
+
+ */
+unsigned long long bedBytes(int N);
+
+/**
+ Number of rows (samples) and columns (variants) read under a selection
+
+ */
+int selectedSamples(int N, const BedSelection& sel);
+int selectedVariants(int P, const BedSelection& sel);
+
+/**
+ Whether keep subsets are compacted with pext (BMI2, checked at run time)
+ rather than a lookup table; the results are the same. On by default where
+ pext is fast (not on AMD before Zen 3). setCompactPext(true) is ignored
+ on a CPU without BMI2.
+
+ */
+void setCompactPext(bool on);
+bool compactPext();
+
+/**
+ Reads the genotype matrix
+
+ @genotypes n x p output (selectedSamples x selectedVariants), overwritten
+ @fillmissing if 0, missing genotypes are NaN, otherwise 0
+ @return number of variants read
+
+ */
+int genotypeMatrix(const std::string& fileName, int N, int P,
+                   const BedSelection& sel, int fillmissing, double* genotypes);
+
+/**
+ Sample-major cache of a BED file, built once per cohort so that reading a
+ small keep subset does not read every sample of every variant. The
+ variants are split in tiles of tileVariants; each tile holds one row of
+ tileVariants / 4 bytes per sample, in the BED coding.
+
+ genotypeMatrix and multiBed3sp use the cache automatically when it is up
+ to date and reading the rows of the kept samples in the tiles of the
+ selected variants costs less than reading the variants.
+
+ @fileName the BED file; the cache is its stem with the extension .smc
+ @tileVariants variants per tile, a multiple of 4
+
+ */
+std::string sampleMajorCacheName(const std::string& fileName);
+void buildSampleMajorCache(const std::string& fileName, int N, int P,
+                           int tileVariants);
+
+/**
+ genotypeMatrix and multiBed3sp reading from the sample-major cache (which
+ must be up to date)
+
+ */
+int genotypeMatrixSampleMajor(const std::string& fileName, int N, int P,
+                              const BedSelection& sel, int fillmissing,
+                              double* genotypes);
+int multiBed3spSampleMajor(const std::string& fileName, int N, int P,
+                           const double* beta, const int* nonzeros, int nvariants,
+                           const int* colpos, int ncol,
+                           const BedSelection& sel, int trace, double* result);
+
+/**
+ Multiplies the genotype matrix by a dense matrix
+
+ @input nrow x ncol weights, one row per selected variant
+ @result n x ncol output, overwritten
+ @return number of variants read
+
+ */
+int multiBed3(const std::string& fileName, int N, int P,
+              const double* input, int nrow, int ncol,
+              const BedSelection& sel, int trace, double* result);
+
+/**
+ Multiplies the genotype matrix by a sparse matrix
+
+ @beta the non-zero weights, grouped by variant
+ @nonzeros number of non-zero weights of each selected variant
+ @colpos column of each weight in beta
+ @result n x ncol output, overwritten
+ @return number of variants read
+
+ */
+int multiBed3sp(const std::string& fileName, int N, int P,
+                const double* beta, const int* nonzeros, int nvariants,
+                const int* colpos, int ncol,
+                const BedSelection& sel, int trace, double* result);
+
+/**
+ multiBed3sp on a BED file already in memory (read or mmapped)
+
+ @bed the genotypes of the P variants, i.e. a v1.00 SNP-major BED file
+ without its 3 magic bytes
+ @return number of variants read
+
+ */
+int multiBed3spBuffer(const char* bed, int N, int P,
+                      const double* beta, const int* nonzeros, int nvariants,
+                      const int* colpos, int ncol,
+                      const BedSelection& sel, double* result);
+
+/**
+ Centers each column and scales it to unit length
+
+ @genotypes n x k matrix, normalized in place
+ @sd k output standard deviations
+
+ */
+void normalize(double* genotypes, int n, int k, double* sd);
+
+/**
+ Performs elnet on one block
+
+ @X n x p genotype matrix
+ @r p x traits correlations; r(j,t) = r[j + t*ldr]
+ @return conv
+
+ */
+int elnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel);
+
+/**
+ Accelerated proximal gradient (FISTA with adaptive restart) for the block
+ problem of elnet, with the same arguments. Its steps are the products
+ X'(X y), and its thresholding is that of elnet (including the cross trait
+ term ctp/denom) scaled by the step size, so it has the fixed points of
+ elnet. When the iterations stall, which the jumps of the cross trait
+ thresholding can cause, the solve is finished by elnet from the last
+ point. sweeps counts iterations (and the sweeps of elnet) and maxdelta is
+ the largest change of a unit step.
+
+ */
+int fista(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel);
+
+/**
+ Solver of a block: 0 = coordinate descent (elnet), 1 = FISTA (fista),
+ 2 = elnet, and fista from its point when it does not converge, 3 = elnet
+ or fista by the width of the block (see setFistaVariants)
+
+ */
+const int solverCD = 0;
+const int solverFISTA = 1;
+const int solverAuto = 2;
+const int solverTuned = 3;
+
+/**
+ Width of a block (variants) from which solverTuned solves it with fista,
+ and below which with elnet; 0 (the default) for elnet on every block. Set
+ from the tuning profile (ssCTPR.autotune). blockSolver is the solver of a
+ block of that width (solverTuned resolved).
+
+ */
+void setFistaVariants(int variants);
+int fistaVariants();
+int blockSolver(int solver, int variants);
+
+/**
+ Solves a block with elnet or fista as chosen by solver, with the
+ arguments of elnet; the telemetry of a solverAuto fallback adds up the
+ sweeps of both
+
+ */
+int solveBlock(int solver, double lambda1, double lambda2, double lambda_ct,
+               const double* diag, const double* X, int n, int p,
+               const double* r, int traits, int ldr, const double* adj,
+               double thr, double* x, double* yhat, int trace, int maxiter,
+               ElnetTelemetry& tel);
+
+/**
+ Performs elnet by blocks, appending the telemetry of each block to tel
+
+ @X n x p genotype matrix
+ @r p x traits correlations
+ @startvec start position for each block
+ @endvec end position for each block
+ @return conv
+
+ */
+int repelnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+             const double* X, int n, int p, const double* r, int traits,
+             const double* adj, double thr, double* x, double* yhat,
+             int trace, int maxiter,
+             const int* startvec, const int* endvec, int nblocks,
+             std::vector<ElnetTelemetry>& tel);
+
+/**
+ Carrier lists of the rare variants of an n x p matrix X (normalized, and
+ possibly multiplied by sqrt(1-s)). A column that differs from its most
+ common value (base) in at most the fraction maxfraction of the rows is
+ stored as base and the list of its other rows (carriers) with their
+ differences from base, so that coordinate descent visits it in
+ O(carriers) (repelnetSolver with carriers).
+
+ @column p: carrier list of each column, -1 for a dense column
+ @start carrier list c is row and delta[start[c], start[c+1])
+ @base, deltasum value of the column outside its list, sum of its deltas
+ @colsum p column sums of X (0 up to rounding for normalized columns)
+
+ */
+struct CarrierColumns {
+  std::vector<int> column;
+  std::vector<size_t> start;
+  std::vector<int> row;
+  std::vector<double> delta, base, deltasum, colsum;
+};
+
+void carrierColumns(const double* X, int n, int p, double maxfraction,
+                    CarrierColumns& cc);
+
+/**
+ repelnet with the solver of the blocks (solverCD, solverFISTA or
+ solverAuto); with carriers (the CarrierColumns of X), coordinate descent
+ visits the columns with a carrier list in O(carriers)
+
+ */
+int repelnetSolver(double lambda1, double lambda2, double lambda_ct,
+                   const double* diag, const double* X, int n, int p,
+                   const double* r, int traits, const double* adj, double thr,
+                   double* x, double* yhat, int trace, int maxiter, int solver,
+                   const CarrierColumns* carriers,
+                   const int* startvec, const int* endvec, int nblocks,
+                   std::vector<ElnetTelemetry>& tel);
+
+/**
+ Eigendecompositions of the LD matrices of the blocks, for closed form
+ ridge solutions. At lambda1 = 0 the block problem of elnet is the linear
+ system (X'X + diag(1 - diag)) x = r + ctp/denom, which is
+ ((1-s) Z'Z + s I) x = r + ctp/denom on the variants with sd > 0 (Z the
+ normalized genotypes), so one decomposition of Z'Z gives the solutions of
+ every s and lambda_ct in O(p_b^2).
+
+ @column the variants with sd > 0, block after block, from start[b]
+ @k number of eigenvalues of each block (fewer than its variants when the
+ panel has fewer samples)
+ @values the k_b largest eigenvalues of Z'Z, block after block
+ @vectors the eigenvectors of each block (m_b x k_b), from offset[b]
+
+ */
+struct RidgeBasis {
+  std::vector<int> start, k, column;
+  std::vector<size_t> offset;
+  std::vector<double> values, vectors;
+};
+
+/**
+ Computes the RidgeBasis of the blocks of the n x p normalized genotype
+ matrix X (not multiplied by sqrt(1-s)); sd from normalize
+
+ */
+void ridgeBasis(const double* X, const double* sd, int n, int p,
+                const int* startvec, const int* endvec, int nblocks,
+                RidgeBasis& basis);
+
+/**
+ The fixed point of elnet at lambda1 = 0 (lambda2 = s) of each block, in x
+ (p), from a RidgeBasis; the other arguments as in elnetPath
+
+ */
+void ridgeSolution(const RidgeBasis& basis, double shrink, double lambda_ct,
+                   const double* sd, int p, const double* r, int traits,
+                   const double* adj, const int* startvec, const int* endvec,
+                   int nblocks, double* x);
+
+/**
+ Results of elnetPath, one column per lambda
+
+ @beta p x nlambda coefficients
+ @pred n x nlambda, sqrt(1-s) X beta (accumulated over the path, as in runElnet)
+ @tel telemetry of each block and lambda; tellambda is the index of the lambda
+ @carriers number of columns solved on carrier lists (elnetPath)
+
+ */
+struct ElnetPath {
+  std::vector<double> beta, pred, loss, fbeta;
+  std::vector<int> conv;
+  std::vector<ElnetTelemetry> tel;
+  std::vector<int> tellambda;
+  int carriers;
+  ElnetPath() : carriers(0) {}
+};
+
+/**
+ Runs repelnet over a path of lambdas, warm starting from x
+
+ @lambda the lambdas, in the order they are run (decreasing)
+ @shrink shrinkage parameter s
+ @X n x p normalized genotype matrix multiplied by sqrt(1-s)
+ @sd p standard deviations from normalize; diag(j) = 0 if sd(j) == 0
+ @x p initial values, updated in place
+ @solver solverCD, solverFISTA or solverAuto
+ @ridge if not null, the RidgeBasis of X: at each lambda, a block starts
+ from its ridge solution when that has a lower objective than x
+ @subsample if in (0, n), rows of the coarse panel: at each lambda, each
+ block without a warm start (x = 0 on the block) is first solved on a
+ random subsample of the rows of X, rescaled to the column norms of X, and
+ starts from that solution when it has a lower objective than x (and the
+ ridge solution)
+ @seed seed of the subsample
+ @carriers if positive, the maximal fraction of carriers of the columns
+ stored as carrier lists (CarrierColumns) for coordinate descent
+ @path output
+
+ */
+void elnetPath(const double* lambda, int nlambda, double shrink, double lambda_ct,
+               const double* X, const double* sd, int n, int p,
+               const double* r, int traits, const double* adj, double thr,
+               double* x, int trace, int maxiter, int solver,
+               const RidgeBasis* ridge, int subsample, unsigned long long seed,
+               double carriers,
+               const int* startvec, const int* endvec, int nblocks,
+               ElnetPath& path);
+
+/**
+ Sketched reference panel: each LD block of the normalized genotype matrix
+ X (n x p_b) is replaced by S X, with S a random k_b x n projection (k_b well
+ below n), so that a coordinate visit of elnet costs O(k_b) instead of O(n).
+ The columns of S X are rescaled to unit length, so the diagonal of the
+ sketched LD matrix is exact.
+
+ @X the blocks of k_b x p_b, one after another, starting at offset[b]
+ @k rows of each block; k_b = n (no sketch) if the requested size is >= n
+ @mean, sd p means and standard deviations of the genotypes (as in normalize)
+ @lderror estimated relative Frobenius error of the LD matrix of each block,
+ ||X'S'SX - X'X|| / ||X'X||
+ @residual for a low-rank panel (lowRankGenotypes), p diagonal corrections:
+ the LD matrix of a block is X'X + diag(residual), otherwise empty
+ @variance for a low-rank panel, the fraction of the variance of each block
+ its rank explains
+
+ */
+struct SketchedPanel {
+  std::vector<double> X;
+  std::vector<size_t> offset;
+  std::vector<int> k;
+  std::vector<double> mean, sd, lderror, residual, variance;
+};
+
+/**
+ Decodes, normalizes and sketches the genotypes one LD block at a time, so
+ only one n x p_b block is held besides the sketches
+
+ @k requested sketch size of each block
+ @method 0 = subsampled randomized Hadamard transform (SRHT), 1 = sparse
+ Johnson-Lindenstrauss (4 non-zeros per sample)
+ @seed seed of the projections; block b uses its own stream
+
+ */
+void sketchGenotypes(const std::string& fileName, int N, int P,
+                     const BedSelection& sel,
+                     const int* startvec, const int* endvec, int nblocks,
+                     const int* k, int method, unsigned long long seed,
+                     SketchedPanel& panel);
+
+/**
+ Low-rank-plus-diagonal reference panel: decodes and normalizes the
+ genotypes one LD block at a time and replaces each block by a truncated
+ randomized SVD, X_b ~ U diag(d) V', stored as the k_b x p_b matrix
+ diag(d) V'. The LD matrix V diag(d^2) V' + D keeps the exact diagonal
+ (D = 1 - diag(V diag(d^2) V')), so a coordinate visit of elnet costs O(k_b).
+
+ @k rank of each block; 0 chooses the smallest rank explaining the fraction
+ variance of the variance of the block
+ @seed seed of the random projections; block b uses its own stream
+
+ */
+void lowRankGenotypes(const std::string& fileName, int N, int P,
+                      const BedSelection& sel,
+                      const int* startvec, const int* endvec, int nblocks,
+                      const int* k, double variance, unsigned long long seed,
+                      SketchedPanel& panel);
+
+/**
+ elnetPath on a sketched panel: each block is solved on its k_b x p_b sketch.
+ path.pred is left empty, and loss and fbeta use the sketched LD of the
+ blocks (without the correlations between blocks); panelPredictions
+ computes them as elnetPath does.
+
+ @panel sketched (or low-rank) panel with X multiplied by sqrt(1-s)
+
+ */
+void elnetPathSketched(const double* lambda, int nlambda, double shrink,
+                       double lambda_ct, const SketchedPanel& panel, int p,
+                       const double* r, int traits, const double* adj, double thr,
+                       double* x, int trace, int maxiter, int solver,
+                       const int* startvec, const int* endvec, int nblocks,
+                       ElnetPath& path);
+
+/**
+ Sparse LD matrix of the LD blocks: within a block, the correlations of the
+ pairs with r^2 >= r2 or at most window apart (in the units of pos), in CSR
+ format; the diagonal is always stored. Coordinate descent against it costs
+ the number of LD neighbours per update instead of n.
+
+ @n samples of the panel
+ @rowptr p + 1 offsets of the rows in col and value
+ @col columns of the stored correlations (ascending within a row)
+ @value correlations X'X of the normalized genotypes (0 on the diagonal of
+ monomorphic variants)
+ @mean, sd p means and standard deviations of the genotypes
+ @offdiag per block, the factor the off-diagonal correlations were shrunk by
+ to keep the thresholded block positive definite (1 if not needed)
+ @smallest per block, the estimated smallest eigenvalue after shrinking (NaN
+ for a block without dropped correlations, which needs no estimate)
+ @selection fingerprint of the BED file and the selection it was built from
+
+ */
+struct SparseLD {
+  int n;
+  double r2, window;
+  std::vector<int> startvec, endvec;
+  std::vector<long long> rowptr;
+  std::vector<int> col;
+  std::vector<double> value, mean, sd;
+  std::vector<double> offdiag, smallest;
+  unsigned long long selection;
+  SparseLD() : n(0), r2(0.0), window(0.0), selection(0) {}
+};
+
+/**
+ Appends the rows of the variants from, ..., from + p - 1 (one LD block) to
+ ld, from their n x p normalized genotypes X
+
+ @pos positions of the p variants, used if window > 0
+
+ */
+void appendSparseLD(const double* X, int n, int p, int from, const double* pos,
+                    double window, double r2, SparseLD& ld);
+
+/**
+ Builds the sparse LD matrix of the blocks of a BED file, decoding one block
+ at a time
+
+ @pos positions of the selected variants, used if window > 0
+
+ */
+void sparseLD(const std::string& fileName, int N, int P, const BedSelection& sel,
+              const int* startvec, const int* endvec, int nblocks,
+              const double* pos, double window, double r2, SparseLD& ld);
+
+/**
+ Writes a sparse LD matrix to ldFile, and reads it back if it was built
+ from the same BED file (unchanged since), selection, blocks, r2 and window
+
+ @return false if there is no such file (with a warning if the file does
+ not match)
+
+ */
+void writeSparseLD(const std::string& ldFile, const SparseLD& ld);
+bool readSparseLD(const std::string& ldFile, const std::string& fileName,
+                  int N, int P, const BedSelection& sel,
+                  const int* startvec, const int* endvec, int nblocks,
+                  double window, double r2, SparseLD& ld);
+
+/**
+ repelnet against a sparse LD matrix: the LD of the blocks is scale times
+ ld.value (1 - s in ssCTPR), and there is no yhat
+
+ */
+int repelnetSparse(double lambda1, double lambda2, double lambda_ct,
+                   const double* diag, const SparseLD& ld, double scale,
+                   const double* r, int traits, const double* adj, double thr,
+                   double* x, int trace, int maxiter,
+                   const int* startvec, const int* endvec, int nblocks,
+                   std::vector<ElnetTelemetry>& tel);
+
+/**
+ elnetPath against a sparse LD matrix, over the blocks of ld. As in
+ elnetPathSketched, path.pred is left empty and loss and fbeta use the LD
+ of the blocks only.
+
+ */
+void elnetPathSparse(const double* lambda, int nlambda, double shrink,
+                     double lambda_ct, const SparseLD& ld,
+                     const double* r, int traits, const double* adj, double thr,
+                     double* x, int trace, int maxiter, ElnetPath& path);
+
+/**
+ Fills path.pred (sqrt(1-s) X beta on the full panel, accumulated over the
+ path as in elnetPath) with a pass of multiBed3 over the BED file, and
+ recomputes loss and fbeta from it, for the paths solved without X
+ (elnetPathSketched, elnetPathSparse)
+
+ @mean, sd p means and standard deviations of the genotypes
+
+ */
+void panelPredictions(const std::string& fileName, int N, int P,
+                      const BedSelection& sel, const double* lambda,
+                      int nlambda, double shrink, const double* r,
+                      const double* mean, const double* sd, int p,
+                      ElnetPath& path);
+
+/**
+ Writes the columns of a p x ncol matrix of weights to a weights file, from
+ its column `column` on (0-based; the columns after them are discarded, and
+ 0 starts a new file). The file is compressed sparse column: a header (rows,
+ columns, nonzeros), then for each column the number, row indices (int) and
+ values (double) of its non-zero weights, and at the end the column pointers
+ (long long, columns + 1). The columns before `column` are not rewritten, so
+ a writer killed midway can start again from any column it had completed.
+
+ @return the number of columns in the file
+
+ */
+long long writeWeights(const std::string& fileName, const double* weights,
+                       int p, int ncol, long long column);
+
+/**
+ Reads the columns cols[0], ..., cols[ncol - 1] (0-based) of a weights file
+ as compressed sparse column arrays colptr (ncol + 1), row and value
+
+ @rows, columns the dimensions of the file
+
+ */
+void readWeights(const std::string& fileName, const int* cols, int ncol,
+                 int& rows, long long& columns, std::vector<long long>& colptr,
+                 std::vector<int>& row, std::vector<double>& value);
+
+/**
+ Writes the columns of an n x ncol matrix of scores to a scores file, from
+ its column `column` on, as writeWeights. The file is a header (rows,
+ columns), the sample index (the n rows of the .fam file the scores are
+ of, 0-based), and the columns in order, so that each call appends a
+ contiguous chunk and any range of columns is one read. The samples must
+ be those of the file when appending to it.
+
+ @return the number of columns in the file
+
+ */
+long long writeScores(const std::string& fileName, const double* scores,
+                      const int* samples, int n, int ncol, long long column);
+
+/**
+ Reads the sample index and the columns cols[0], ..., cols[ncol - 1] of a
+ scores file into samples (n) and scores (n x ncol)
+
+ @columns the number of columns in the file
+
+ */
+void readScores(const std::string& fileName, const int* cols, int ncol,
+                long long& columns, std::vector<int>& samples,
+                std::vector<double>& scores);
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ ssCTPR
+ perfcounters.cpp
+ Purpose: opt-in hardware performance counters (Linux perf_event_open) for 
+ the C++ kernels
+ 
+ @author Yingxi Yang
+ 
+ */
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <mutex>
+#include <RcppArmadillo.h>
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// [[Rcpp::depends(RcppArmadillo)]]
+using namespace Rcpp;
+
+namespace {
+
+const int NCOUNTERS = 4; // cycles, instructions, LLC misses, branch misses
+
+struct KernelCounters {
+  std::string kernel;
+  int fd[NCOUNTERS];      // -1 if the counter could not be opened
+  int id[NCOUNTERS];      // position of the counter in a group read
+  long long calls;
+  double count[NCOUNTERS];
+  double enabled;         // ns the group was enabled
+  double running;         // ns the group was counting (< enabled if multiplexed)
+};
+
+bool enabled = false;
+std::string unavailable; // reason why counters could not be opened
+std::vector<KernelCounters> kernels;
+std::mutex kernelsMutex; // guards kernels, which any thread may start or stop
+
+#ifdef __linux__
+int openCounter(unsigned int type, unsigned long long config, int group) {
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (group == -1) ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | 
+    PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+void closeAll() {
+  for (size_t k = 0; k < kernels.size(); k++) {
+    for (int c = 0; c < NCOUNTERS; c++) {
+#ifdef __linux__
+      if (kernels[k].fd[c] >= 0) close(kernels[k].fd[c]);
+#endif
+      kernels[k].fd[c] = -1;
+    }
+  }
+}
+
+/**
+ Opens the counter group of a kernel. The group leader (cycles) must open; 
+ the other counters are left out if the hardware or container denies them. 
+ 
+ */
+bool openGroup(KernelCounters& kc) {
+  for (int c = 0; c < NCOUNTERS; c++) {
+    kc.fd[c] = -1;
+    kc.id[c] = -1;
+  }
+#ifdef __linux__
+  const unsigned int type[NCOUNTERS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+  };
+  const unsigned long long config[NCOUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES, 
+    PERF_COUNT_HW_INSTRUCTIONS, 
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | 
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), 
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+  kc.fd[0] = openCounter(type[0], config[0], -1);
+  if (kc.fd[0] < 0) {
+    unavailable = "perf_event_open: ";
+    unavailable += std::strerror(errno);
+    return false;
+  }
+  int pos = 0;
+  kc.id[0] = pos++;
+  for (int c = 1; c < NCOUNTERS; c++) {
+    kc.fd[c] = openCounter(type[c], config[c], kc.fd[0]);
+    if (kc.fd[c] >= 0) kc.id[c] = pos++;
+  }
+  return true;
+#else
+  unavailable = "hardware counters are only supported on Linux";
+  return false;
+#endif
+}
+
+}
+
+bool perfEnabled() {
+  return enabled;
+}
+
+int perfStart(const char* kernel) {
+  std::lock_guard<std::mutex> lock(kernelsMutex);
+  int k;
+  for (k = 0; k < (int) kernels.size(); k++) {
+    if (kernels[k].kernel == kernel) break;
+  }
+  if (k == (int) kernels.size()) {
+    KernelCounters kc;
+    kc.kernel = kernel;
+    kc.calls = 0;
+    kc.enabled = 0.0;
+    kc.running = 0.0;
+    for (int c = 0; c < NCOUNTERS; c++) kc.count[c] = 0.0;
+    openGroup(kc);
+    kernels.push_back(kc);
+  }
+  kernels[k].calls++;
+  if (kernels[k].fd[0] < 0) return -1;
+#ifdef __linux__
+  ioctl(kernels[k].fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(kernels[k].fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  return k;
+}
+
+void perfStop(int group) {
+#ifdef __linux__
+  std::lock_guard<std::mutex> lock(kernelsMutex);
+  KernelCounters& kc = kernels[group];
+  ioctl(kc.fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  // Group read: nr, time_enabled, time_running, value[nr]
+  unsigned long long buf[3 + NCOUNTERS];
+  if (read(kc.fd[0], buf, sizeof(buf)) < (ssize_t) (3 * sizeof(unsigned long long)))
+    return;
+  kc.enabled += buf[1];
+  kc.running += buf[2];
+  // Scale up if the kernel had to multiplex the counters
+  double scale = (buf[2] > 0) ? (double) buf[1] / buf[2] : 1.0;
+  for (int c = 0; c < NCOUNTERS; c++) {
+    if (kc.id[c] >= 0 && (unsigned long long) kc.id[c] < buf[0]) 
+      kc.count[c] += buf[3 + kc.id[c]] * scale;
+  }
+#endif
+}
+
+//' Switch the hardware performance counter profiling mode on or off
+//' 
+//' @param enable Should the counters be switched on?
+//' @return whether hardware counters are available. If not (e.g. in a 
+//' container without access to perf_event_open), the kernels run unprofiled 
+//' and the reason is given in the attribute \code{"reason"}
+//' @details Counter groups (cycles, instructions, LLC misses, branch misses) 
+//' are opened per kernel on first use and closed when the mode is switched off. 
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+LogicalVector perfProfiling(bool enable) {
+  std::lock_guard<std::mutex> lock(kernelsMutex);
+  enabled = enable;
+  if (!enable) {
+    closeAll();
+    kernels.clear();
+  }
+  unavailable.clear();
+  bool available = false;
+  if (enable) {
+    KernelCounters probe;
+    available = openGroup(probe);
+    for (int c = 0; c < NCOUNTERS; c++) {
+#ifdef __linux__
+      if (probe.fd[c] >= 0) close(probe.fd[c]);
+#endif
+    }
+  }
+  LogicalVector out = LogicalVector::create(available);
+  if (enable && !available) out.attr("reason") = unavailable;
+  return out;
+}
+
+//' Summary of the hardware performance counters by kernel
+//' 
+//' @param reset Should the counts be reset after reading?
+//' @return a data.frame with the number of calls, cycles, instructions, 
+//' instructions per cycle, last level cache misses and branch misses of 
+//' each kernel (\code{decode}, \code{elnet}, \code{score}), and the 
+//' fraction of the time the counters were \code{multiplexed} (shared with 
+//' other events; the counts are scaled up for it). Counters that could not 
+//' be opened are \code{NA}. 
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+DataFrame perfSummary(bool reset) {
+  std::lock_guard<std::mutex> lock(kernelsMutex);
+  int n = kernels.size();
+  CharacterVector kernel(n);
+  NumericVector calls(n), cycles(n), instructions(n), ipc(n), 
+    llcmisses(n), branchmisses(n), multiplexed(n);
+  NumericVector* counts[NCOUNTERS] = {&cycles, &instructions, &llcmisses, &branchmisses};
+  for (int k = 0; k < n; k++) {
+    const KernelCounters& kc = kernels[k];
+    kernel[k] = kc.kernel;
+    calls[k] = kc.calls;
+    for (int c = 0; c < NCOUNTERS; c++) {
+      (*counts[c])[k] = (kc.id[c] >= 0) ? kc.count[c] : NA_REAL;
+    }
+    ipc[k] = (kc.id[0] >= 0 && kc.id[1] >= 0 && kc.count[0] > 0) ? 
+      kc.count[1] / kc.count[0] : NA_REAL;
+    multiplexed[k] = (kc.enabled > 0) ? 1.0 - kc.running / kc.enabled : NA_REAL;
+  }
+  if (reset) {
+    for (int k = 0; k < n; k++) {
+      kernels[k].calls = 0;
+      kernels[k].enabled = 0.0;
+      kernels[k].running = 0.0;
+      for (int c = 0; c < NCOUNTERS; c++) kernels[k].count[c] = 0.0;
+    }
+  }
+  return DataFrame::create(Named("kernel") = kernel, 
+                           Named("calls") = calls, 
+                           Named("cycles") = cycles, 
+                           Named("instructions") = instructions, 
+                           Named("ipc") = ipc, 
+                           Named("llc.misses") = llcmisses, 
+                           Named("branch.misses") = branchmisses, 
+                           Named("multiplexed") = multiplexed, 
+                           Named("stringsAsFactors") = false);
+}
@@ -0,0 +1,52 @@
+/**
+ ssCTPR
+ perfcounters.h
+ Purpose: opt-in hardware performance counters (Linux perf_event_open) for 
+ the C++ kernels
+ 
+ @author Yingxi Yang
+ 
+ */
+#ifndef SSCTPR_PERFCOUNTERS_H
+#define SSCTPR_PERFCOUNTERS_H
+
+/**
+ Is the hardware counter profiling mode switched on?
+ 
+ */
+bool perfEnabled();
+
+/**
+ Starts the counter group of a kernel. Returns the group handle, or -1 if 
+ counters are unavailable
+ 
+ */
+int perfStart(const char* kernel);
+
+/**
+ Stops the counter group of a kernel and adds the counts to its summary
+ 
+ */
+void perfStop(int group);
+
+/**
+ Counts cycles, instructions, LLC misses and branch misses over the enclosing 
+ scope when the profiling mode is switched on (see perfProfiling). 
+ Otherwise, this costs a single check of a flag. 
+ 
+ */
+class ScopedPerf {
+public:
+  explicit ScopedPerf(const char* kernel) : group_(-1) {
+    if (perfEnabled()) group_ = perfStart(kernel);
+  }
+  ~ScopedPerf() {
+    if (group_ >= 0) perfStop(group_);
+  }
+private:
+  ScopedPerf(const ScopedPerf&);
+  ScopedPerf& operator=(const ScopedPerf&);
+  int group_;
+};
+
+#endif
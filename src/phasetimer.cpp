@@ -0,0 +1,79 @@
+/**
+ ssCTPR
+ phasetimer.cpp
+ Purpose: registry of the phase timers used by the C++ kernels
+ 
+ @author Yingxi Yang
+ 
+ */
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <RcppArmadillo.h>
+#include "phasetimer.h"
+
+// [[Rcpp::depends(RcppArmadillo)]]
+using namespace Rcpp;
+
+namespace {
+
+struct PhaseRecord {
+  long long calls;
+  double seconds;
+  double bytes;
+  double variants;
+  PhaseRecord() : calls(0), seconds(0.0), bytes(0.0), variants(0.0) {}
+};
+
+std::mutex registryMutex;
+std::vector<std::string> registryOrder; // phases in order of first use
+std::map<std::string, PhaseRecord> registry;
+
+}
+
+void recordPhase(const std::string& phase, double seconds, double bytes, double variants) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  std::map<std::string, PhaseRecord>::iterator it = registry.find(phase);
+  if (it == registry.end()) {
+    registryOrder.push_back(phase);
+    it = registry.insert(std::make_pair(phase, PhaseRecord())).first;
+  }
+  it->second.calls++;
+  it->second.seconds += seconds;
+  it->second.bytes += bytes;
+  it->second.variants += variants;
+}
+
+//' Phase timers of the C++ kernels
+//' 
+//' @param reset Should the timers be reset after reading?
+//' @return a data.frame with the number of calls, wall time (seconds), 
+//' bytes and variants processed by each phase since the last reset
+//' @keywords internal
+//' 
+// [[Rcpp::export]]
+DataFrame phaseTimers(bool reset) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  int n = registryOrder.size();
+  CharacterVector phase(n);
+  NumericVector calls(n), seconds(n), bytes(n), variants(n);
+  for (int i = 0; i < n; i++) {
+    const PhaseRecord& rec = registry[registryOrder[i]];
+    phase[i] = registryOrder[i];
+    calls[i] = rec.calls;
+    seconds[i] = rec.seconds;
+    bytes[i] = rec.bytes;
+    variants[i] = rec.variants;
+  }
+  if (reset) {
+    registry.clear();
+    registryOrder.clear();
+  }
+  return DataFrame::create(Named("phase") = phase, 
+                           Named("calls") = calls, 
+                           Named("seconds") = seconds, 
+                           Named("bytes") = bytes, 
+                           Named("variants") = variants, 
+                           Named("stringsAsFactors") = false);
+}
@@ -0,0 +1,54 @@
+/**
+ ssCTPR
+ phasetimer.h
+ Purpose: lightweight scoped timers and throughput counters for the C++ kernels
+ 
+ @author Yingxi Yang
+ 
+ */
+#ifndef SSCTPR_PHASETIMER_H
+#define SSCTPR_PHASETIMER_H
+
+#include <string>
+#include <chrono>
+
+/**
+ Adds one call of a phase to the process-wide registry
+ 
+ @phase name of the phase
+ @seconds wall time spent
+ @bytes bytes processed (e.g. read from the .bed file)
+ @variants variants processed
+ 
+ */
+void recordPhase(const std::string& phase, double seconds, double bytes, double variants);
+
+/**
+ Times the enclosing scope and records it under a phase name on destruction. 
+ Bytes and variants processed can be added while the scope is open. 
+ 
+ */
+class ScopedPhase {
+public:
+  explicit ScopedPhase(const char* phase) : 
+    phase_(phase), bytes_(0.0), variants_(0.0), 
+    start_(std::chrono::steady_clock::now()) {}
+  ~ScopedPhase() {
+    double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start_).count();
+    recordPhase(phase_, seconds, bytes_, variants_);
+  }
+  void add(double bytes, double variants) {
+    bytes_ += bytes;
+    variants_ += variants;
+  }
+private:
+  ScopedPhase(const ScopedPhase&);
+  ScopedPhase& operator=(const ScopedPhase&);
+  std::string phase_;
+  double bytes_;
+  double variants_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif
@@ -0,0 +1,651 @@
+/**
+ ssCTPR
+ bench.cpp
+ Purpose: microbenchmarks of the decode, normalize, solve and score kernels,
+ built from the package sources (src/kernels.cpp) without R
+
+ @author Yingxi Yang
+
+ Usage: ssctpr_bench [--n 2000] [--p 5000] [--block 500] [--sparsity 0.1]
+                     [--keep 1] [--shuffle 0] [--threads 1] [--reps 3]
+                     [--format csv|json]
+                     [--out FILE] [--baseline FILE] [--tolerance 0.1] ...
+ n, p, block, sparsity, keep and threads take comma separated lists, and
+ every combination is benchmarked. With --baseline (a csv from an earlier
+ run), each result is compared to the baseline and the exit status is 1 if
+ any kernel is slower than the baseline by more than the tolerance.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <stdexcept>
+#include <unistd.h>
+#include "kernels.h"
+
+namespace {
+
+struct Options {
+  std::vector<int> n, p, block, threads;
+  std::vector<double> sparsity, keep;
+  std::vector<std::string> kernels;
+  int reps, traits, ncol, maxiter, shuffle;
+  double shrink, lambda, lambdact, thr, tolerance;
+  unsigned long seed;
+  std::string format, out, baseline, dir;
+  Options() : reps(3), traits(1), ncol(1), maxiter(1000), shuffle(0), shrink(0.9),
+    lambda(0.001), lambdact(0.0), thr(1e-4), tolerance(0.1), seed(1),
+    format("csv") {
+    n.push_back(2000);
+    p.push_back(5000);
+    block.push_back(500);
+    threads.push_back(1);
+    sparsity.push_back(0.1);
+    keep.push_back(1.0);
+    const char* all[] = {"decode", "normalize", "elnet", "score", "scoresp"};
+    kernels.assign(all, all + 5);
+    const char* tmp = std::getenv("TMPDIR");
+    dir = tmp ? tmp : "/tmp";
+  }
+};
+
+struct Result {
+  std::string kernel;
+  int n, p, block, threads;
+  double sparsity, keep;
+  double seconds;      // median over reps
+  double minseconds;
+  double sweeps;       // elnet sweeps per rep
+  double baseline;     // baseline seconds, NAN if none
+  std::string status;
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_bench [options]\n"
+    "  --n LIST          number of samples (2000)\n"
+    "  --p LIST          number of variants (5000)\n"
+    "  --block LIST      LD block size for elnet (500)\n"
+    "  --sparsity LIST   fraction of non-zero score weights (0.1)\n"
+    "  --keep LIST       fraction of samples kept (1)\n"
+    "  --shuffle 0|1     keep the samples out of file order (0)\n"
+    "  --threads LIST    threads; variants/blocks are split between them (1)\n"
+    "  --kernels LIST    decode,normalize,elnet,score,scoresp\n"
+    "  --reps R          repetitions, the median is reported (3)\n"
+    "  --traits T        1 or 2 (cross-trait penalty) (1)\n"
+    "  --ncol K          number of score columns (1)\n"
+    "  --shrink S        shrinkage parameter s (0.9)\n"
+    "  --lambda L        lambda (0.001)\n"
+    "  --lambdact L      cross trait penalty (0)\n"
+    "  --thr T           convergence threshold (1e-4)\n"
+    "  --maxiter M       maximal number of iterations (1000)\n"
+    "  --seed S          random seed (1)\n"
+    "  --dir DIR         directory for the temporary bed file ($TMPDIR)\n"
+    "  --format F        csv or json (csv)\n"
+    "  --out FILE        output file (stdout)\n"
+    "  --baseline FILE   csv of an earlier run to compare against\n"
+    "  --tolerance X     allowed slowdown relative to baseline (0.1)\n";
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) out.push_back(item);
+  return out;
+}
+
+template <class T>
+std::vector<T> parseList(const std::string& s) {
+  std::vector<T> out;
+  std::vector<std::string> items = splitList(s);
+  for (size_t i = 0; i < items.size(); i++) {
+    std::stringstream ss(items[i]);
+    T v;
+    if (!(ss >> v)) throw std::runtime_error("Cannot parse '" + items[i] + "'");
+    out.push_back(v);
+  }
+  return out;
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    std::string v = argv[++i];
+    if (a == "--n") opt.n = parseList<int>(v);
+    else if (a == "--p") opt.p = parseList<int>(v);
+    else if (a == "--block") opt.block = parseList<int>(v);
+    else if (a == "--threads") opt.threads = parseList<int>(v);
+    else if (a == "--sparsity") opt.sparsity = parseList<double>(v);
+    else if (a == "--keep") opt.keep = parseList<double>(v);
+    else if (a == "--kernels") opt.kernels = splitList(v);
+    else if (a == "--shuffle") opt.shuffle = std::atoi(v.c_str());
+    else if (a == "--reps") opt.reps = std::atoi(v.c_str());
+    else if (a == "--traits") opt.traits = std::atoi(v.c_str());
+    else if (a == "--ncol") opt.ncol = std::atoi(v.c_str());
+    else if (a == "--maxiter") opt.maxiter = std::atoi(v.c_str());
+    else if (a == "--shrink") opt.shrink = std::atof(v.c_str());
+    else if (a == "--lambda") opt.lambda = std::atof(v.c_str());
+    else if (a == "--lambdact") opt.lambdact = std::atof(v.c_str());
+    else if (a == "--thr") opt.thr = std::atof(v.c_str());
+    else if (a == "--tolerance") opt.tolerance = std::atof(v.c_str());
+    else if (a == "--seed") opt.seed = std::strtoul(v.c_str(), 0, 10);
+    else if (a == "--dir") opt.dir = v;
+    else if (a == "--format") opt.format = v;
+    else if (a == "--out") opt.out = v;
+    else if (a == "--baseline") opt.baseline = v;
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  if (opt.reps < 1) throw std::runtime_error("--reps must be positive");
+  if (opt.traits != 1 && opt.traits != 2)
+    throw std::runtime_error("--traits must be 1 or 2");
+  if (opt.format != "csv" && opt.format != "json")
+    throw std::runtime_error("--format must be csv or json");
+  return opt;
+}
+
+/**
+ Writes a SNP-major bed file of N samples and P variants, with MAF drawn
+ uniformly from [0.01, 0.5] and 1% missing genotypes
+
+ */
+void writeBed(const std::string& fileName, int N, int P, unsigned long seed) {
+  std::ofstream bed(fileName.c_str(), std::ios::out | std::ios::binary);
+  if (!bed) throw std::runtime_error("Cannot write " + fileName);
+  const char magic[3] = {0x6c, 0x1b, 0x01};
+  bed.write(magic, 3);
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  const unsigned long long Nbytes = ssctpr::bedBytes(N);
+  std::vector<char> ch(Nbytes);
+  // PLINK codes: 00 hom A1, 01 missing, 10 het, 11 hom A2
+  const unsigned char codes[4] = {0x3, 0x2, 0x0, 0x1}; // by dosage, then missing
+  for (int j = 0; j < P; j++) {
+    double maf = 0.01 + 0.49 * unif(rng);
+    std::fill(ch.begin(), ch.end(), 0);
+    for (int i = 0; i < N; i++) {
+      int code;
+      if (unif(rng) < 0.01) {
+        code = 3;
+      } else {
+        code = (unif(rng) < maf) + (unif(rng) < maf);
+      }
+      ch[i / 4] |= codes[code] << ((i % 4) * 2);
+    }
+    bed.write(&ch[0], Nbytes);
+  }
+}
+
+/**
+ A bed file in the temporary directory, removed on destruction
+
+ */
+class TempBed {
+public:
+  TempBed(const std::string& dir, int N, int P, unsigned long seed) {
+    std::ostringstream s;
+    s << dir << "/ssctpr_bench_" << getpid() << "_" << N << "x" << P << ".bed";
+    fileName = s.str();
+    writeBed(fileName, N, P, seed);
+  }
+  ~TempBed() {
+    std::remove(fileName.c_str());
+  }
+  std::string fileName;
+};
+
+/**
+ The selection reading variants [from, to) only, as the R clusters do
+
+ */
+struct VariantRange {
+  std::vector<int> col_skip_pos, col_skip;
+  VariantRange(int from, int to, int P) {
+    if (from > 0) {
+      col_skip_pos.push_back(0);
+      col_skip.push_back(from);
+    }
+    if (to < P) {
+      col_skip_pos.push_back(to);
+      col_skip.push_back(P - to);
+    }
+  }
+  ssctpr::BedSelection selection(const ssctpr::BedSelection& keep) const {
+    ssctpr::BedSelection sel = keep;
+    sel.nskip = col_skip_pos.size();
+    sel.col_skip_pos = sel.nskip ? &col_skip_pos[0] : 0;
+    sel.col_skip = sel.nskip ? &col_skip[0] : 0;
+    return sel;
+  }
+};
+
+/**
+ Runs f(t, from, to) on `threads` threads over contiguous ranges of [0, total)
+
+ */
+template <class F>
+void parallelRanges(int threads, int total, F f) {
+  threads = std::max(1, std::min(threads, total));
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    int from = (long long) total * t / threads;
+    int to = (long long) total * (t + 1) / threads;
+    pool.push_back(std::thread(f, t, from, to));
+  }
+  for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+double median(std::vector<double> x) {
+  std::sort(x.begin(), x.end());
+  size_t m = x.size() / 2;
+  return (x.size() % 2) ? x[m] : 0.5 * (x[m - 1] + x[m]);
+}
+
+double now() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ The data shared by the kernels for one (n, p, keep) setting
+
+ */
+struct Dataset {
+  int N, P, n;
+  std::vector<int> keepbytes, keepoffset;
+  ssctpr::BedSelection keep;
+  std::vector<double> genotypes;   // n x P, decoded
+  std::vector<double> X;           // n x P, normalized * sqrt(1-s)
+  std::vector<double> sd, diag, r, adj;
+};
+
+void prepare(Dataset& d, const std::string& bed, int N, int P, double keepfrac,
+             const Options& opt) {
+  d.N = N;
+  d.P = P;
+  d.keepbytes.clear();
+  d.keepoffset.clear();
+  std::mt19937_64 rng(opt.seed + 1);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  if (keepfrac < 1.0) {
+    for (int i = 0; i < N; i++) {
+      if (unif(rng) < keepfrac) {
+        d.keepbytes.push_back(i / 4);
+        d.keepoffset.push_back(i % 4 * 2);
+      }
+    }
+    if (d.keepbytes.empty()) {
+      d.keepbytes.push_back(0);
+      d.keepoffset.push_back(0);
+    }
+    if (opt.shuffle) {
+      // a generator of its own, so that the data are those of --shuffle 0
+      std::mt19937_64 order(opt.seed + 2);
+      std::vector<int> perm(d.keepbytes.size());
+      for (size_t j = 0; j < perm.size(); j++) perm[j] = j;
+      std::shuffle(perm.begin(), perm.end(), order);
+      std::vector<int> bytes(perm.size()), offsets(perm.size());
+      for (size_t j = 0; j < perm.size(); j++) {
+        bytes[j] = d.keepbytes[perm[j]];
+        offsets[j] = d.keepoffset[perm[j]];
+      }
+      d.keepbytes.swap(bytes);
+      d.keepoffset.swap(offsets);
+    }
+  }
+  d.keep = ssctpr::BedSelection();
+  d.keep.nkeep = d.keepbytes.size();
+  d.keep.keepbytes = d.keep.nkeep ? &d.keepbytes[0] : 0;
+  d.keep.keepoffset = d.keep.nkeep ? &d.keepoffset[0] : 0;
+  d.n = ssctpr::selectedSamples(N, d.keep);
+
+  d.genotypes.resize((size_t) d.n * P);
+  ssctpr::genotypeMatrix(bed, N, P, d.keep, 1, &d.genotypes[0]);
+  d.X = d.genotypes;
+  d.sd.resize(P);
+  ssctpr::normalize(&d.X[0], d.n, P, &d.sd[0]);
+  const double scale = sqrt(1.0 - opt.shrink);
+  for (size_t i = 0; i < d.X.size(); i++) d.X[i] *= scale;
+
+  d.diag.assign(P, 1.0 - opt.shrink);
+  for (int j = 0; j < P; j++) if (d.sd[j] == 0.0) d.diag[j] = 0.0;
+
+  // correlations with a phenotype of 1% causal variants
+  std::normal_distribution<double> norm(0.0, 1.0);
+  std::vector<double> y(d.n);
+  for (int i = 0; i < d.n; i++) y[i] = norm(rng);
+  for (int j = 0; j < P; j++) {
+    if (unif(rng) < 0.01) {
+      double b = 0.2 * norm(rng);
+      for (int i = 0; i < d.n; i++) y[i] += b * d.X[(size_t) j * d.n + i];
+    }
+  }
+  double yy = 0.0;
+  for (int i = 0; i < d.n; i++) yy += y[i] * y[i];
+  yy = sqrt(yy);
+  d.r.assign((size_t) P * opt.traits, 0.0);
+  for (int j = 0; j < P; j++) {
+    double dot = 0.0;
+    for (int i = 0; i < d.n; i++) dot += d.X[(size_t) j * d.n + i] * y[i];
+    d.r[j] = dot / yy / scale;
+    if (opt.traits > 1) d.r[j + P] = d.r[j] + 0.01 * norm(rng);
+  }
+  d.adj.resize(P);
+  for (int j = 0; j < P; j++) d.adj[j] = unif(rng);
+}
+
+/**
+ Sparse weights with a fraction `sparsity` of non-zeros, in the dense
+ (P x ncol) and the multiBed3sp layout
+
+ */
+struct Weights {
+  std::vector<double> dense, beta;
+  std::vector<int> nonzeros, colpos;
+};
+
+void makeWeights(Weights& w, int P, int ncol, double sparsity, unsigned long seed) {
+  std::mt19937_64 rng(seed + 2);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  std::normal_distribution<double> norm(0.0, 1.0);
+  w.dense.assign((size_t) P * ncol, 0.0);
+  w.beta.clear();
+  w.colpos.clear();
+  w.nonzeros.assign(P, 0);
+  for (int j = 0; j < P; j++) {
+    for (int k = 0; k < ncol; k++) {
+      if (unif(rng) < sparsity) {
+        double b = norm(rng);
+        w.dense[j + (size_t) k * P] = b;
+        w.beta.push_back(b);
+        w.colpos.push_back(k);
+        w.nonzeros[j]++;
+      }
+    }
+  }
+}
+
+/**
+ Times one kernel at one setting; returns the median seconds over reps
+
+ */
+Result runKernel(const std::string& kernel, const std::string& bed, Dataset& d,
+                 const Weights& w, int block, int threads, const Options& opt) {
+  Result res;
+  res.kernel = kernel;
+  res.n = d.n;
+  res.p = d.P;
+  res.block = block;
+  res.threads = threads;
+  res.sweeps = 0.0;
+  res.baseline = NAN;
+
+  const int P = d.P, n = d.n;
+  std::vector<double> times;
+  std::vector<double> work;
+  std::vector<std::vector<double> > partial(threads);
+
+  // blocks of the elnet kernel
+  std::vector<int> startvec, endvec;
+  for (int s = 0; s < P; s += block) {
+    startvec.push_back(s);
+    endvec.push_back(std::min(P, s + block) - 1);
+  }
+
+  for (int rep = 0; rep < opt.reps; rep++) {
+    if (kernel == "normalize") work = d.genotypes;
+    std::vector<double> x, yhat;
+    std::vector<std::vector<ssctpr::ElnetTelemetry> > tel(threads);
+    if (kernel == "elnet") {
+      x.assign(P, 0.0);
+    }
+
+    double start = now();
+    if (kernel == "decode") {
+      parallelRanges(threads, P, [&](int t, int from, int to) {
+        VariantRange range(from, to, P);
+        partial[t].resize((size_t) n * (to - from));
+        ssctpr::genotypeMatrix(bed, d.N, P, range.selection(d.keep), 1,
+                               partial[t].data());
+      });
+    } else if (kernel == "normalize") {
+      parallelRanges(threads, P, [&](int t, int from, int to) {
+        ssctpr::normalize(&work[(size_t) from * n], n, to - from, &d.sd[from]);
+      });
+    } else if (kernel == "elnet") {
+      int nblocks = startvec.size();
+      parallelRanges(threads, nblocks, [&](int t, int from, int to) {
+        partial[t].assign(n, 0.0);
+        ssctpr::repelnet(opt.lambda, opt.shrink, opt.lambdact, &d.diag[0],
+                         &d.X[0], n, P, &d.r[0], opt.traits, &d.adj[0],
+                         opt.thr, &x[0], partial[t].data(), 0, opt.maxiter,
+                         &startvec[from], &endvec[from], to - from, tel[t]);
+      });
+    } else if (kernel == "score" || kernel == "scoresp") {
+      const bool sparse = (kernel == "scoresp");
+      parallelRanges(threads, P, [&](int t, int from, int to) {
+        VariantRange range(from, to, P);
+        partial[t].resize((size_t) n * opt.ncol);
+        if (sparse) {
+          int k = 0;
+          for (int j = 0; j < from; j++) k += w.nonzeros[j];
+          ssctpr::multiBed3sp(bed, d.N, P, w.beta.data() + k,
+                              &w.nonzeros[from], to - from,
+                              w.colpos.data() + k, opt.ncol,
+                              range.selection(d.keep), 0, partial[t].data());
+        } else {
+          // weights of the variants in the range, (to - from) x ncol
+          std::vector<double> input((size_t) (to - from) * opt.ncol);
+          for (int k = 0; k < opt.ncol; k++)
+            std::copy(&w.dense[(size_t) k * P + from], &w.dense[(size_t) k * P + to],
+                      &input[(size_t) k * (to - from)]);
+          ssctpr::multiBed3(bed, d.N, P, input.data(), to - from, opt.ncol,
+                            range.selection(d.keep), 0, partial[t].data());
+        }
+      });
+      // reduce the per-thread scores
+      std::vector<double> scores((size_t) n * opt.ncol, 0.0);
+      for (int t = 0; t < threads; t++) {
+        for (size_t i = 0; i < partial[t].size(); i++) scores[i] += partial[t][i];
+      }
+    } else {
+      throw std::runtime_error("Unknown kernel " + kernel);
+    }
+    times.push_back(now() - start);
+
+    double sweeps = 0.0;
+    for (int t = 0; t < threads; t++) {
+      for (size_t b = 0; b < tel[t].size(); b++) sweeps += tel[t][b].sweeps;
+    }
+    res.sweeps = sweeps;
+  }
+  res.seconds = median(times);
+  res.minseconds = *std::min_element(times.begin(), times.end());
+  return res;
+}
+
+std::string resultKey(const std::string& kernel, int n, int p, int block,
+                      int threads, double sparsity, double keep) {
+  std::ostringstream s;
+  s << kernel << "|" << n << "|" << p << "|" << block << "|" << threads << "|"
+    << sparsity << "|" << keep;
+  return s.str();
+}
+
+/**
+ Reads the median seconds of each setting from a csv written by this program
+
+ */
+std::map<std::string, double> readBaseline(const std::string& fileName) {
+  std::map<std::string, double> out;
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open baseline " + fileName);
+  std::string line;
+  std::getline(in, line);
+  std::vector<std::string> header = splitList(line);
+  std::map<std::string, int> col;
+  for (size_t i = 0; i < header.size(); i++) col[header[i]] = i;
+  const char* needed[] = {"kernel", "n", "p", "block", "threads", "sparsity",
+                          "keep", "seconds"};
+  for (int i = 0; i < 8; i++) {
+    if (!col.count(needed[i]))
+      throw std::runtime_error(std::string("Baseline has no column ") + needed[i]);
+  }
+  while (std::getline(in, line)) {
+    std::vector<std::string> f = splitList(line);
+    if (f.size() < header.size()) continue;
+    std::string key = resultKey(f[col["kernel"]], std::atoi(f[col["n"]].c_str()),
+                                std::atoi(f[col["p"]].c_str()),
+                                std::atoi(f[col["block"]].c_str()),
+                                std::atoi(f[col["threads"]].c_str()),
+                                std::atof(f[col["sparsity"]].c_str()),
+                                std::atof(f[col["keep"]].c_str()));
+    out[key] = std::atof(f[col["seconds"]].c_str());
+  }
+  return out;
+}
+
+void writeResults(std::ostream& out, const std::vector<Result>& results,
+                  const Options& opt) {
+  const bool json = (opt.format == "json");
+  const bool compare = !opt.baseline.empty();
+  if (json) {
+    out << "{\"results\": [";
+  } else {
+    out << "kernel,n,p,block,sparsity,keep,threads,reps,seconds,min_seconds,"
+        << "variants_per_sec,sample_variants_per_sec,sweeps_per_sec";
+    if (compare) out << ",baseline_seconds,ratio,status";
+    out << "\n";
+  }
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    double vps = r.p / r.seconds;
+    double svps = (double) r.n * r.p / r.seconds;
+    double sps = r.sweeps / r.seconds;
+    double ratio = r.seconds / r.baseline;
+    if (json) {
+      out << (i ? ",\n  " : "\n  ")
+          << "{\"kernel\": \"" << r.kernel << "\", \"n\": " << r.n
+          << ", \"p\": " << r.p << ", \"block\": " << r.block
+          << ", \"sparsity\": " << r.sparsity << ", \"keep\": " << r.keep
+          << ", \"threads\": " << r.threads << ", \"reps\": " << opt.reps
+          << ", \"seconds\": " << r.seconds << ", \"min_seconds\": " << r.minseconds
+          << ", \"variants_per_sec\": " << vps
+          << ", \"sample_variants_per_sec\": " << svps
+          << ", \"sweeps_per_sec\": " << sps;
+      if (compare) {
+        if (std::isnan(r.baseline))
+          out << ", \"baseline_seconds\": null, \"ratio\": null";
+        else
+          out << ", \"baseline_seconds\": " << r.baseline << ", \"ratio\": " << ratio;
+        out << ", \"status\": \"" << r.status << "\"";
+      }
+      out << "}";
+    } else {
+      out << r.kernel << "," << r.n << "," << r.p << "," << r.block << ","
+          << r.sparsity << "," << r.keep << "," << r.threads << "," << opt.reps << ","
+          << r.seconds << "," << r.minseconds << "," << vps << "," << svps << ","
+          << sps;
+      if (compare) {
+        if (std::isnan(r.baseline)) out << ",NA,NA";
+        else out << "," << r.baseline << "," << ratio;
+        out << "," << r.status;
+      }
+      out << "\n";
+    }
+  }
+  if (json) out << "\n]}\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    Options opt = parseOptions(argc, argv);
+    ssctpr::setWarningStream(&std::cerr);
+    std::map<std::string, double> baseline;
+    if (!opt.baseline.empty()) baseline = readBaseline(opt.baseline);
+
+    std::vector<Result> results;
+    int regressions = 0;
+    for (size_t in = 0; in < opt.n.size(); in++) {
+      for (size_t ip = 0; ip < opt.p.size(); ip++) {
+        TempBed bed(opt.dir, opt.n[in], opt.p[ip], opt.seed);
+        for (size_t ik = 0; ik < opt.keep.size(); ik++) {
+          Dataset d;
+          prepare(d, bed.fileName, opt.n[in], opt.p[ip], opt.keep[ik], opt);
+          for (size_t is = 0; is < opt.sparsity.size(); is++) {
+            Weights w;
+            makeWeights(w, opt.p[ip], opt.ncol, opt.sparsity[is], opt.seed);
+            for (size_t ib = 0; ib < opt.block.size(); ib++) {
+              for (size_t it = 0; it < opt.threads.size(); it++) {
+                for (size_t kk = 0; kk < opt.kernels.size(); kk++) {
+                  Result r = runKernel(opt.kernels[kk], bed.fileName, d, w,
+                                       opt.block[ib], opt.threads[it], opt);
+                  r.sparsity = opt.sparsity[is];
+                  r.keep = opt.keep[ik];
+                  if (!opt.baseline.empty()) {
+                    std::map<std::string, double>::const_iterator b = baseline.find(
+                      resultKey(r.kernel, r.n, r.p, r.block, r.threads,
+                                r.sparsity, r.keep));
+                    if (b == baseline.end()) {
+                      r.status = "new";
+                    } else {
+                      r.baseline = b->second;
+                      if (r.seconds > r.baseline * (1.0 + opt.tolerance)) {
+                        r.status = "regression";
+                        regressions++;
+                      } else if (r.seconds < r.baseline * (1.0 - opt.tolerance)) {
+                        r.status = "improved";
+                      } else {
+                        r.status = "ok";
+                      }
+                    }
+                  }
+                  results.push_back(r);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
+    if (opt.out.empty()) {
+      writeResults(std::cout, results, opt);
+    } else {
+      std::ofstream out(opt.out.c_str());
+      if (!out) throw std::runtime_error("Cannot write " + opt.out);
+      writeResults(out, results, opt);
+    }
+    if (regressions > 0) {
+      std::cerr << regressions << " kernel(s) slower than the baseline by more than "
+                << opt.tolerance * 100 << "%" << std::endl;
+      return 1;
+    }
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_bench: " << e.what() << std::endl;
+    return 2;
+  } catch (const char* e) {
+    std::cerr << "ssctpr_bench: " << e << std::endl;
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Checks ssctpr_run --format binary: the scores file must hold the kept rows
+# of the test .fam and the text scores column by column, and the column
+# pointers of the weights file the number of text weights of each column.
+# Usage: binary_test.sh BUILD_DIR
+set -e
+B=$1
+D=$(mktemp -d)
+trap 'rm -rf "$D"' EXIT
+
+"$B/ssctpr_simulate" --out "$D/cohort" --n 401 --p 2000 --traits 2 --seed 9 2>/dev/null
+awk 'NR % 3 { print $1, $2 }' "$D/cohort.fam" > "$D/keep"
+ARGS="--ref $D/cohort --test $D/cohort --keep-test $D/keep
+  --sumstats $D/cohort.sumstats --secondary BETA.Y2
+  --adj $D/cohort.adj --blocks $D/cohort.blocks.bed
+  --shrink 0.5,1 --lambda 0.001,0.01 --lambda-ct 0,0.1"
+"$B/ssctpr_run" $ARGS --out "$D/text" 2>/dev/null
+# a small --mem-limit writes the weights a few columns at a time
+"$B/ssctpr_run" $ARGS --out "$D/binary" --format binary --mem-limit 40000 2>/dev/null
+
+# header: magic, version, rows (int), columns (long long); then the samples
+n=$(wc -l < "$D/keep")
+ncol=$(($(wc -l < "$D/binary.columns") - 1))
+od -A n -t d4 -v -j 24 -N $((4 * n)) "$D/binary.scores" | tr -s ' ' '\n' |
+  sed '/^$/d' > "$D/samples"
+awk 'NR % 3 { print NR - 1 }' "$D/cohort.fam" | cmp -s - "$D/samples" ||
+  { echo "sample index differs from the kept rows of the fam"; exit 1; }
+od -A n -t f8 -v -j $((24 + 4 * n)) "$D/binary.scores" | tr -s ' ' '\n' |
+  sed '/^$/d' > "$D/scores"
+test "$(wc -l < "$D/scores")" -eq $((n * ncol))
+awk -v n=$n 'NR == FNR { s[NR - 1] = $1; next }
+  FNR > 1 { for (c = 3; c <= NF; c++) {
+    b = s[(c - 3) * n + FNR - 2]; d = $c - b; if (d < 0) d = -d
+    a = b < 0 ? -b : b
+    if (d > 1e-8 * a + 1e-12) { print "score differs at " FNR ", " c ": " $c " " b; exit 1 } } }' \
+  "$D/scores" "$D/text.scores"
+
+# the column pointers (long long) end the weights file
+tail -c $((8 * (ncol + 1))) "$D/binary.weights" | od -A n -t d8 -v |
+  tr -s ' ' '\n' | sed '/^$/d' > "$D/colptr"
+awk 'FILENAME ~ /text.weights$/ { if (FNR > 1) count[$4 " " $5 " " $6]++; next }
+  FILENAME ~ /colptr$/ { ptr[FNR - 1] = $1; next }
+  FNR > 1 { k = FNR - 2; nnz = ptr[k + 1] - ptr[k]
+    if (nnz != count[$1 " " $2 " " $3] + 0) {
+      print "column " k " has " nnz " weights, not " count[$1 " " $2 " " $3] + 0; exit 1 } }' \
+  "$D/text.weights" "$D/colptr" "$D/binary.columns"
+echo "binary weights and scores agree with the text outputs"
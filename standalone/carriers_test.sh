@@ -0,0 +1,17 @@
+#!/bin/sh
+# Checks ssctpr_run --carriers F: the rare variants must be solved on their
+# carrier lists, and the weights must agree with those of the dense columns
+# up to rounding (the updates are the same).
+# Usage: carriers_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 7
+"$B/ssctpr_run" $ARGS --out "$D/dense" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/carriers" --carriers 0.2 2>/dev/null
+awk '$1 == "variants.carriers" { c = $2 }
+  END { if (c <= 0) { print c " variants on carrier lists"; exit 1 } }' \
+  "$D/carriers.log"
+compare_weights "$D/dense.weights" "$D/carriers.weights" 1e-8
+echo "carrier lists agree with the dense columns"
@@ -0,0 +1,305 @@
+/**
+ ssCTPR
+ client.cpp
+ Purpose: client of the scoring daemon (serve.cpp)
+
+ @author Yingxi Yang
+
+ Usage: ssctpr_client --socket PATH --weights FILE [--out FILE]
+                      [--concurrent 1]
+        ssctpr_client --socket PATH --info | --shutdown
+
+ The weights file has a header and columns SNP and A1 (A2 is ignored), and
+ either
+ - a column beta, with the remaining columns identifying the weight sets,
+   as in the .weights file of ssctpr_run (one set per s, lambda_ct, lambda);
+   sets are sorted by these columns (numerically where possible), or
+ - one column per weight set.
+ Scores are written as FID IID and one column per weight set. With
+ --concurrent K, the request is sent on K connections at once (which the
+ daemon batches into shared passes) and the answers are checked to agree.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include "protocol.h"
+
+namespace {
+
+struct Options {
+  std::string socket, weights, out;
+  int concurrent;
+  bool info, shutdown;
+  Options() : concurrent(1), info(false), shutdown(false) {}
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_client --socket PATH --weights FILE [options]\n"
+    "       ssctpr_client --socket PATH --info | --shutdown\n"
+    "  --socket PATH      socket of ssctpr_serve\n"
+    "  --weights FILE     weights (see the source for the formats)\n"
+    "  --out FILE         scores (stdout)\n"
+    "  --concurrent K     send the request on K connections at once (1)\n"
+    "  --info             print the number of samples and variants\n"
+    "  --shutdown         stop the daemon\n";
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (a == "--info") { opt.info = true; continue; }
+    if (a == "--shutdown") { opt.shutdown = true; continue; }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    std::string v = argv[++i];
+    if (a == "--socket") opt.socket = v;
+    else if (a == "--weights") opt.weights = v;
+    else if (a == "--out") opt.out = v;
+    else if (a == "--concurrent") opt.concurrent = std::atoi(v.c_str());
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  if (opt.socket.empty()) throw std::runtime_error("--socket must be specified");
+  if (!opt.info && !opt.shutdown && opt.weights.empty())
+    throw std::runtime_error("--weights must be specified");
+  if (opt.concurrent < 1) throw std::runtime_error("--concurrent must be positive");
+  return opt;
+}
+
+/**
+ A SCORE request: the weight lines and the names of the columns
+
+ */
+struct Weights {
+  std::vector<std::string> names;
+  std::string body; // "SNP A1 column beta" lines
+  long long count;
+  Weights() : count(0) {}
+};
+
+bool numericLess(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+  for (size_t i = 0; i < a.size(); i++) {
+    char *ea, *eb;
+    double x = std::strtod(a[i].c_str(), &ea), y = std::strtod(b[i].c_str(), &eb);
+    if (*ea == '\0' && *eb == '\0') {
+      if (x != y) return x < y;
+    } else if (a[i] != b[i]) {
+      return a[i] < b[i];
+    }
+  }
+  return false;
+}
+
+Weights readWeights(const std::string& fileName) {
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  std::string line, field;
+  if (!std::getline(in, line)) throw std::runtime_error(fileName + " is empty");
+  std::vector<std::string> header;
+  std::istringstream h(line);
+  while (h >> field) header.push_back(field);
+  int snp = -1, a1 = -1, beta = -1;
+  std::vector<int> other;
+  for (size_t k = 0; k < header.size(); k++) {
+    if (header[k] == "SNP") snp = k;
+    else if (header[k] == "A1") a1 = k;
+    else if (header[k] == "beta") beta = k;
+    else if (header[k] != "A2") other.push_back(k);
+  }
+  if (snp < 0 || a1 < 0) throw std::runtime_error(fileName + " needs columns SNP and A1");
+
+  Weights w;
+  std::ostringstream body;
+  body << std::setprecision(17);
+  std::vector<std::string> fields;
+  if (beta < 0) {
+    for (size_t k = 0; k < other.size(); k++) w.names.push_back(header[other[k]]);
+    while (std::getline(in, line)) {
+      std::istringstream s(line);
+      fields.clear();
+      while (s >> field) fields.push_back(field);
+      if (fields.empty()) continue;
+      if (fields.size() != header.size())
+        throw std::runtime_error("Wrong number of fields in " + fileName);
+      for (size_t k = 0; k < other.size(); k++) {
+        double b = std::atof(fields[other[k]].c_str());
+        if (b == 0.0) continue;
+        body << fields[snp] << " " << fields[a1] << " " << k << " " << b << "\n";
+        w.count++;
+      }
+    }
+  } else {
+    // long format: weight sets are the distinct values of the other columns
+    std::vector<std::vector<std::string> > keys;
+    std::map<std::vector<std::string>, int> sets;
+    std::vector<std::string> snps, a1s;
+    std::vector<int> set;
+    std::vector<double> betas;
+    while (std::getline(in, line)) {
+      std::istringstream s(line);
+      fields.clear();
+      while (s >> field) fields.push_back(field);
+      if (fields.empty()) continue;
+      if (fields.size() != header.size())
+        throw std::runtime_error("Wrong number of fields in " + fileName);
+      std::vector<std::string> key;
+      for (size_t k = 0; k < other.size(); k++) key.push_back(fields[other[k]]);
+      std::map<std::vector<std::string>, int>::iterator it = sets.find(key);
+      if (it == sets.end()) {
+        it = sets.insert(std::make_pair(key, (int) keys.size())).first;
+        keys.push_back(key);
+      }
+      snps.push_back(fields[snp]);
+      a1s.push_back(fields[a1]);
+      set.push_back(it->second);
+      betas.push_back(std::atof(fields[beta].c_str()));
+    }
+    std::vector<int> order(keys.size());
+    for (size_t k = 0; k < order.size(); k++) order[k] = k;
+    std::sort(order.begin(), order.end(),
+              [&](int a, int b) { return numericLess(keys[a], keys[b]); });
+    std::vector<int> column(keys.size());
+    for (size_t k = 0; k < order.size(); k++) {
+      column[order[k]] = k;
+      std::string name;
+      for (size_t i = 0; i < other.size(); i++) {
+        if (i > 0) name += "_";
+        name += header[other[i]];
+        name += keys[order[k]][i];
+      }
+      w.names.push_back(name.empty() ? "score" : name);
+    }
+    for (size_t i = 0; i < snps.size(); i++) {
+      body << snps[i] << " " << a1s[i] << " " << column[set[i]] << " " << betas[i] << "\n";
+      w.count++;
+    }
+  }
+  if (w.names.empty()) throw std::runtime_error("No weights in " + fileName);
+  w.body = body.str();
+  return w;
+}
+
+std::string expectOK(ssctpr::SocketReader& in) {
+  std::string line;
+  if (!in.readLine(line)) throw std::runtime_error("Connection closed by the daemon");
+  if (line == "OK" || line.compare(0, 3, "OK ") == 0) return line;
+  throw std::runtime_error("Daemon: " + line);
+}
+
+struct Answer {
+  std::vector<double> scores;
+  int matched, batch;
+  double seconds;
+  std::string error;
+};
+
+void score(const std::string& socket, const Weights& w, Answer& a) {
+  try {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int fd = ssctpr::connectSocket(socket);
+    ssctpr::SocketReader in(fd);
+    std::ostringstream header;
+    header << "SCORE " << w.names.size() << " " << w.count << "\n";
+    ssctpr::writeAll(fd, header.str());
+    ssctpr::writeAll(fd, w.body);
+    std::istringstream s(expectOK(in).substr(2));
+    int n, ncol;
+    s >> n >> ncol >> a.matched >> a.batch;
+    a.scores.resize((size_t) n * ncol);
+    in.readBytes((char*) a.scores.data(), a.scores.size() * sizeof(double));
+    ::close(fd);
+    a.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  } catch (std::exception& e) {
+    a.error = e.what();
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    Options opt = parseOptions(argc, argv);
+    if (opt.info || opt.shutdown) {
+      int fd = ssctpr::connectSocket(opt.socket);
+      ssctpr::SocketReader in(fd);
+      ssctpr::writeAll(fd, opt.info ? "INFO\n" : "SHUTDOWN\n");
+      std::string reply = expectOK(in);
+      if (opt.info) std::cout << reply.substr(3) << "\n";
+      ::close(fd);
+      return 0;
+    }
+
+    Weights w = readWeights(opt.weights);
+
+    // sample ids
+    std::vector<std::string> ids;
+    {
+      int fd = ssctpr::connectSocket(opt.socket);
+      ssctpr::SocketReader in(fd);
+      ssctpr::writeAll(fd, "SAMPLES\n");
+      int n = std::atoi(expectOK(in).substr(3).c_str());
+      std::string line;
+      for (int i = 0; i < n && in.readLine(line); i++) ids.push_back(line);
+      ::close(fd);
+    }
+
+    std::vector<Answer> answers(opt.concurrent);
+    std::vector<std::thread> pool;
+    for (int k = 0; k < opt.concurrent; k++)
+      pool.push_back(std::thread(score, opt.socket, std::cref(w), std::ref(answers[k])));
+    for (size_t k = 0; k < pool.size(); k++) pool[k].join();
+    for (int k = 0; k < opt.concurrent; k++) {
+      if (!answers[k].error.empty()) throw std::runtime_error(answers[k].error);
+      std::cerr << "Request " << k + 1 << ": " << answers[k].matched << " of "
+                << w.count << " weights matched, batch of " << answers[k].batch
+                << ", " << answers[k].seconds << "s" << std::endl;
+      if (answers[k].scores != answers[0].scores)
+        throw std::runtime_error("Concurrent requests returned different scores");
+    }
+
+    const std::vector<double>& scores = answers[0].scores;
+    const size_t n = ids.size();
+    if (scores.size() != n * w.names.size())
+      throw std::runtime_error("Unexpected size of the scores");
+    std::ofstream file;
+    if (!opt.out.empty()) {
+      file.open(opt.out.c_str());
+      if (!file) throw std::runtime_error("Cannot write " + opt.out);
+    }
+    std::ostream& out = opt.out.empty() ? std::cout : file;
+    out << "FID\tIID";
+    for (size_t c = 0; c < w.names.size(); c++) out << "\t" << w.names[c];
+    out << "\n" << std::setprecision(10);
+    for (size_t i = 0; i < n; i++) {
+      std::istringstream s(ids[i]);
+      std::string fid, iid;
+      s >> fid >> iid;
+      out << fid << "\t" << iid;
+      for (size_t c = 0; c < w.names.size(); c++) out << "\t" << scores[i + c * n];
+      out << "\n";
+    }
+    if (!out) throw std::runtime_error("Cannot write the scores");
+    return 0;
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_client: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+# End-to-end test of the scoring daemon: the scores of ssctpr_run and of
+# ssctpr_serve/ssctpr_client (with concurrent, batched requests) must agree.
+# Usage: daemon_test.sh BUILD_DIR
+set -e
+B=$1
+D=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null || true; rm -rf "$D"' EXIT
+
+"$B/ssctpr_simulate" --out "$D/cohort" --n 301 --p 3000 --traits 1 --seed 2 2>/dev/null
+"$B/ssctpr_run" --ref "$D/cohort" --sumstats "$D/cohort.sumstats" \
+  --blocks "$D/cohort.blocks.bed" --test "$D/cohort" --out "$D/run" \
+  --shrink 0.9,1 --lambda 0.001,0.005 2>/dev/null
+
+for load in mmap memory; do
+  "$B/ssctpr_serve" --bfile "$D/cohort" --socket "$D/socket" --threads 3 \
+    --load $load --batch-wait 50 2>/dev/null &
+  SERVER=$!
+  i=0
+  while [ ! -S "$D/socket" ]; do
+    i=$((i + 1))
+    [ $i -lt 100 ] || { echo "daemon did not start"; exit 1; }
+    sleep 0.1
+  done
+  "$B/ssctpr_client" --socket "$D/socket" --weights "$D/run.weights" \
+    --out "$D/client.scores" --concurrent 4
+  "$B/ssctpr_client" --socket "$D/socket" --shutdown
+  wait $SERVER
+
+  paste "$D/run.scores" "$D/client.scores" | awk '
+    NR == 1 { if (NF % 2) exit 1; k = NF / 2; next }
+    { for (i = 3; i <= k; i++) { d = $i - $(i + k); if (d < 0) d = -d;
+        if (d > 1e-8) { print "score mismatch line " NR " column " i; bad = 1 } } }
+    END { if (NR < 302) { print "missing lines"; bad = 1 }; exit bad }'
+  echo "$load: scores agree"
+done
@@ -0,0 +1,756 @@
+/**
+ ssCTPR
+ difftest.cpp
+ Purpose: differential tests of the kernels in src/kernels.cpp (and any
+ alternative engine) against the frozen reference kernels in reference.cpp
+
+ @author Yingxi Yang
+
+ Usage: ssctpr_difftest [--cases 200] [--seed 1] [--threads 1,2,3,4]
+                        [--engines LIST] [--kernels LIST] [--case I]
+                        [--dir DIR] [--verbose 1]
+
+ Each case draws a random bed file (N not a multiple of 4 most of the time,
+ with missing genotypes), a random keep mask (keepbytes/keepoffset, in
+ file order or shuffled), a random extract mask (col_skip), fillmissing,
+ score weights of random sparsity and random LD blocks, and the bed file gets a sample-major cache
+ with tiles of 4 to 16 variants (which the kernels may pick by themselves). Every engine runs every kernel at every
+ thread count, splitting variants (decode, normalize, scoresp) or blocks
+ (solve) between threads as the R clusters do, and the results are compared
+ with the reference. The exit status is 1 if any difference exceeds the
+ tolerance of the kernel; failing cases can be rerun alone with --case.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <stdexcept>
+#include <unistd.h>
+#include "kernels.h"
+#include "reference.h"
+
+namespace {
+
+typedef int (*DecodeKernel)(const std::string&, int, int,
+                            const ssctpr::BedSelection&, int, double*);
+typedef int (*ScoreKernel)(const std::string&, int, int, const double*,
+                           const int*, int, const int*, int,
+                           const ssctpr::BedSelection&, int, double*);
+typedef void (*NormalizeKernel)(double*, int, int, double*);
+typedef int (*SolveKernel)(double, double, double, const double*,
+                           const double*, int, int, const double*, int,
+                           const double*, double, double*, double*, int, int,
+                           const int*, const int*, int,
+                           std::vector<ssctpr::ElnetTelemetry>&);
+
+/**
+ An implementation of the kernels under test. A null kernel is not tested.
+ solvetol is the tolerance of the solve kernel, relative to the largest
+ coefficient; engines that do not reproduce the coordinate descent updates
+ exactly (e.g. other solvers) need more than rounding error. table engines
+ compact keep subsets with the lookup table; the others use pext where the
+ CPU has BMI2.
+
+ */
+struct Engine {
+  const char* name;
+  DecodeKernel decode;
+  NormalizeKernel normalize;
+  ScoreKernel scoresp;
+  SolveKernel solve;
+  double solvetol;
+  bool table;
+};
+
+/**
+ multiBed3spBuffer on the bed file read into memory
+
+ */
+int bufferScore(const std::string& fileName, int N, int P, const double* beta,
+                const int* nonzeros, int nvariants, const int* colpos, int ncol,
+                const ssctpr::BedSelection& sel, int trace, double* result) {
+  std::ifstream in(fileName.c_str(), std::ios::binary);
+  std::vector<char> bed((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+  if (bed.size() < 3 + ssctpr::bedBytes(N) * P)
+    throw std::runtime_error("Truncated " + fileName);
+  return ssctpr::multiBed3spBuffer(&bed[3], N, P, beta, nonzeros, nvariants,
+                                   colpos, ncol, sel, result);
+}
+
+/**
+ repelnet with the FISTA block solver
+
+ */
+int fistaSolve(double lambda1, double lambda2, double lambda_ct,
+               const double* diag, const double* X, int n, int p,
+               const double* r, int traits, const double* adj, double thr,
+               double* x, double* yhat, int trace, int maxiter,
+               const int* startvec, const int* endvec, int nblocks,
+               std::vector<ssctpr::ElnetTelemetry>& tel) {
+  return ssctpr::repelnetSolver(lambda1, lambda2, lambda_ct, diag, X, n, p, r,
+                                traits, adj, thr, x, yhat, trace, maxiter,
+                                ssctpr::solverFISTA, 0, startvec, endvec,
+                                nblocks, tel);
+}
+
+/**
+ repelnet with the columns with at most half of their rows away from
+ their most common value as carrier lists
+
+ */
+int carrierSolve(double lambda1, double lambda2, double lambda_ct,
+                 const double* diag, const double* X, int n, int p,
+                 const double* r, int traits, const double* adj, double thr,
+                 double* x, double* yhat, int trace, int maxiter,
+                 const int* startvec, const int* endvec, int nblocks,
+                 std::vector<ssctpr::ElnetTelemetry>& tel) {
+  ssctpr::CarrierColumns cc;
+  ssctpr::carrierColumns(X, n, p, 0.5, cc);
+  return ssctpr::repelnetSolver(lambda1, lambda2, lambda_ct, diag, X, n, p, r,
+                                traits, adj, thr, x, yhat, trace, maxiter,
+                                ssctpr::solverCD, &cc, startvec, endvec,
+                                nblocks, tel);
+}
+
+/**
+ repelnet with the blocks split between 3 threads of the kernel pool
+ (blocks of the other test threads are solved on their own thread)
+
+ */
+int poolSolve(double lambda1, double lambda2, double lambda_ct,
+              const double* diag, const double* X, int n, int p,
+              const double* r, int traits, const double* adj, double thr,
+              double* x, double* yhat, int trace, int maxiter,
+              const int* startvec, const int* endvec, int nblocks,
+              std::vector<ssctpr::ElnetTelemetry>& tel) {
+  ssctpr::setThreads(3);
+  const int conv = ssctpr::repelnet(lambda1, lambda2, lambda_ct, diag, X, n, p,
+                                    r, traits, adj, thr, x, yhat, trace,
+                                    maxiter, startvec, endvec, nblocks, tel);
+  ssctpr::setThreads(1);
+  return conv;
+}
+
+/**
+ repelnet with the tuned block solver: elnet below 20 variants (about half
+ of the blocks), FISTA from 20 on
+
+ */
+int tunedSolve(double lambda1, double lambda2, double lambda_ct,
+               const double* diag, const double* X, int n, int p,
+               const double* r, int traits, const double* adj, double thr,
+               double* x, double* yhat, int trace, int maxiter,
+               const int* startvec, const int* endvec, int nblocks,
+               std::vector<ssctpr::ElnetTelemetry>& tel) {
+  ssctpr::setFistaVariants(20);
+  return ssctpr::repelnetSolver(lambda1, lambda2, lambda_ct, diag, X, n, p, r,
+                                traits, adj, thr, x, yhat, trace, maxiter,
+                                ssctpr::solverTuned, 0, startvec, endvec,
+                                nblocks, tel);
+}
+
+const Engine allEngines[] = {
+  {"kernels", ssctpr::genotypeMatrix, ssctpr::normalize, ssctpr::multiBed3sp,
+   ssctpr::repelnet, 1e-10},
+  {"buffer", 0, 0, bufferScore, 0, 0.0},
+  {"samplemajor", ssctpr::genotypeMatrixSampleMajor, 0,
+   ssctpr::multiBed3spSampleMajor, 0, 0.0},
+  {"fista", 0, 0, 0, fistaSolve, 1e-3},
+  {"carriers", 0, 0, 0, carrierSolve, 1e-10},
+  {"pool", 0, 0, 0, poolSolve, 1e-10},
+  {"tuned", 0, 0, 0, tunedSolve, 1e-3},
+  {"table", ssctpr::genotypeMatrix, 0, ssctpr::multiBed3sp, 0, 0.0, true},
+};
+const int nengines = sizeof(allEngines) / sizeof(allEngines[0]);
+
+// tolerances relative to max(1, largest absolute reference value)
+const double decodetol = 0.0;
+const double normalizetol = 1e-12;
+const double scoretol = 1e-12;
+
+struct Options {
+  int cases, only, verbose;
+  unsigned long seed;
+  std::vector<int> threads;
+  std::vector<std::string> engines, kernels;
+  std::string dir;
+  Options() : cases(200), only(-1), verbose(0), seed(1) {
+    const int t[] = {1, 2, 3, 4};
+    threads.assign(t, t + 4);
+    for (int e = 0; e < nengines; e++) engines.push_back(allEngines[e].name);
+    const char* all[] = {"decode", "normalize", "scoresp", "solve"};
+    kernels.assign(all, all + 4);
+    const char* tmp = std::getenv("TMPDIR");
+    dir = tmp ? tmp : "/tmp";
+  }
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_difftest [options]\n"
+    "  --cases C         number of random cases (200)\n"
+    "  --seed S          random seed (1)\n"
+    "  --case I          only run case I (of the same seed)\n"
+    "  --threads LIST    thread counts (1,2,3,4)\n"
+    "  --engines LIST    engines to test (all)\n"
+    "  --kernels LIST    decode,normalize,scoresp,solve\n"
+    "  --dir DIR         directory for the temporary bed files ($TMPDIR)\n"
+    "  --verbose V       1 = print every case (0)\n";
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) out.push_back(item);
+  return out;
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    std::string v = argv[++i];
+    if (a == "--cases") opt.cases = std::atoi(v.c_str());
+    else if (a == "--seed") opt.seed = std::strtoul(v.c_str(), 0, 10);
+    else if (a == "--case") opt.only = std::atoi(v.c_str());
+    else if (a == "--verbose") opt.verbose = std::atoi(v.c_str());
+    else if (a == "--engines") opt.engines = splitList(v);
+    else if (a == "--kernels") opt.kernels = splitList(v);
+    else if (a == "--dir") opt.dir = v;
+    else if (a == "--threads") {
+      opt.threads.clear();
+      std::vector<std::string> items = splitList(v);
+      for (size_t k = 0; k < items.size(); k++)
+        opt.threads.push_back(std::atoi(items[k].c_str()));
+    }
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  for (size_t e = 0; e < opt.engines.size(); e++) {
+    bool found = false;
+    for (int k = 0; k < nengines; k++) found |= (opt.engines[e] == allEngines[k].name);
+    if (!found) throw std::runtime_error("Unknown engine " + opt.engines[e]);
+  }
+  for (size_t t = 0; t < opt.threads.size(); t++) {
+    if (opt.threads[t] < 1) throw std::runtime_error("--threads must be positive");
+  }
+  return opt;
+}
+
+/**
+ Runs f(t, from, to) on `threads` threads over contiguous ranges of [0, total)
+
+ */
+template <class F>
+void parallelRanges(int threads, int total, F f) {
+  threads = std::max(1, std::min(threads, total));
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    int from = (long long) total * t / threads;
+    int to = (long long) total * (t + 1) / threads;
+    pool.push_back(std::thread(f, t, from, to));
+  }
+  for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+/**
+ col_skip_pos/col_skip of the variants not in `extract`, as built in R by
+ selectregion(!extract) with 0-based starts
+
+ */
+struct Skips {
+  std::vector<int> col_skip_pos, col_skip;
+  explicit Skips(const std::vector<char>& extract) {
+    const int P = extract.size();
+    for (int i = 0; i < P; i++) {
+      if (extract[i]) continue;
+      if (i > 0 && !extract[i - 1]) {
+        col_skip.back()++;
+      } else {
+        col_skip_pos.push_back(i);
+        col_skip.push_back(1);
+      }
+    }
+  }
+};
+
+/**
+ One random test case
+
+ */
+struct Case {
+  int index;
+  int N, P, n, p;
+  int fillmissing, traits, ncol;
+  double missing, sparsity, shrink, lambda, lambdact;
+  std::string bed;
+  std::vector<char> extract;                // P, variants read
+  std::vector<int> keepbytes, keepoffset;   // empty = keep all
+  std::vector<double> beta;                 // sparse weights of the p variants
+  std::vector<int> nonzeros, colpos;
+  std::vector<int> startvec, endvec;        // blocks of the p variants
+
+  ssctpr::BedSelection selection(const Skips& skips) const {
+    ssctpr::BedSelection sel;
+    sel.nskip = skips.col_skip_pos.size();
+    sel.col_skip_pos = sel.nskip ? &skips.col_skip_pos[0] : 0;
+    sel.col_skip = sel.nskip ? &skips.col_skip[0] : 0;
+    sel.nkeep = keepbytes.size();
+    sel.keepbytes = sel.nkeep ? &keepbytes[0] : 0;
+    sel.keepoffset = sel.nkeep ? &keepoffset[0] : 0;
+    return sel;
+  }
+
+  std::string describe() const {
+    std::ostringstream s;
+    s << "case " << index << ": N=" << N << " P=" << P << " n=" << n
+      << " p=" << p << " fillmissing=" << fillmissing << " missing=" << missing
+      << " sparsity=" << sparsity << " ncol=" << ncol << " traits=" << traits
+      << " blocks=" << startvec.size();
+    return s.str();
+  }
+};
+
+void writeBed(const Case& c, std::mt19937_64& rng) {
+  FILE* f = std::fopen(c.bed.c_str(), "wb");
+  if (!f) throw std::runtime_error("Cannot write " + c.bed);
+  const unsigned char magic[3] = {0x6c, 0x1b, 0x01};
+  std::fwrite(magic, 1, 3, f);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  const unsigned long long Nbytes = ssctpr::bedBytes(c.N);
+  std::vector<unsigned char> ch(Nbytes);
+  // by dosage, then missing
+  const unsigned char codes[4] = {0x3, 0x2, 0x0, 0x1};
+  for (int j = 0; j < c.P; j++) {
+    // some monomorphic variants, for the zero sd paths
+    double maf = (unif(rng) < 0.1) ? 0.0 : unif(rng) * 0.5;
+    for (unsigned long long k = 0; k < Nbytes; k++) ch[k] = rng() & 0xff;
+    for (int i = 0; i < c.N; i++) {
+      int code = (unif(rng) < c.missing) ? 3 :
+        (unif(rng) < maf) + (unif(rng) < maf);
+      ch[i / 4] &= ~(0x3 << ((i % 4) * 2));
+      ch[i / 4] |= codes[code] << ((i % 4) * 2);
+    }
+    // the padding bits of the last byte are left random on purpose
+    std::fwrite(&ch[0], 1, Nbytes, f);
+  }
+  std::fclose(f);
+}
+
+Case makeCase(int index, const Options& opt) {
+  std::mt19937_64 rng(opt.seed * 1000003ULL + index);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  std::normal_distribution<double> norm(0.0, 1.0);
+  Case c;
+  c.index = index;
+  c.N = 1 + rng() % (unif(rng) < 0.2 ? 8 : 300);
+  c.P = 1 + rng() % (unif(rng) < 0.2 ? 5 : 150);
+  c.fillmissing = rng() % 2;
+  c.traits = 1 + rng() % 2;
+  c.ncol = 1 + rng() % 4;
+  const double missing[] = {0.0, 0.01, 0.2};
+  c.missing = missing[rng() % 3];
+  const double sparsity[] = {0.0, 0.05, 0.3, 1.0};
+  c.sparsity = sparsity[rng() % 4];
+  const double shrink[] = {0.2, 0.5, 0.9};
+  c.shrink = shrink[rng() % 3];
+  c.lambda = std::exp(std::log(1e-4) + unif(rng) * std::log(1e3));
+  c.lambdact = (c.traits > 1) ? unif(rng) * 0.5 : 0.0;
+
+  // keep: all, or a random (possibly tiny) subset, in file order or shuffled
+  // (for the lookups by sample rather than by byte)
+  if (unif(rng) < 0.6) {
+    double frac = unif(rng);
+    for (int i = 0; i < c.N; i++) {
+      if (unif(rng) < frac) {
+        c.keepbytes.push_back(i / 4);
+        c.keepoffset.push_back(i % 4 * 2);
+      }
+    }
+    if (c.keepbytes.empty()) {
+      int i = rng() % c.N;
+      c.keepbytes.push_back(i / 4);
+      c.keepoffset.push_back(i % 4 * 2);
+    }
+    if (unif(rng) < 0.3) {
+      std::vector<int> order(c.keepbytes.size());
+      for (size_t i = 0; i < order.size(); i++) order[i] = i;
+      std::shuffle(order.begin(), order.end(), rng);
+      std::vector<int> bytes(order.size()), offsets(order.size());
+      for (size_t i = 0; i < order.size(); i++) {
+        bytes[i] = c.keepbytes[order[i]];
+        offsets[i] = c.keepoffset[order[i]];
+      }
+      c.keepbytes.swap(bytes);
+      c.keepoffset.swap(offsets);
+    }
+  }
+  c.n = c.keepbytes.empty() ? c.N : c.keepbytes.size();
+
+  // extract: all, or runs of variants
+  c.extract.assign(c.P, 1);
+  if (unif(rng) < 0.6) {
+    double frac = unif(rng);
+    for (int i = 0; i < c.P; i++) {
+      if (i == 0 || unif(rng) < 0.3) c.extract[i] = unif(rng) < frac;
+      else c.extract[i] = c.extract[i - 1];
+    }
+    c.extract[rng() % c.P] = 1;
+  }
+  c.p = 0;
+  for (int i = 0; i < c.P; i++) c.p += c.extract[i];
+
+  c.nonzeros.assign(c.p, 0);
+  for (int j = 0; j < c.p; j++) {
+    for (int k = 0; k < c.ncol; k++) {
+      if (unif(rng) < c.sparsity) {
+        c.beta.push_back(norm(rng));
+        c.colpos.push_back(k);
+        c.nonzeros[j]++;
+      }
+    }
+  }
+
+  for (int s = 0; s < c.p;) {
+    int len = 1 + rng() % 40;
+    c.startvec.push_back(s);
+    c.endvec.push_back(std::min(c.p, s + len) - 1);
+    s += len;
+  }
+
+  std::ostringstream s;
+  s << opt.dir << "/ssctpr_difftest_" << getpid() << "_" << index << ".bed";
+  c.bed = s.str();
+  writeBed(c, rng);
+  ssctpr::buildSampleMajorCache(c.bed, c.N, c.P, 4 * (1 + index % 4));
+  return c;
+}
+
+/**
+ Inputs of the solve kernel, from the reference kernels: X is the normalized
+ genotypes times sqrt(1-s) as in runElnet, r the correlations with a random
+ phenotype
+
+ */
+struct Problem {
+  std::vector<double> X, diag, r, adj;
+};
+
+Problem makeProblem(const Case& c, const std::vector<double>& genotypes) {
+  std::mt19937_64 rng(c.index + 17);
+  std::normal_distribution<double> norm(0.0, 1.0);
+  std::uniform_real_distribution<double> unif(0.0, 1.0);
+  Problem pr;
+  pr.X = genotypes;
+  std::vector<double> sd(c.p);
+  ssctpr::reference::normalize(&pr.X[0], c.n, c.p, &sd[0]);
+  const double scale = std::sqrt(1.0 - c.shrink);
+  for (size_t i = 0; i < pr.X.size(); i++) pr.X[i] *= scale;
+  pr.diag.assign(c.p, 1.0 - c.shrink);
+  for (int j = 0; j < c.p; j++) if (sd[j] == 0.0) pr.diag[j] = 0.0;
+
+  std::vector<double> y(c.n);
+  for (int i = 0; i < c.n; i++) y[i] = norm(rng);
+  for (int j = 0; j < c.p; j++) {
+    if (unif(rng) < 0.1) {
+      double b = norm(rng);
+      for (int i = 0; i < c.n; i++) y[i] += b * pr.X[(size_t) j * c.n + i];
+    }
+  }
+  double yy = 0.0;
+  for (int i = 0; i < c.n; i++) yy += y[i] * y[i];
+  yy = std::sqrt(yy);
+  pr.r.assign((size_t) c.p * c.traits, 0.0);
+  for (int j = 0; j < c.p; j++) {
+    double dot = 0.0;
+    for (int i = 0; i < c.n; i++) dot += pr.X[(size_t) j * c.n + i] * y[i];
+    pr.r[j] = (yy > 0.0) ? dot / yy / scale : 0.0;
+    if (c.traits > 1) pr.r[j + c.p] = pr.r[j] + 0.05 * norm(rng);
+  }
+  pr.adj.resize(c.p);
+  for (int j = 0; j < c.p; j++) pr.adj[j] = unif(rng);
+  return pr;
+}
+
+/**
+ Maximal differences between a result and the reference; NaNs must match
+
+ */
+struct Diff {
+  double maxabs, maxrel;
+  long long nanmismatch;
+  Diff() : maxabs(0.0), maxrel(0.0), nanmismatch(0) {}
+};
+
+Diff compare(const std::vector<double>& ref, const std::vector<double>& x) {
+  Diff d;
+  if (ref.size() != x.size()) {
+    d.nanmismatch = std::max(ref.size(), x.size());
+    return d;
+  }
+  double scale = 1.0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    if (!std::isnan(ref[i])) scale = std::max(scale, std::abs(ref[i]));
+  }
+  for (size_t i = 0; i < ref.size(); i++) {
+    if (std::isnan(ref[i]) || std::isnan(x[i])) {
+      if (std::isnan(ref[i]) != std::isnan(x[i])) d.nanmismatch++;
+      continue;
+    }
+    d.maxabs = std::max(d.maxabs, std::abs(ref[i] - x[i]));
+  }
+  d.maxrel = d.maxabs / scale;
+  return d;
+}
+
+/**
+ The selection of the selected variants [from, to) of a case
+
+ */
+Skips rangeSkips(const Case& c, int from, int to) {
+  std::vector<char> extract(c.extract);
+  int j = 0;
+  for (int i = 0; i < c.P; i++) {
+    if (!extract[i]) continue;
+    if (j < from || j >= to) extract[i] = 0;
+    j++;
+  }
+  return Skips(extract);
+}
+
+std::vector<double> runDecode(const Engine& e, const Case& c, int threads) {
+  std::vector<double> out((size_t) c.n * c.p);
+  parallelRanges(threads, c.p, [&](int t, int from, int to) {
+    Skips skips = rangeSkips(c, from, to);
+    std::vector<double> part((size_t) c.n * (to - from));
+    int read = e.decode(c.bed, c.N, c.P, c.selection(skips), c.fillmissing,
+                        part.data());
+    if (read != to - from) throw std::runtime_error("decode: wrong number of variants read");
+    std::copy(part.begin(), part.end(), out.begin() + (size_t) from * c.n);
+  });
+  return out;
+}
+
+std::vector<double> runNormalize(const Engine& e, const Case& c,
+                                 const std::vector<double>& genotypes,
+                                 int threads) {
+  std::vector<double> out(genotypes);
+  std::vector<double> sd(c.p);
+  parallelRanges(threads, c.p, [&](int t, int from, int to) {
+    e.normalize(&out[(size_t) from * c.n], c.n, to - from, &sd[from]);
+  });
+  out.insert(out.end(), sd.begin(), sd.end());
+  return out;
+}
+
+std::vector<double> runScore(const Engine& e, const Case& c, int threads) {
+  std::vector<int> offset(c.p + 1, 0);
+  for (int j = 0; j < c.p; j++) offset[j + 1] = offset[j] + c.nonzeros[j];
+  const int nt = std::max(1, std::min(threads, c.p));
+  std::vector<std::vector<double> > partial(nt);
+  parallelRanges(threads, c.p, [&](int t, int from, int to) {
+    Skips skips = rangeSkips(c, from, to);
+    partial[t].resize((size_t) c.n * c.ncol);
+    const int k = offset[from];
+    const double* beta = c.beta.empty() ? 0 : &c.beta[0] + k;
+    const int* colpos = c.colpos.empty() ? 0 : &c.colpos[0] + k;
+    int read = e.scoresp(c.bed, c.N, c.P, beta, &c.nonzeros[from], to - from,
+                         colpos, c.ncol, c.selection(skips), 0,
+                         partial[t].data());
+    if (read != to - from) throw std::runtime_error("scoresp: wrong number of variants read");
+  });
+  std::vector<double> out((size_t) c.n * c.ncol, 0.0);
+  for (int t = 0; t < nt; t++) {
+    for (size_t i = 0; i < out.size(); i++) out[i] += partial[t][i];
+  }
+  return out;
+}
+
+std::vector<double> runSolve(const Engine& e, const Case& c, const Problem& pr,
+                             int threads) {
+  const int nblocks = c.startvec.size();
+  const int nt = std::max(1, std::min(threads, nblocks));
+  std::vector<double> x(c.p, 0.0);
+  std::vector<std::vector<double> > partial(nt);
+  parallelRanges(threads, nblocks, [&](int t, int from, int to) {
+    partial[t].assign(c.n, 0.0);
+    std::vector<ssctpr::ElnetTelemetry> tel;
+    e.solve(c.lambda, c.shrink, c.lambdact, &pr.diag[0], &pr.X[0], c.n, c.p,
+            &pr.r[0], c.traits, &pr.adj[0], 1e-7, &x[0], partial[t].data(),
+            0, 1000, &c.startvec[from], &c.endvec[from], to - from, tel);
+  });
+  std::vector<double> out(x);
+  for (int i = 0; i < c.n; i++) {
+    double s = 0.0;
+    for (int t = 0; t < nt; t++) s += partial[t][i];
+    out.push_back(s);
+  }
+  return out;
+}
+
+/**
+ Totals of one engine, kernel and thread count over the cases
+
+ */
+struct Summary {
+  int cases, failures;
+  double maxabs, maxrel, tolerance;
+  std::string first;
+  Summary() : cases(0), failures(0), maxabs(0.0), maxrel(0.0), tolerance(0.0) {}
+};
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    Options opt = parseOptions(argc, argv);
+    const int nkernels = opt.kernels.size();
+    const int nthreads = opt.threads.size();
+    std::vector<const Engine*> selected;
+    for (int k = 0; k < nengines; k++) {
+      if (std::find(opt.engines.begin(), opt.engines.end(),
+                    std::string(allEngines[k].name)) != opt.engines.end())
+        selected.push_back(&allEngines[k]);
+    }
+    for (int k = 0; k < nkernels; k++) {
+      const std::string& kr = opt.kernels[k];
+      if (kr != "decode" && kr != "normalize" && kr != "scoresp" && kr != "solve")
+        throw std::runtime_error("Unknown kernel " + kr);
+    }
+    std::vector<Summary> summary(selected.size() * nkernels * nthreads);
+
+    const int from = opt.only >= 0 ? opt.only : 0;
+    const int to = opt.only >= 0 ? opt.only + 1 : opt.cases;
+    for (int index = from; index < to; index++) {
+      Case c = makeCase(index, opt);
+      if (opt.verbose) std::cerr << c.describe() << "\n";
+
+      Skips skips(c.extract);
+      const ssctpr::BedSelection sel = c.selection(skips);
+      std::vector<double> genotypes((size_t) c.n * c.p);
+      ssctpr::reference::genotypeMatrix(c.bed, c.N, c.P, sel, c.fillmissing,
+                                        genotypes.data());
+      std::vector<double> filled((size_t) c.n * c.p);
+      ssctpr::reference::genotypeMatrix(c.bed, c.N, c.P, sel, 1, filled.data());
+
+      std::vector<double> normalized(filled), sd(c.p);
+      ssctpr::reference::normalize(normalized.data(), c.n, c.p, sd.data());
+      normalized.insert(normalized.end(), sd.begin(), sd.end());
+
+      std::vector<double> scores((size_t) c.n * c.ncol);
+      ssctpr::reference::multiBed3sp(c.bed, c.N, c.P,
+                                     c.beta.empty() ? 0 : &c.beta[0],
+                                     &c.nonzeros[0], c.p,
+                                     c.colpos.empty() ? 0 : &c.colpos[0],
+                                     c.ncol, sel, 0, scores.data());
+
+      Problem pr = makeProblem(c, filled);
+      std::vector<double> solution(c.p, 0.0), yhat(c.n, 0.0);
+      std::vector<ssctpr::ElnetTelemetry> tel;
+      ssctpr::reference::repelnet(c.lambda, c.shrink, c.lambdact, &pr.diag[0],
+                                  &pr.X[0], c.n, c.p, &pr.r[0], c.traits,
+                                  &pr.adj[0], 1e-7, &solution[0], &yhat[0],
+                                  0, 1000, &c.startvec[0], &c.endvec[0],
+                                  c.startvec.size(), tel);
+      solution.insert(solution.end(), yhat.begin(), yhat.end());
+
+      for (size_t e = 0; e < selected.size(); e++) {
+        const Engine& engine = *selected[e];
+        ssctpr::setCompactPext(!engine.table);
+        for (int k = 0; k < nkernels; k++) {
+          const std::string& kernel = opt.kernels[k];
+          for (int t = 0; t < nthreads; t++) {
+            Summary& s = summary[(e * nkernels + k) * nthreads + t];
+            std::vector<double> out;
+            const std::vector<double>* ref;
+            if (kernel == "decode") {
+              if (!engine.decode) continue;
+              out = runDecode(engine, c, opt.threads[t]);
+              ref = &genotypes;
+              s.tolerance = decodetol;
+            } else if (kernel == "normalize") {
+              if (!engine.normalize) continue;
+              out = runNormalize(engine, c, filled, opt.threads[t]);
+              ref = &normalized;
+              s.tolerance = normalizetol;
+            } else if (kernel == "scoresp") {
+              if (!engine.scoresp) continue;
+              out = runScore(engine, c, opt.threads[t]);
+              ref = &scores;
+              s.tolerance = scoretol;
+            } else {
+              if (!engine.solve) continue;
+              out = runSolve(engine, c, pr, opt.threads[t]);
+              ref = &solution;
+              s.tolerance = engine.solvetol;
+            }
+            Diff d = compare(*ref, out);
+            s.cases++;
+            s.maxabs = std::max(s.maxabs, d.maxabs);
+            s.maxrel = std::max(s.maxrel, d.maxrel);
+            if (d.nanmismatch > 0 || d.maxrel > s.tolerance) {
+              if (s.failures == 0) {
+                std::ostringstream msg;
+                msg << c.describe() << " max.rel=" << d.maxrel
+                    << " nan.mismatch=" << d.nanmismatch;
+                s.first = msg.str();
+              }
+              s.failures++;
+            }
+          }
+        }
+      }
+      std::remove(c.bed.c_str());
+      std::remove(ssctpr::sampleMajorCacheName(c.bed).c_str());
+    }
+
+    int failures = 0;
+    std::cout << "engine,kernel,threads,cases,failures,max.abs,max.rel,tolerance\n";
+    for (size_t e = 0; e < selected.size(); e++) {
+      for (int k = 0; k < nkernels; k++) {
+        for (int t = 0; t < nthreads; t++) {
+          const Summary& s = summary[(e * nkernels + k) * nthreads + t];
+          if (s.cases == 0) continue;
+          std::cout << selected[e]->name << "," << opt.kernels[k] << ","
+                    << opt.threads[t] << "," << s.cases << "," << s.failures
+                    << "," << std::setprecision(3) << s.maxabs << ","
+                    << s.maxrel << "," << s.tolerance << "\n";
+          failures += s.failures;
+        }
+      }
+    }
+    for (size_t e = 0; e < selected.size(); e++) {
+      for (int k = 0; k < nkernels; k++) {
+        for (int t = 0; t < nthreads; t++) {
+          const Summary& s = summary[(e * nkernels + k) * nthreads + t];
+          if (s.failures > 0) {
+            std::cerr << "FAILED " << selected[e]->name << " " << opt.kernels[k]
+                      << " threads=" << opt.threads[t] << ", first " << s.first
+                      << "\n";
+          }
+        }
+      }
+    }
+    return failures > 0 ? 1 : 0;
+  } catch (std::exception& ex) {
+    std::cerr << "ssctpr_difftest: " << ex.what() << "\n";
+    return 2;
+  }
+}
@@ -0,0 +1,23 @@
+# Fixture of the ssctpr_run tests, sourced after B=BUILD_DIR is set: a
+# temporary directory D removed on exit, and the helpers below.
+
+D=$(mktemp -d)
+trap 'rm -rf "$D"' EXIT
+
+# simulate SEED [LAMBDA]: simulates a two-trait cohort into $D/cohort and
+# sets ARGS to solve it on a grid of 2 shrinks, LAMBDA (0.001,0.01) and 2
+# cross-trait penalties.
+simulate() {
+  "$B/ssctpr_simulate" --out "$D/cohort" --n 401 --p 2000 --traits 2 --seed "$1" 2>/dev/null
+  ARGS="--ref $D/cohort --sumstats $D/cohort.sumstats --secondary BETA.Y2
+    --adj $D/cohort.adj --blocks $D/cohort.blocks.bed
+    --shrink 0.5,0.9 --lambda ${2:-0.001,0.01} --lambda-ct 0,0.1"
+}
+
+# compare_weights A B TOL: every weight of the weights file B must be within
+# TOL of the weight of A at the same variant and column (0 if A has none).
+compare_weights() {
+  awk -v tol="$3" 'NR == FNR { if (FNR > 1) w[$1 " " $4 " " $5 " " $6] = $7; next }
+    FNR > 1 { d = $7 - w[$1 " " $4 " " $5 " " $6]; if (d < 0) d = -d
+      if (d > tol) { print "beta differs at " FNR ": " $0; exit 1 } }' "$1" "$2"
+}
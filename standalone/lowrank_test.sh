@@ -0,0 +1,21 @@
+#!/bin/sh
+# Checks ssctpr_run --ld lowrank: a rank at least the size of the blocks must
+# give the weights of the full panel, and an automatic rank must explain the
+# requested fraction of the variance and report an LD error in (0, 1).
+# Usage: lowrank_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 5
+"$B/ssctpr_run" $ARGS --out "$D/full" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/all" --ld lowrank --ld-rank 100000 2>/dev/null
+# same non-zero weights, up to rounding
+compare_weights "$D/full.weights" "$D/all.weights" 1e-8
+test "$(wc -l < "$D/full.weights")" -eq "$(wc -l < "$D/all.weights")"
+"$B/ssctpr_run" $ARGS --out "$D/auto" --ld lowrank --ld-variance 0.8 2>/dev/null
+awk '$1 == "ld.error.mean" { e = $2 } $1 == "ld.variance.mean" { v = $2 }
+  $1 == "not.converged" { nc = $2 }
+  END { if (e <= 0 || e >= 1 || v < 0.8 || nc > 0) {
+    print "ld error " e ", variance " v ", " nc " not converged"; exit 1 } }' "$D/auto.log"
+echo "low-rank panels agree with the full panel"
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Compares ssctpr_run with ssctpr_run_mpi on 4 ranks: the weights must be
+# identical and the scores agree up to rounding.
+# Usage: mpi_test.sh BUILD_DIR MPIEXEC [MPIEXEC_PREFLAGS...]
+set -e
+B=$1
+shift
+D=$(mktemp -d)
+trap 'rm -rf "$D"' EXIT
+
+"$B/ssctpr_simulate" --out "$D/cohort" --n 301 --p 3000 --traits 2 --seed 3 2>/dev/null
+set -- "$@" "$B/ssctpr_run_mpi"
+ARGS="--ref $D/cohort --sumstats $D/cohort.sumstats --secondary BETA.Y2
+  --adj $D/cohort.adj --blocks $D/cohort.blocks.bed --test $D/cohort
+  --shrink 0.5,0.9,1 --lambda 0.001,0.01 --lambda-ct 0,0.1 --threads 2"
+"$B/ssctpr_run" $ARGS --out "$D/one" 2>/dev/null
+"$@" $ARGS --out "$D/mpi" 2>/dev/null
+
+cmp "$D/one.weights" "$D/mpi.weights"
+paste "$D/one.scores" "$D/mpi.scores" | awk '
+  NR == 1 { k = NF / 2; next }
+  { for (i = 3; i <= k; i++) { d = $i - $(i + k); if (d < 0) d = -d;
+      if (d > 1e-8) { print "score mismatch line " NR " column " i; bad = 1 } } }
+  END { if (NR < 302) { print "missing lines"; bad = 1 }; exit bad }'
+echo "weights and scores agree"
@@ -0,0 +1,102 @@
+/**
+ ssCTPR
+ plink.cpp
+ Purpose: PLINK text files (.bim, .fam, keep lists) and BED selections for
+ the standalone tools
+
+ @author Yingxi Yang
+
+ */
+
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <stdexcept>
+#include "plink.h"
+
+namespace ssctpr {
+
+std::string stripChr(const std::string& chr) {
+  if (chr.size() > 3 && (chr[0] == 'c' || chr[0] == 'C') &&
+      (chr[1] == 'h' || chr[1] == 'H') && (chr[2] == 'r' || chr[2] == 'R'))
+    return chr.substr(3);
+  return chr;
+}
+
+Bim readBim(const std::string& bfile) {
+  std::string fileName = bfile + ".bim";
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  Bim bim;
+  std::string chr, snp, cm, a1, a2;
+  long long pos;
+  while (in >> chr >> snp >> cm >> pos >> a1 >> a2) {
+    bim.chr.push_back(stripChr(chr));
+    bim.snp.push_back(snp);
+    bim.pos.push_back(pos);
+    bim.a1.push_back(a1);
+    bim.a2.push_back(a2);
+  }
+  if (!in.eof()) throw std::runtime_error("Cannot parse " + fileName);
+  return bim;
+}
+
+Fam readFam(const std::string& bfile) {
+  std::string fileName = bfile + ".fam";
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  Fam fam;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream s(line);
+    std::string fid, iid;
+    if (!(s >> fid >> iid)) continue;
+    fam.fid.push_back(fid);
+    fam.iid.push_back(iid);
+  }
+  return fam;
+}
+
+Keep readKeep(const std::string& fileName, const Fam& fam) {
+  Keep keep;
+  if (fileName.empty()) return keep;
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  std::map<std::string, int> ids;
+  std::string fid, iid, line;
+  while (std::getline(in, line)) {
+    std::istringstream s(line);
+    if (s >> fid >> iid) ids[fid + " " + iid] = 1;
+  }
+  for (int i = 0; i < fam.size(); i++) {
+    if (ids.count(fam.fid[i] + " " + fam.iid[i])) {
+      keep.keepbytes.push_back(i / 4);
+      keep.keepoffset.push_back(i % 4 * 2);
+      keep.index.push_back(i);
+    }
+  }
+  if (keep.index.empty())
+    throw std::runtime_error("No samples of " + fileName + " in the fam file");
+  return keep;
+}
+
+Selection::Selection(const std::vector<char>& mask, const Keep& keep) {
+  const int P = mask.size();
+  for (int i = 0; i < P; i++) {
+    if (mask[i]) continue;
+    if (i > 0 && !mask[i - 1]) {
+      col_skip.back()++;
+    } else {
+      col_skip_pos.push_back(i);
+      col_skip.push_back(1);
+    }
+  }
+  sel.nskip = col_skip_pos.size();
+  sel.col_skip_pos = sel.nskip ? &col_skip_pos[0] : 0;
+  sel.col_skip = sel.nskip ? &col_skip[0] : 0;
+  sel.nkeep = keep.keepbytes.size();
+  sel.keepbytes = sel.nkeep ? &keep.keepbytes[0] : 0;
+  sel.keepoffset = sel.nkeep ? &keep.keepoffset[0] : 0;
+}
+
+}
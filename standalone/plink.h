@@ -0,0 +1,68 @@
+/**
+ ssCTPR
+ plink.h
+ Purpose: PLINK text files (.bim, .fam, keep lists) and BED selections for
+ the standalone tools
+
+ @author Yingxi Yang
+
+ */
+#ifndef SSCTPR_PLINK_H
+#define SSCTPR_PLINK_H
+
+#include <string>
+#include <vector>
+#include "kernels.h"
+
+namespace ssctpr {
+
+/**
+ Removes a leading "chr" (any case) from a chromosome name
+
+ */
+std::string stripChr(const std::string& chr);
+
+struct Bim {
+  std::vector<std::string> chr, snp, a1, a2;
+  std::vector<long long> pos;
+  int size() const { return snp.size(); }
+};
+
+Bim readBim(const std::string& bfile);
+
+struct Fam {
+  std::vector<std::string> fid, iid;
+  int size() const { return fid.size(); }
+};
+
+Fam readFam(const std::string& bfile);
+
+/**
+ keepbytes/keepoffset of the samples of a fam file listed in a FID IID file
+
+ @index the kept samples, empty if all are kept
+
+ */
+struct Keep {
+  std::vector<int> keepbytes, keepoffset, index;
+};
+
+Keep readKeep(const std::string& fileName, const Fam& fam);
+
+/**
+ The selection of the variants with mask[i] != 0, as built in R by
+ selectregion(!extract)
+
+ */
+struct Selection {
+  std::vector<int> col_skip_pos, col_skip;
+  BedSelection sel;
+  Selection(const std::vector<char>& mask, const Keep& keep);
+private:
+  Selection(const Selection&);
+  Selection& operator=(const Selection&);
+};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+/**
+ ssCTPR
+ protocol.h
+ Purpose: the local socket protocol of the scoring daemon (serve.cpp) and
+ its client (client.cpp)
+
+ @author Yingxi Yang
+
+ Requests are text lines; a connection may send several:
+   INFO                      -> OK <n samples> <P variants>
+   SAMPLES                   -> OK <n>, then n lines "FID IID"
+   SCORE <ncol> <nweights>   followed by nweights lines "SNP A1 column beta"
+                             (column in 0..ncol-1)
+                             -> OK <n> <ncol> <weights matched> <batch size>,
+                                then n * ncol doubles (native byte order,
+                                column-major)
+   SHUTDOWN                  -> OK, and the daemon exits once the queued
+                                requests are answered; a SCORE read after
+                                that is answered with ERR
+ Errors are answered with a line "ERR <message>".
+
+ */
+#ifndef SSCTPR_PROTOCOL_H
+#define SSCTPR_PROTOCOL_H
+
+#include <string>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ssctpr {
+
+/**
+ Buffered reads of lines and raw bytes from a socket
+
+ */
+class SocketReader {
+public:
+  explicit SocketReader(int fd) : fd_(fd), pos_(0), end_(0) {}
+
+  // false at end of stream
+  bool readLine(std::string& line) {
+    line.clear();
+    for (;;) {
+      if (pos_ == end_ && !fill()) return !line.empty();
+      char c = buf_[pos_++];
+      if (c == '\n') return true;
+      line += c;
+    }
+  }
+
+  void readBytes(char* out, size_t len) {
+    while (len > 0) {
+      if (pos_ == end_ && !fill()) throw std::runtime_error("Connection closed");
+      size_t k = std::min(len, end_ - pos_);
+      std::memcpy(out, buf_ + pos_, k);
+      pos_ += k;
+      out += k;
+      len -= k;
+    }
+  }
+
+private:
+  bool fill() {
+    for (;;) {
+      ssize_t k = ::read(fd_, buf_, sizeof(buf_));
+      if (k < 0 && errno == EINTR) continue;
+      if (k < 0) throw std::runtime_error(std::string("read: ") + std::strerror(errno));
+      pos_ = 0;
+      end_ = k;
+      return k > 0;
+    }
+  }
+  int fd_;
+  char buf_[1 << 16];
+  size_t pos_, end_;
+};
+
+inline void writeAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t k = ::send(fd, data, len, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0) throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+    data += k;
+    len -= k;
+  }
+}
+
+inline void writeAll(int fd, const std::string& s) {
+  writeAll(fd, s.data(), s.size());
+}
+
+inline sockaddr_un socketAddress(const std::string& path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("Socket path too long: " + path);
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return addr;
+}
+
+inline int connectSocket(const std::string& path) {
+  sockaddr_un addr = socketAddress(path);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+  if (::connect(fd, (sockaddr*) &addr, sizeof(addr)) < 0) {
+    std::string msg = std::strerror(errno);
+    ::close(fd);
+    throw std::runtime_error("Cannot connect to " + path + ": " + msg);
+  }
+  return fd;
+}
+
+}
+
+#endif
@@ -0,0 +1,338 @@
+/**
+ ssCTPR
+ reference.cpp
+ Purpose: frozen reference kernels for the differential tests
+
+ @author Yingxi Yang
+
+ */
+
+#include <string>
+#include <bitset>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <vector>
+#include "reference.h"
+
+namespace ssctpr {
+namespace reference {
+
+namespace {
+
+void openBed(const std::string& fileName, std::ifstream& bedFile) {
+  bedFile.open(fileName.c_str(), std::ios::in | std::ios::binary);
+  char magic[3];
+  bedFile.read(magic, 3);
+  if (!bedFile || magic[0] != 0x6c || magic[1] != 0x1b || magic[2] != 0x01)
+    throw std::runtime_error("reference: " + fileName + " is not a snp-major bed file");
+}
+
+}
+
+int genotypeMatrix(const std::string& fileName, int N, int P,
+                   const BedSelection& sel, int fillmissing, double* genotypes) {
+  std::ifstream bedFile;
+  openBed(fileName, bedFile);
+
+  int i = 0;
+  int ii = 0;
+  const bool colskip = (sel.nskip > 0);
+  unsigned long long int Nbytes = ceil(N / 4.0);
+  const bool selectrow = (sel.nkeep > 0);
+  int n, p, nskip = 0;
+  if (selectrow)
+    n = sel.nkeep;
+  else
+    n = N;
+  for (int k = 0; k < sel.nskip; k++) nskip += sel.col_skip[k];
+  p = P - nskip;
+
+  int j, iii;
+  unsigned long long jj;
+
+  std::fill(genotypes, genotypes + (size_t) n * p, 0.0);
+  std::bitset<8> b;
+  std::vector<char> ch(Nbytes);
+
+  iii = 0;
+  while (i < P) {
+    if (colskip) {
+      if (ii < sel.nskip) {
+        if (i == sel.col_skip_pos[ii]) {
+          bedFile.seekg(sel.col_skip[ii] * Nbytes, bedFile.cur);
+          i = i + sel.col_skip[ii];
+          ii++;
+          continue;
+        }
+      }
+    }
+
+    bedFile.read(&ch[0], Nbytes);
+    if (!bedFile)
+      throw std::runtime_error(
+          "Problem with the BED file...has the FAM/BIM file been changed?");
+
+    j = 0;
+    if (!selectrow) {
+      for (jj = 0; jj < Nbytes; jj++) {
+        b = ch[jj];
+
+        int c = 0;
+        while (c < 7 && j < N) {
+          int first = b[c++];
+          int second = b[c++];
+          if (first == 0) {
+            genotypes[j + (size_t) iii * n] = (2 - second);
+          }
+          if (fillmissing == 0 && first == 1 && second == 0)
+            genotypes[j + (size_t) iii * n] = NAN;
+          j++;
+        }
+      }
+    } else {
+      for (int k = 0; k < sel.nkeep; k++) {
+        b = ch[sel.keepbytes[k]];
+
+        int c = sel.keepoffset[k];
+        int first = b[c++];
+        int second = b[c];
+        if (first == 0) {
+          genotypes[j + (size_t) iii * n] = (2 - second);
+        }
+        if (fillmissing == 0 && first == 1 && second == 0)
+          genotypes[j + (size_t) iii * n] = NAN;
+        j++;
+      }
+    }
+    i++;
+    iii++;
+  }
+  return iii;
+}
+
+int multiBed3sp(const std::string& fileName, int N, int P,
+                const double* beta, const int* nonzeros, int nvariants,
+                const int* colpos, int ncol,
+                const BedSelection& sel, int trace, double* result) {
+  std::ifstream bedFile;
+  openBed(fileName, bedFile);
+
+  int i = 0;
+  int ii = 0;
+  int iii = 0;
+  int k = 0;
+  const bool colskip = (sel.nskip > 0);
+  unsigned long long int Nbytes = ceil(N / 4.0);
+  const bool selectrow = (sel.nkeep > 0);
+  int n;
+  if (selectrow)
+    n = sel.nkeep;
+  else
+    n = N;
+  unsigned long long jj;
+
+  std::fill(result, result + (size_t) n * ncol, 0.0);
+  std::bitset<8> b;
+  std::vector<char> ch(Nbytes);
+
+  while (i < P) {
+    if (colskip) {
+      if (ii < sel.nskip) {
+        if (i == sel.col_skip_pos[ii]) {
+          bedFile.seekg(sel.col_skip[ii] * Nbytes, bedFile.cur);
+          i = i + sel.col_skip[ii];
+          ii++;
+          continue;
+        }
+      }
+    }
+
+    bedFile.read(&ch[0], Nbytes);
+    if (!bedFile)
+      throw std::runtime_error(
+          "Problem with the BED file...has the FAM/BIM file been changed?");
+
+    int j = 0;
+    if (!selectrow) {
+      for (jj = 0; jj < Nbytes; jj++) {
+        b = ch[jj];
+
+        int c = 0;
+        while (c < 7 && j < N) {
+          int first = b[c++];
+          int second = b[c++];
+          if (nonzeros[iii] > 0) {
+            if (first == 0) {
+              for (int kk = 0; kk < nonzeros[iii]; kk++) {
+                result[j + (size_t) colpos[k] * n] += (2 - second) * beta[k];
+                k++;
+              }
+              k -= nonzeros[iii];
+            }
+          }
+          j++;
+        }
+      }
+    } else {
+      for (int m = 0; m < sel.nkeep; m++) {
+        b = ch[sel.keepbytes[m]];
+
+        int c = sel.keepoffset[m];
+        int first = b[c++];
+        int second = b[c];
+        if (nonzeros[iii] > 0) {
+          if (first == 0) {
+            for (int kk = 0; kk < nonzeros[iii]; kk++) {
+              result[j + (size_t) colpos[k] * n] += (2 - second) * beta[k];
+              k++;
+            }
+            k -= nonzeros[iii];
+          }
+        }
+        j++;
+      }
+    }
+
+    k += nonzeros[iii];
+    i++;
+    iii++;
+  }
+  return iii;
+}
+
+void normalize(double* genotypes, int n, int k, double* sd) {
+  for (int i = 0; i < k; ++i) {
+    double* col = genotypes + (size_t) i * n;
+    double m = 0.0;
+    for (int j = 0; j < n; j++) m += col[j];
+    m /= n;
+    double ss = 0.0;
+    for (int j = 0; j < n; j++) {
+      col[j] -= m;
+      ss += col[j] * col[j];
+    }
+    sd[i] = (n > 1) ? sqrt(ss / (n - 1)) : 0.0;
+    double norm = sqrt(ss);
+    if (norm != 0.0) {
+      for (int j = 0; j < n; j++) col[j] /= norm;
+    }
+  }
+}
+
+int elnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel)
+{
+  double dlx_cur, dlx_pre, del, t, xj, ctp;
+  int j, i;
+
+  std::vector<double> denom(p);
+  for (j = 0; j < p; j++) denom[j] = diag[j] + lambda2 + lambda_ct * adj[j];
+
+  int conv = 0;
+  int count = 0;
+  long long updates = 0;
+  dlx_pre = 0.0;
+  dlx_cur = 0.0;
+  tel.stop = 0;
+  for (int k = 0; k < maxiter; k++) {
+    tel.sweeps = k + 1;
+    dlx_cur = 0.0;
+    for (j = 0; j < p; j++) {
+      const double* Xj = X + (size_t) j * n;
+      xj = x[j];
+      x[j] = 0.0;
+      double dot = 0.0;
+      for (i = 0; i < n; i++) dot += Xj[i] * yhat[i];
+      t = diag[j] * xj + r[j] - dot;
+
+      if (traits > 1) {
+        ctp = r[j + ldr];
+        ctp *= lambda_ct;
+      } else {
+        ctp = 0.0;
+      }
+
+      if (std::abs(t + ctp) - lambda1 > 0.0) {
+        if (t + ctp - lambda1 > 0.0) {
+          x[j] = t - lambda1 + ctp / denom[j];
+        } else {
+          x[j] = t + lambda1 + ctp / denom[j];
+        }
+      }
+
+      if (x[j] == xj) continue;
+      del = x[j] - xj;
+      updates++;
+
+      for (i = 0; i < n; i++) yhat[i] += del * Xj[i];
+      dlx_cur = std::max(dlx_cur, std::abs(del));
+    }
+    if (std::abs(dlx_cur - dlx_pre) < 1e-6) {
+      count++;
+    } else {
+      count = 0;
+    }
+    dlx_pre = dlx_cur;
+
+    if (dlx_cur < thr) {
+      conv = 1;
+      tel.stop = 1;
+      break;
+    }
+    if (count >= 50) {
+      conv = 1;
+      tel.stop = 2;
+      break;
+    }
+  }
+
+  tel.updates = updates;
+  tel.maxdelta = dlx_cur;
+  tel.active = 0;
+  for (j = 0; j < p; j++) {
+    if (x[j] != 0.0) tel.active++;
+  }
+  return conv;
+}
+
+int repelnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+             const double* X, int n, int p, const double* r, int traits,
+             const double* adj, double thr, double* x, double* yhat,
+             int trace, int maxiter,
+             const int* startvec, const int* endvec, int nblocks,
+             std::vector<ElnetTelemetry>& tel)
+{
+  int out = 1;
+  std::vector<double> yhattouse(n);
+
+  for (int i = 0; i < nblocks; i++) {
+    const int s = startvec[i];
+    const int len = endvec[i] - s + 1;
+    const double* Xb = X + (size_t) s * n;
+
+    std::fill(yhattouse.begin(), yhattouse.end(), 0.0);
+    for (int j = 0; j < len; j++) {
+      const double xj = x[s + j];
+      if (xj == 0.0) continue;
+      const double* Xj = Xb + (size_t) j * n;
+      for (int k = 0; k < n; k++) yhattouse[k] += xj * Xj[k];
+    }
+
+    ElnetTelemetry blocktel;
+    int out2 = reference::elnet(lambda1, lambda2, lambda_ct, diag + s, Xb, n, len,
+                                r + s, traits, p, adj + s, thr, x + s, &yhattouse[0],
+                                trace - 1, maxiter, blocktel);
+    tel.push_back(blocktel);
+
+    for (int k = 0; k < n; k++) yhat[k] += yhattouse[k];
+    out = std::min(out, out2);
+  }
+  return out;
+}
+
+}
+}
@@ -0,0 +1,49 @@
+/**
+ ssCTPR
+ reference.h
+ Purpose: frozen reference kernels for the differential tests (difftest.cpp)
+
+ @author Yingxi Yang
+
+ These are copies of genotypeMatrix, multiBed3sp, normalize, elnet and
+ repelnet as they were before any performance work (plain decode loop,
+ one coordinate at a time). Do not optimize them: faster engines in
+ src/kernels.cpp are tested against these.
+
+ */
+#ifndef SSCTPR_REFERENCE_H
+#define SSCTPR_REFERENCE_H
+
+#include <string>
+#include <vector>
+#include "kernels.h"
+
+namespace ssctpr {
+namespace reference {
+
+int genotypeMatrix(const std::string& fileName, int N, int P,
+                   const BedSelection& sel, int fillmissing, double* genotypes);
+
+int multiBed3sp(const std::string& fileName, int N, int P,
+                const double* beta, const int* nonzeros, int nvariants,
+                const int* colpos, int ncol,
+                const BedSelection& sel, int trace, double* result);
+
+void normalize(double* genotypes, int n, int k, double* sd);
+
+int elnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+          const double* X, int n, int p, const double* r, int traits, int ldr,
+          const double* adj, double thr, double* x, double* yhat,
+          int trace, int maxiter, ElnetTelemetry& tel);
+
+int repelnet(double lambda1, double lambda2, double lambda_ct, const double* diag,
+             const double* X, int n, int p, const double* r, int traits,
+             const double* adj, double thr, double* x, double* yhat,
+             int trace, int maxiter,
+             const int* startvec, const int* endvec, int nblocks,
+             std::vector<ElnetTelemetry>& tel);
+
+}
+}
+
+#endif
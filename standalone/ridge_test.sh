@@ -0,0 +1,17 @@
+#!/bin/sh
+# Checks ssctpr_run --ridge 1: blocks must start from their ridge solution
+# (always at lambda = 0), and the weights must agree with the warm started
+# path up to the accuracy of --thr.
+# Usage: ridge_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 5 0,0.001,0.01
+"$B/ssctpr_run" $ARGS --out "$D/warm" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/ridge" --ridge 1 2>/dev/null
+awk -v blocks="$(awk '$1 == "blocks" { print $2 }' "$D/ridge.log")" '
+  $1 == "blocks.ridge.start" { r = $2 }
+  END { if (r < 4 * blocks) { print r " ridge starts for " blocks " blocks"; exit 1 } }' "$D/ridge.log"
+compare_weights "$D/warm.weights" "$D/ridge.weights" 2e-3
+echo "ridge starts agree with warm starts"
@@ -0,0 +1,1209 @@
+/**
+ ssCTPR
+ run.cpp
+ Purpose: command line runner of ssCTPR without R: reads a reference panel,
+ harmonized summary statistics and LD blocks, writes sparse weights and
+ (optionally) polygenic scores of a test bfile
+
+ @author Yingxi Yang
+
+ Usage: ssctpr_run --ref REF --sumstats FILE --out PREFIX [--test TEST]
+                   [--blocks FILE] [--cor COR.Y1] [--secondary BETA.Y2,...]
+                   [--adj FILE] [--shrink 0.2,0.5,0.9] [--lambda LIST]
+                   [--lambda-ct LIST] [--threads 1] ...
+
+ This follows ssCTPR.pipeline with destandardize=FALSE:
+ - summary statistics are matched to the reference bim by SNP id, and the
+   signs flipped where A1/A2 are swapped (the file is assumed harmonized,
+   other variants are dropped)
+ - variants are split by LD blocks (a bed file as in LDblocks=, or one
+   block per chromosome) and blocks are grouped into chunks, each decoded,
+   standardized and solved on one thread (as the R cluster does)
+ - s = 1 is the independent (soft-thresholding) solution of indepssCTPR
+ - with --sketch K, each block is solved on a K x p_b random projection of
+   the standardized panel (ssCTPR(sketch=K)); the estimated LD errors are
+   logged
+ - with --ld sparse, each block is solved against its correlations with
+   r2 >= --ld-r2 or within --ld-window base pairs (ssCTPR(ld="sparse"))
+ - --solver cd|fista|auto|tuned chooses the block solver (ssCTPR(solver=));
+   tuned solves the blocks of at least --fista-variants variants with FISTA
+   (the fista.variants of a tuning profile of ssCTPR.autotune)
+ - with --ridge 1, the blocks of a chunk are eigendecomposed once for all s
+   and lambda_ct, and start from their closed form ridge solution where it
+   beats the warm start (ssCTPR(ridge=TRUE))
+ - with --subsample K, the blocks without a warm start are first solved on
+   K random reference samples, and start from that solution where it has a
+   lower objective (ssCTPR(subsample=K)); the sweeps of both stages are
+   logged
+ - with --carriers F, the variants with at most a fraction F of the samples
+   away from their most common genotype are solved on carrier lists
+   (ssCTPR(carriers=F))
+ - with --ld lowrank, each block is solved on a truncated randomized SVD of
+   the standardized panel plus a diagonal (ssCTPR(ld="lowrank")), of rank
+   --ld-rank or explaining the fraction --ld-variance of its variance
+ - scores are computed on the variants of the weights found in the test bim
+ - with --format binary, the weights and scores are written as the binary
+   files of ssCTPR.pipeline(out=): compressed sparse columns of the weights
+   and column-major scores with their sample index, read in R with
+   read.weights and read.scores
+
+ Built as ssctpr_run_mpi (with SSCTPR_MPI), each MPI rank owns a contiguous
+ range of chunks (whole LD blocks, in the order of the reference bim): it
+ solves them with --threads threads and scores the test bfile on their
+ weights; the weights are gathered and the scores summed on rank 0, which
+ writes the outputs. --mem-limit is per rank.
+   mpirun -np 4 ssctpr_run_mpi --ref REF --sumstats FILE --out PREFIX ...
+
+ Outputs:
+   PREFIX.weights   SNP A1 A2 s lambda_ct lambda beta, one line per non-zero
+                    weight, by variant in the order of the reference bim;
+                    beta is for A1 of the reference bim
+   PREFIX.scores    FID IID and one column per (s, lambda_ct, lambda)
+   PREFIX.log       the settings and timings
+ With --format binary:
+   PREFIX.weights   weights (writeWeights), one row per variant of
+                    PREFIX.variants and one column per line of PREFIX.columns
+   PREFIX.variants  SNP A1 A2 of the rows of the weights
+   PREFIX.columns   s lambda_ct lambda of the columns of the weights and scores
+   PREFIX.scores    scores (writeScores) of the kept rows of the test .fam
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <stdexcept>
+#include <limits>
+#include "kernels.h"
+#include "plink.h"
+#ifdef SSCTPR_MPI
+#include <mpi.h>
+#endif
+
+namespace {
+
+using ssctpr::Bim;
+using ssctpr::Fam;
+using ssctpr::Keep;
+using ssctpr::Selection;
+using ssctpr::readBim;
+using ssctpr::readFam;
+using ssctpr::readKeep;
+using ssctpr::stripChr;
+
+struct Options {
+  std::string ref, test, sumstats, adj, blocks, keepref, keeptest, out;
+  std::string cor;
+  std::vector<std::string> secondary;
+  std::vector<double> lambda, shrink, lambdact;
+  std::string sketchmethod, ld, solver, format;
+  double thr, memlimit, ldr2, ldwindow, ldvariance, carriers;
+  int maxiter, threads, trace, sketch, ldrank, ridge, subsample, fistavariants;
+  unsigned long long seed;
+  Options() : cor("COR.Y1"), sketchmethod("srht"), ld("panel"), solver("cd"),
+    format("text"),
+    thr(1e-4),
+    memlimit(4e9), ldr2(0.01), ldwindow(0.0), ldvariance(0.9), carriers(0.0), maxiter(3000), threads(1), trace(0), sketch(0), ldrank(0), ridge(0), subsample(0), fistavariants(0), seed(1) {
+    // defaults of ssCTPR.pipeline
+    for (int i = 0; i < 20; i++)
+      lambda.push_back(exp(log(0.001) + i * (log(0.1) - log(0.001)) / 19));
+    const double s[] = {0.2, 0.5, 0.9};
+    shrink.assign(s, s + 3);
+    const double ct[] = {0, 0.06109, 0.13920, 0.24257};
+    lambdact.assign(ct, ct + 4);
+  }
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_run --ref REF --sumstats FILE --out PREFIX [options]\n"
+    "  --ref BFILE        reference panel (without .bed)\n"
+    "  --sumstats FILE    harmonized summary statistics with columns SNP, A1, A2\n"
+    "                     and the correlations of the primary trait\n"
+    "  --out PREFIX       output prefix\n"
+    "  --test BFILE       test data to compute polygenic scores for\n"
+    "  --cor COLUMN       correlations with the primary trait (COR.Y1)\n"
+    "  --secondary LIST   columns of the secondary trait effects (none)\n"
+    "  --adj FILE         SNP and one adjacency column per secondary trait (1)\n"
+    "  --blocks FILE      LD blocks (chr start end); default: chromosomes\n"
+    "  --keep-ref FILE    FID IID of the reference samples to keep\n"
+    "  --keep-test FILE   FID IID of the test samples to keep\n"
+    "  --lambda LIST      lambdas (20 values from 0.001 to 0.1)\n"
+    "  --shrink LIST      values of s in (0, 1] (0.2,0.5,0.9)\n"
+    "  --lambda-ct LIST   cross trait penalties (0,0.06109,0.13920,0.24257)\n"
+    "  --thr T            convergence threshold (1e-4)\n"
+    "  --maxiter M        maximal number of iterations (3000)\n"
+    "  --threads T        threads (1)\n"
+    "  --solver S         block solver: cd, fista, auto or tuned (cd)\n"
+    "  --fista-variants W narrowest block solved with FISTA by tuned (0: none)\n"
+    "  --ridge 0|1        start blocks from their ridge solution (0)\n"
+    "  --subsample K      reference samples of a coarse first solve (0: none)\n"
+    "  --carriers F       largest carrier fraction of carrier lists (0: none)\n"
+    "  --mem-limit B      bytes of genotypes decoded at a time (4e9)\n"
+    "  --sketch K         sketch size of the reference panel per block (0: none)\n"
+    "  --sketch-method M  srht or sparse (srht)\n"
+    "  --seed S           seed of the sketches (1)\n"
+    "  --ld L             panel, sparse or lowrank (panel)\n"
+    "  --ld-r2 R          r2 threshold of --ld sparse (0.01)\n"
+    "  --ld-window W      base pairs within which --ld sparse keeps all pairs (0)\n"
+    "  --ld-rank K        rank of --ld lowrank per block (0: from --ld-variance)\n"
+    "  --ld-variance F    fraction of the variance the rank explains (0.9)\n"
+    "  --format F         text or binary outputs (text)\n"
+    "  --trace T          amount of output (0)\n";
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+  std::vector<std::string> out;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) out.push_back(item);
+  return out;
+}
+
+std::vector<double> parseDoubles(const std::string& s) {
+  std::vector<double> out;
+  std::vector<std::string> items = splitList(s);
+  for (size_t i = 0; i < items.size(); i++) {
+    std::stringstream ss(items[i]);
+    double v;
+    if (!(ss >> v)) throw std::runtime_error("Cannot parse '" + items[i] + "'");
+    out.push_back(v);
+  }
+  return out;
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    std::string v = argv[++i];
+    if (a == "--ref") opt.ref = v;
+    else if (a == "--test") opt.test = v;
+    else if (a == "--sumstats") opt.sumstats = v;
+    else if (a == "--adj") opt.adj = v;
+    else if (a == "--blocks") opt.blocks = v;
+    else if (a == "--keep-ref") opt.keepref = v;
+    else if (a == "--keep-test") opt.keeptest = v;
+    else if (a == "--out") opt.out = v;
+    else if (a == "--cor") opt.cor = v;
+    else if (a == "--secondary") opt.secondary = splitList(v);
+    else if (a == "--lambda") opt.lambda = parseDoubles(v);
+    else if (a == "--shrink") opt.shrink = parseDoubles(v);
+    else if (a == "--lambda-ct") opt.lambdact = parseDoubles(v);
+    else if (a == "--thr") opt.thr = std::atof(v.c_str());
+    else if (a == "--maxiter") opt.maxiter = std::atoi(v.c_str());
+    else if (a == "--threads") opt.threads = std::atoi(v.c_str());
+    else if (a == "--mem-limit") opt.memlimit = std::atof(v.c_str());
+    else if (a == "--trace") opt.trace = std::atoi(v.c_str());
+    else if (a == "--sketch") opt.sketch = std::atoi(v.c_str());
+    else if (a == "--sketch-method") opt.sketchmethod = v;
+    else if (a == "--seed") opt.seed = std::strtoull(v.c_str(), 0, 10);
+    else if (a == "--ld") opt.ld = v;
+    else if (a == "--solver") opt.solver = v;
+    else if (a == "--fista-variants") opt.fistavariants = std::atoi(v.c_str());
+    else if (a == "--ridge") opt.ridge = std::atoi(v.c_str());
+    else if (a == "--subsample") opt.subsample = std::atoi(v.c_str());
+    else if (a == "--carriers") opt.carriers = std::atof(v.c_str());
+    else if (a == "--ld-r2") opt.ldr2 = std::atof(v.c_str());
+    else if (a == "--ld-window") opt.ldwindow = std::atof(v.c_str());
+    else if (a == "--ld-rank") opt.ldrank = std::atoi(v.c_str());
+    else if (a == "--ld-variance") opt.ldvariance = std::atof(v.c_str());
+    else if (a == "--format") opt.format = v;
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  if (opt.ref.empty() || opt.sumstats.empty() || opt.out.empty())
+    throw std::runtime_error("--ref, --sumstats and --out must be specified");
+  if (opt.threads < 1) throw std::runtime_error("--threads must be positive");
+  if (opt.sketch < 0) throw std::runtime_error("--sketch must not be negative");
+  if (opt.sketchmethod != "srht" && opt.sketchmethod != "sparse")
+    throw std::runtime_error("--sketch-method should be srht or sparse");
+  if (opt.solver != "cd" && opt.solver != "fista" && opt.solver != "auto" &&
+      opt.solver != "tuned")
+    throw std::runtime_error("--solver should be cd, fista, auto or tuned");
+  if (opt.fistavariants < 0)
+    throw std::runtime_error("--fista-variants must not be negative");
+  if (opt.ld != "panel" && opt.ld != "sparse" && opt.ld != "lowrank")
+    throw std::runtime_error("--ld should be panel, sparse or lowrank");
+  if (opt.ld != "panel" && opt.sketch > 0)
+    throw std::runtime_error("--sketch cannot be combined with --ld " + opt.ld);
+  if (opt.ridge && (opt.ld != "panel" || opt.sketch > 0))
+    throw std::runtime_error("--ridge needs --ld panel without --sketch");
+  if (opt.subsample < 0)
+    throw std::runtime_error("--subsample must not be negative");
+  if (opt.subsample > 0 && (opt.ld != "panel" || opt.sketch > 0))
+    throw std::runtime_error("--subsample needs --ld panel without --sketch");
+  if (!(opt.carriers >= 0 && opt.carriers < 1))
+    throw std::runtime_error("--carriers should be in [0, 1)");
+  if (opt.carriers > 0 && (opt.ld != "panel" || opt.sketch > 0))
+    throw std::runtime_error("--carriers needs --ld panel without --sketch");
+  if (opt.ldrank < 0) throw std::runtime_error("--ld-rank must not be negative");
+  if (!(opt.ldvariance > 0 && opt.ldvariance <= 1))
+    throw std::runtime_error("--ld-variance should be in (0, 1]");
+  if (opt.ldr2 < 0 || opt.ldwindow < 0)
+    throw std::runtime_error("--ld-r2 and --ld-window must not be negative");
+  if (opt.format != "text" && opt.format != "binary")
+    throw std::runtime_error("--format should be text or binary");
+  if (opt.lambda.empty()) throw std::runtime_error("--lambda is empty");
+  if (opt.shrink.empty()) throw std::runtime_error("--shrink is empty");
+  for (size_t i = 0; i < opt.shrink.size(); i++) {
+    if (!(opt.shrink[i] > 0 && opt.shrink[i] <= 1))
+      throw std::runtime_error("--shrink values should be in (0, 1]");
+  }
+  std::sort(opt.shrink.begin(), opt.shrink.end());
+  opt.shrink.erase(std::unique(opt.shrink.begin(), opt.shrink.end()), opt.shrink.end());
+  // With one trait, lambda_ct has no effect (adj = 0 and no secondary r)
+  if (opt.secondary.empty()) opt.lambdact.assign(1, 0.0);
+  if (opt.lambdact.empty()) throw std::runtime_error("--lambda-ct is empty");
+  return opt;
+}
+
+double now() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ A whitespace delimited text file with a header
+
+ */
+struct Table {
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string> > columns;
+  const std::vector<std::string>& column(const std::string& name,
+                                         const std::string& file) const {
+    for (size_t i = 0; i < names.size(); i++)
+      if (names[i] == name) return columns[i];
+    throw std::runtime_error("Column " + name + " not found in " + file);
+  }
+};
+
+Table readTable(const std::string& fileName) {
+  std::ifstream in(fileName.c_str());
+  if (!in) throw std::runtime_error("Cannot open " + fileName);
+  Table t;
+  std::string line, field;
+  if (!std::getline(in, line)) throw std::runtime_error(fileName + " is empty");
+  std::istringstream header(line);
+  while (header >> field) t.names.push_back(field);
+  t.columns.resize(t.names.size());
+  while (std::getline(in, line)) {
+    std::istringstream s(line);
+    size_t k = 0;
+    while (k < t.names.size() && s >> field) t.columns[k++].push_back(field);
+    if (k == 0) continue;
+    if (k != t.names.size())
+      throw std::runtime_error("Wrong number of fields in " + fileName);
+  }
+  return t;
+}
+
+double toDouble(const std::string& s, const std::string& file) {
+  char* end;
+  double v = std::strtod(s.c_str(), &end);
+  if (end == s.c_str() || *end != '\0')
+    throw std::runtime_error("Cannot parse '" + s + "' in " + file);
+  return v;
+}
+
+/**
+ Summary statistics matched to the reference panel
+
+ @variant the index in the reference bim of each matched variant
+ @r p x traits: the correlations and (traits = 2) the combined secondary
+    effects, sum_k adj_k * beta_k, as in ssCTPR
+ @adj p combined adjacency coefficients, sum_k adj_k
+
+ */
+struct Matched {
+  std::vector<int> variant;
+  std::vector<double> r, adj;
+  int traits;
+  int size() const { return variant.size(); }
+};
+
+Matched matchSumstats(const Options& opt, const Bim& bim) {
+  Table ss = readTable(opt.sumstats);
+  const std::vector<std::string>& snp = ss.column("SNP", opt.sumstats);
+  const std::vector<std::string>& a1 = ss.column("A1", opt.sumstats);
+  const std::vector<std::string>& a2 = ss.column("A2", opt.sumstats);
+  const std::vector<std::string>& cor = ss.column(opt.cor, opt.sumstats);
+  const int nsec = opt.secondary.size();
+  std::vector<const std::vector<std::string>*> sec(nsec);
+  for (int k = 0; k < nsec; k++) sec[k] = &ss.column(opt.secondary[k], opt.sumstats);
+
+  std::map<std::string, int> adjrow;
+  Table adj;
+  std::vector<const std::vector<std::string>*> adjcol;
+  if (!opt.adj.empty()) {
+    adj = readTable(opt.adj);
+    if ((int) adj.names.size() != nsec + 1)
+      throw std::runtime_error(opt.adj + " should have a SNP column and one column per secondary trait");
+    for (size_t i = 0; i < adj.columns[0].size(); i++) adjrow[adj.columns[0][i]] = i;
+    for (int k = 0; k < nsec; k++) adjcol.push_back(&adj.columns[k + 1]);
+  }
+
+  std::map<std::string, int> row;
+  for (size_t i = 0; i < snp.size(); i++) row.insert(std::make_pair(snp[i], (int) i));
+
+  Matched m;
+  m.traits = (nsec > 0) ? 2 : 1;
+  std::vector<double> r1, r2;
+  std::map<std::string, int> seen;
+  for (int j = 0; j < bim.size(); j++) {
+    std::map<std::string, int>::const_iterator it = row.find(bim.snp[j]);
+    if (it == row.end()) continue;
+    if (!seen.insert(std::make_pair(bim.snp[j], j)).second) continue; // duplicated
+    const int i = it->second;
+    double sign;
+    if (a1[i] == bim.a1[j] && a2[i] == bim.a2[j]) sign = 1.0;
+    else if (a1[i] == bim.a2[j] && a2[i] == bim.a1[j]) sign = -1.0;
+    else continue;
+    double c = toDouble(cor[i], opt.sumstats);
+    if (!(c > -1 && c < 1))
+      throw std::runtime_error("Correlations should be in (-1, 1): " + snp[i]);
+    int arow = -1;
+    if (!opt.adj.empty()) {
+      std::map<std::string, int>::const_iterator ai = adjrow.find(bim.snp[j]);
+      if (ai == adjrow.end()) continue;
+      arow = ai->second;
+    }
+    double adjr = 0.0, adjsum = 0.0;
+    for (int k = 0; k < nsec; k++) {
+      const double a = (arow < 0) ? 1.0 : toDouble((*adjcol[k])[arow], opt.adj);
+      adjr += a * sign * toDouble((*sec[k])[i], opt.sumstats);
+      adjsum += a;
+    }
+    m.variant.push_back(j);
+    r1.push_back(sign * c);
+    r2.push_back(adjr);
+    m.adj.push_back(adjsum);
+  }
+  m.r = r1;
+  if (m.traits > 1) m.r.insert(m.r.end(), r2.begin(), r2.end());
+  return m;
+}
+
+/**
+ LD blocks of the matched variants (parseblocks/splitgenome), as start and
+ end positions within the matched variants
+
+ */
+void makeBlocks(const Options& opt, const Bim& bim, const Matched& m,
+                std::vector<int>& startvec, std::vector<int>& endvec) {
+  std::map<std::string, std::vector<long long> > breaks;
+  if (!opt.blocks.empty()) {
+    std::ifstream in(opt.blocks.c_str());
+    if (!in) throw std::runtime_error("Cannot open " + opt.blocks);
+    std::string line, chr, start, end;
+    while (std::getline(in, line)) {
+      std::istringstream s(line);
+      if (!(s >> chr >> start >> end)) continue;
+      char* e;
+      long long stop = std::strtoll(end.c_str(), &e, 10);
+      if (*e != '\0') continue; // header
+      breaks[stripChr(chr)].push_back(stop);
+    }
+    for (std::map<std::string, std::vector<long long> >::iterator it = breaks.begin();
+         it != breaks.end(); ++it) {
+      std::sort(it->second.begin(), it->second.end());
+    }
+  }
+
+  std::map<std::string, int> done;
+  std::string lastchr;
+  long long lastkey = -1;
+  for (int j = 0; j < m.size(); j++) {
+    const int v = m.variant[j];
+    const std::string& chr = bim.chr[v];
+    long long key = 0;
+    if (!opt.blocks.empty()) {
+      std::map<std::string, std::vector<long long> >::const_iterator it = breaks.find(chr);
+      if (it == breaks.end())
+        throw std::runtime_error("Chromosome " + chr + " is not defined in " + opt.blocks);
+      // intervals (b[k-1], b[k]] as cut(..., right=TRUE)
+      key = std::lower_bound(it->second.begin(), it->second.end(), bim.pos[v]) -
+        it->second.begin();
+    }
+    if (j == 0 || chr != lastchr || key != lastkey) {
+      if (j > 0 && chr != lastchr) {
+        if (done.count(chr))
+          throw std::runtime_error("The reference bim should be sorted by chromosome");
+        done[lastchr] = 1;
+      }
+      if (j > 0 && chr == lastchr && key < lastkey)
+        throw std::runtime_error("The reference bim should be sorted by position");
+      if (j > 0) endvec.push_back(j - 1);
+      startvec.push_back(j);
+    }
+    lastchr = chr;
+    lastkey = key;
+  }
+  if (m.size() > 0) endvec.push_back(m.size() - 1);
+}
+
+/**
+ A non-zero weight: variant (index in the matched variants), column and beta
+
+ */
+struct Weight {
+  int variant, column;
+  double beta;
+  bool operator<(const Weight& w) const {
+    return variant < w.variant || (variant == w.variant && column < w.column);
+  }
+};
+
+/**
+ Columns of the weights: s, lambda_ct, lambda
+
+ */
+struct Column {
+  double s, lambdact, lambda;
+  std::string name() const {
+    std::ostringstream n;
+    n << "s" << s << "_ct" << lambdact << "_lambda" << lambda;
+    return n.str();
+  }
+};
+
+struct SolveStats {
+  long long notconverged, paths, sketched, ldnnz, ldshrunk, ldrank, ridge;
+  long long sweeps, coarse, coarsesweeps, carriers;
+  double decode, solve, lderror, ldvariance, coarsetime, ldsmallest;
+  SolveStats() : notconverged(0), paths(0), sketched(0), ldnnz(0),
+    ldshrunk(0), ldrank(0), ridge(0), sweeps(0), coarse(0), coarsesweeps(0), carriers(0),
+    decode(0.0), solve(0.0), lderror(0.0), ldvariance(0.0), coarsetime(0.0),
+    ldsmallest(std::numeric_limits<double>::infinity()) {}
+};
+
+/**
+ The processes of the run: MPI ranks with SSCTPR_MPI, else a single one.
+ Results are combined on rank 0.
+
+ */
+class Comm {
+public:
+  Comm(int* argc, char*** argv) : rank(0), size(1) {
+#ifdef SSCTPR_MPI
+    MPI_Init(argc, argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+#endif
+  }
+  ~Comm() {
+#ifdef SSCTPR_MPI
+    MPI_Finalize();
+#endif
+  }
+
+  // an error on one rank would leave the others waiting in a collective
+  void abort(int status) {
+#ifdef SSCTPR_MPI
+    if (size > 1) MPI_Abort(MPI_COMM_WORLD, status);
+#endif
+    (void) status;
+  }
+
+  // sums x over the ranks into x of rank 0
+  void sum(double* x, size_t len) {
+#ifdef SSCTPR_MPI
+    for (size_t i = 0; i < len; i += maxcount) {
+      const int k = std::min(len - i, (size_t) maxcount);
+      if (rank == 0) MPI_Reduce(MPI_IN_PLACE, x + i, k, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+      else MPI_Reduce(x + i, 0, k, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+#endif
+    (void) x;
+    (void) len;
+  }
+
+  void sum(long long& x) {
+    double y = x;
+    sum(&y, 1);
+    x = (long long) y;
+  }
+
+  void sum(double& x) { sum(&x, 1); }
+
+  // the minimum of x over the ranks into x of rank 0
+  void min(double& x) {
+#ifdef SSCTPR_MPI
+    if (rank == 0) MPI_Reduce(MPI_IN_PLACE, &x, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+    else MPI_Reduce(&x, 0, 1, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+#endif
+    (void) x;
+  }
+
+  // appends the elements of v of the other ranks to v of rank 0, by rank
+  template <class T>
+  void gather(std::vector<T>& v) {
+#ifdef SSCTPR_MPI
+    if (size == 1) return;
+    const long long bytes = (long long) v.size() * sizeof(T);
+    std::vector<long long> counts(size);
+    MPI_Gather(&bytes, 1, MPI_LONG_LONG, &counts[0], 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      size_t total = v.size();
+      for (int r = 1; r < size; r++) total += counts[r] / sizeof(T);
+      v.reserve(total);
+      for (int r = 1; r < size; r++) {
+        const size_t first = v.size();
+        v.resize(first + counts[r] / sizeof(T));
+        receive((char*) (v.data() + first), counts[r], r);
+      }
+    } else {
+      send((const char*) v.data(), bytes);
+    }
+#endif
+    (void) v;
+  }
+
+  int rank, size;
+
+private:
+#ifdef SSCTPR_MPI
+  enum { maxcount = 1 << 28 }; // elements per MPI call
+
+  void send(const char* data, long long bytes) {
+    for (long long i = 0; i < bytes; i += maxcount)
+      MPI_Send(data + i, (int) std::min((long long) maxcount, bytes - i), MPI_BYTE,
+               0, 0, MPI_COMM_WORLD);
+  }
+
+  void receive(char* data, long long bytes, int from) {
+    for (long long i = 0; i < bytes; i += maxcount)
+      MPI_Recv(data + i, (int) std::min((long long) maxcount, bytes - i), MPI_BYTE,
+               from, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  }
+#endif
+  Comm(const Comm&);
+  Comm& operator=(const Comm&);
+};
+
+/**
+ Solves the chunks [chunkstart[c], chunkend[c]] of blocks for s < 1, on
+ opt.threads threads
+
+ */
+void solveChunks(const Options& opt, const Bim& bim, const Matched& m,
+                 const Keep& keep, int N,
+                 const std::vector<int>& startvec, const std::vector<int>& endvec,
+                 const std::vector<int>& chunkstart, const std::vector<int>& chunkend,
+                 std::vector<Weight>& weights, SolveStats& stats) {
+  const int nchunks = chunkstart.size();
+  const int nl = opt.lambda.size();
+  // run lambdas in decreasing order, as in ssCTPR
+  std::vector<int> order(nl);
+  for (int i = 0; i < nl; i++) order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&](int a, int b) { return opt.lambda[a] > opt.lambda[b]; });
+  std::vector<double> lambda(nl);
+  for (int i = 0; i < nl; i++) lambda[i] = opt.lambda[order[i]];
+
+  std::atomic<int> next(0);
+  std::mutex mutex;
+  std::string error;
+  std::vector<std::thread> pool;
+  const int threads = std::min(opt.threads, nchunks);
+  for (int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&]() {
+      try {
+        for (int c = next++; c < nchunks; c = next++) {
+          const int from = startvec[chunkstart[c]];
+          const int to = endvec[chunkend[c]] + 1;
+          const int p = to - from;
+          double t0 = now();
+          std::vector<char> mask(bim.size(), 0);
+          for (int j = from; j < to; j++) mask[m.variant[j]] = 1;
+          Selection sel(mask, keep);
+          const int n = ssctpr::selectedSamples(N, sel.sel);
+          std::vector<int> start, end;
+          for (int b = chunkstart[c]; b <= chunkend[c]; b++) {
+            start.push_back(startvec[b] - from);
+            end.push_back(endvec[b] - from);
+          }
+          std::vector<double> genotypes, sd(p);
+          ssctpr::SketchedPanel panel;
+          ssctpr::SparseLD ld;
+          ssctpr::RidgeBasis basis;
+          const bool lowrank = opt.ld == "lowrank";
+          const int solver = opt.solver == "fista" ? ssctpr::solverFISTA :
+            opt.solver == "auto" ? ssctpr::solverAuto :
+            opt.solver == "tuned" ? ssctpr::solverTuned : ssctpr::solverCD;
+          long long sketched = 0, ldshrunk = 0, ldrank = 0;
+          double lderror = 0.0, ldvariance = 0.0;
+          double ldsmallest = std::numeric_limits<double>::infinity();
+          if (opt.ld == "sparse") {
+            std::vector<double> pos(p);
+            for (int j = 0; j < p; j++) pos[j] = bim.pos[m.variant[from + j]];
+            ssctpr::sparseLD(opt.ref + ".bed", N, bim.size(), sel.sel, &start[0],
+                             &end[0], start.size(), &pos[0], opt.ldwindow,
+                             opt.ldr2, ld);
+            sd = ld.sd;
+            for (size_t b = 0; b < ld.offdiag.size(); b++) {
+              if (ld.offdiag[b] < 1.0) ldshrunk++;
+              if (ld.smallest[b] < ldsmallest) ldsmallest = ld.smallest[b];
+            }
+          } else if (lowrank) {
+            std::vector<int> k(start.size(), opt.ldrank);
+            ssctpr::lowRankGenotypes(opt.ref + ".bed", N, bim.size(), sel.sel,
+                                     &start[0], &end[0], start.size(), &k[0],
+                                     opt.ldvariance, opt.seed + chunkstart[c],
+                                     panel);
+            sd = panel.sd;
+            for (size_t b = 0; b < start.size(); b++) {
+              sketched++;
+              ldrank += panel.k[b];
+              ldvariance += panel.variance[b];
+              lderror += panel.lderror[b];
+            }
+          } else if (opt.sketch > 0) {
+            std::vector<int> k(start.size(), opt.sketch);
+            ssctpr::sketchGenotypes(opt.ref + ".bed", N, bim.size(), sel.sel,
+                                    &start[0], &end[0], start.size(), &k[0],
+                                    opt.sketchmethod == "sparse",
+                                    opt.seed + chunkstart[c], panel);
+            sd = panel.sd;
+            for (size_t b = 0; b < start.size(); b++) {
+              if (panel.k[b] == n) continue;
+              sketched++;
+              lderror += panel.lderror[b];
+            }
+          } else {
+            genotypes.resize((size_t) n * p);
+            ssctpr::genotypeMatrix(opt.ref + ".bed", N, bim.size(), sel.sel, 1,
+                                   &genotypes[0]);
+            ssctpr::normalize(&genotypes[0], n, p, &sd[0]);
+            if (opt.ridge)
+              ssctpr::ridgeBasis(&genotypes[0], &sd[0], n, p, &start[0],
+                                 &end[0], start.size(), basis);
+          }
+          double t1 = now();
+          std::vector<double> r((size_t) p * m.traits);
+          for (int k = 0; k < m.traits; k++)
+            std::copy(m.r.begin() + (size_t) k * m.size() + from,
+                      m.r.begin() + (size_t) k * m.size() + to,
+                      r.begin() + (size_t) k * p);
+
+          std::vector<Weight> local;
+          long long notconverged = 0, paths = 0, ridge = 0, sweeps = 0;
+          long long coarse = 0, coarsesweeps = 0, carriers = 0;
+          double coarsetime = 0.0;
+          std::vector<double> X;
+          ssctpr::SketchedPanel scaled;
+          for (size_t si = 0; si < opt.shrink.size(); si++) {
+            const double s = opt.shrink[si];
+            if (s == 1.0) continue;
+            const double scale = sqrt(1.0 - s);
+            if (opt.sketch > 0 || lowrank) {
+              scaled = panel;
+              for (size_t i = 0; i < scaled.X.size(); i++) scaled.X[i] *= scale;
+            } else if (opt.ld == "panel") {
+              X = genotypes;
+              for (size_t i = 0; i < X.size(); i++) X[i] *= scale;
+            }
+            for (size_t ci = 0; ci < opt.lambdact.size(); ci++) {
+              std::vector<double> x(p, 0.0);
+              ssctpr::ElnetPath path;
+              if (opt.ld == "sparse") {
+                ssctpr::elnetPathSparse(&lambda[0], nl, s, opt.lambdact[ci], ld,
+                                        &r[0], m.traits, &m.adj[from], opt.thr,
+                                        &x[0], opt.trace - 1, opt.maxiter, path);
+              } else if (opt.sketch > 0 || lowrank) {
+                ssctpr::elnetPathSketched(&lambda[0], nl, s, opt.lambdact[ci],
+                                          scaled, p, &r[0], m.traits,
+                                          &m.adj[from], opt.thr, &x[0],
+                                          opt.trace - 1, opt.maxiter, solver,
+                                          &start[0], &end[0], start.size(), path);
+              } else {
+                ssctpr::elnetPath(&lambda[0], nl, s, opt.lambdact[ci], &X[0],
+                                  &sd[0], n, p, &r[0], m.traits, &m.adj[from],
+                                  opt.thr, &x[0], opt.trace - 1, opt.maxiter,
+                                  solver, opt.ridge ? &basis : 0,
+                                  opt.subsample, opt.seed + chunkstart[c],
+                                  opt.carriers, &start[0], &end[0],
+                                  start.size(), path);
+              }
+              // the carrier lists of a chunk are the same for all s and lambda_ct
+              carriers = path.carriers;
+              for (size_t b = 0; b < path.tel.size(); b++) {
+                const ssctpr::ElnetTelemetry& tel = path.tel[b];
+                ridge += tel.ridge;
+                sweeps += tel.sweeps;
+                coarse += tel.coarse;
+                coarsesweeps += tel.coarsesweeps;
+                coarsetime += tel.coarsetime;
+              }
+              paths += nl;
+              for (int i = 0; i < nl; i++) {
+                if (!path.conv[i]) notconverged++;
+                const int column = (si * opt.lambdact.size() + ci) * nl + order[i];
+                const double* beta = &path.beta[(size_t) i * p];
+                for (int j = 0; j < p; j++) {
+                  if (beta[j] == 0.0) continue;
+                  Weight w = {from + j, column, beta[j]};
+                  local.push_back(w);
+                }
+              }
+            }
+          }
+          double t2 = now();
+
+          std::lock_guard<std::mutex> lock(mutex);
+          weights.insert(weights.end(), local.begin(), local.end());
+          stats.notconverged += notconverged;
+          stats.paths += paths;
+          stats.sketched += sketched;
+          stats.ldnnz += ld.col.size();
+          stats.ldshrunk += ldshrunk;
+          stats.ldsmallest = std::min(stats.ldsmallest, ldsmallest);
+          stats.ldrank += ldrank;
+          stats.ridge += ridge;
+          stats.sweeps += sweeps;
+          stats.coarse += coarse;
+          stats.coarsesweeps += coarsesweeps;
+          stats.coarsetime += coarsetime;
+          stats.carriers += carriers;
+          stats.ldvariance += ldvariance;
+          stats.lderror += lderror;
+          stats.decode += t1 - t0;
+          stats.solve += t2 - t1;
+          if (opt.trace > 0)
+            std::cerr << "Chunk " << c + 1 << "/" << nchunks << ": " << p
+                      << " variants in " << t2 - t0 << "s" << std::endl;
+        }
+      } catch (ssctpr::Cancelled&) {
+        // stopped by the error of another thread
+      } catch (std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e.what();
+        next = nchunks;
+        ssctpr::requestCancel();
+      }
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+  ssctpr::resetCancel();
+  if (!error.empty()) throw std::runtime_error(error);
+}
+
+/**
+ The independent solution (s = 1) of indepssCTPR, for the variants
+ [from, to)
+
+ */
+void solveIndep(const Options& opt, const Matched& m, int si, int from, int to,
+                std::vector<Weight>& weights) {
+  const int nl = opt.lambda.size();
+  const int nct = opt.lambdact.size();
+  const int p = m.size();
+  for (int j = from; j < to; j++) {
+    for (int ci = 0; ci < nct; ci++) {
+      const double ct = opt.lambdact[ci];
+      const double u = m.r[j] + (m.traits > 1 ? ct * m.r[j + p] : 0.0);
+      const double denom = (m.traits > 1) ? 1.0 + ct * m.adj[j] : 1.0;
+      for (int i = 0; i < nl; i++) {
+        const double a = std::abs(u) - opt.lambda[i];
+        if (a <= 0.0) continue;
+        Weight w = {j, (si * nct + ci) * nl + i, (u > 0 ? a : -a) / denom};
+        weights.push_back(w);
+      }
+    }
+  }
+}
+
+/**
+ Polygenic scores of the test bfile: weights of the variants found in the
+ test bim (by SNP id, with A1/A2 swaps), split by variants between threads
+
+ */
+std::vector<double> score(const Options& opt, const Bim& ref, const Matched& m,
+                          const std::vector<Weight>& weights, int ncol,
+                          const Fam& fam, const Keep& keep, int& n,
+                          int& nscored) {
+  const Bim bim = readBim(opt.test);
+  std::map<std::string, int> index;
+  for (int j = 0; j < bim.size(); j++) index.insert(std::make_pair(bim.snp[j], j));
+
+  // test variant and sign of each matched variant, -1 if not in the test bim
+  std::vector<int> testvar(m.size(), -1);
+  std::vector<double> sign(m.size(), 1.0);
+  for (int j = 0; j < m.size(); j++) {
+    const int v = m.variant[j];
+    std::map<std::string, int>::const_iterator it = index.find(ref.snp[v]);
+    if (it == index.end()) continue;
+    const int k = it->second;
+    if (bim.a1[k] == ref.a1[v] && bim.a2[k] == ref.a2[v]) testvar[j] = k;
+    else if (bim.a1[k] == ref.a2[v] && bim.a2[k] == ref.a1[v]) {
+      testvar[j] = k;
+      sign[j] = -1.0;
+    }
+  }
+
+  // weights in the order of the test bim (multiBed3sp layout)
+  std::vector<Weight> w;
+  std::vector<char> mask(bim.size(), 0);
+  for (size_t i = 0; i < weights.size(); i++) {
+    const int k = testvar[weights[i].variant];
+    if (k < 0) continue;
+    Weight x = {k, weights[i].column, sign[weights[i].variant] * weights[i].beta};
+    w.push_back(x);
+    mask[k] = 1;
+  }
+  std::sort(w.begin(), w.end());
+  std::vector<int> variants;
+  for (int k = 0; k < bim.size(); k++) if (mask[k]) variants.push_back(k);
+  nscored = variants.size();
+
+  n = keep.index.empty() ? fam.size() : keep.index.size();
+  std::vector<double> result((size_t) n * ncol, 0.0);
+  if (variants.empty()) return result;
+
+  // split the variants so that each thread has a similar number of weights
+  const int threads = std::max(1, std::min(opt.threads, (int) variants.size()));
+  std::vector<int> first(threads + 1, 0);   // in variants
+  std::vector<size_t> wfirst(threads + 1, 0);
+  {
+    size_t i = 0;
+    int t = 1;
+    for (size_t v = 0; v < variants.size() && t < threads; v++) {
+      while (i < w.size() && w[i].variant == variants[v]) i++;
+      if (i * threads >= w.size() * t) {
+        first[t] = v + 1;
+        wfirst[t] = i;
+        t++;
+      }
+    }
+    for (; t <= threads; t++) {
+      first[t] = variants.size();
+      wfirst[t] = w.size();
+    }
+  }
+
+  std::vector<std::vector<double> > partial(threads);
+  std::vector<std::string> errors(threads);
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&, t]() {
+      try {
+        const int from = first[t], to = first[t + 1];
+        partial[t].assign((size_t) n * ncol, 0.0);
+        if (from == to) return;
+        std::vector<char> tmask(bim.size(), 0);
+        for (int v = from; v < to; v++) tmask[variants[v]] = 1;
+        Selection sel(tmask, keep);
+        std::vector<int> nonzeros(to - from, 0), colpos;
+        std::vector<double> beta;
+        for (size_t i = wfirst[t]; i < wfirst[t + 1]; i++) {
+          const int v = std::lower_bound(variants.begin() + from, variants.begin() + to,
+                                         w[i].variant) - variants.begin();
+          nonzeros[v - from]++;
+          colpos.push_back(w[i].column);
+          beta.push_back(w[i].beta);
+        }
+        ssctpr::multiBed3sp(opt.test + ".bed", fam.size(), bim.size(),
+                            beta.empty() ? 0 : &beta[0], &nonzeros[0],
+                            to - from, colpos.empty() ? 0 : &colpos[0], ncol,
+                            sel.sel, 0, &partial[t][0]);
+      } catch (ssctpr::Cancelled&) {
+        // stopped by the error of another thread
+      } catch (std::exception& e) {
+        errors[t] = e.what();
+        ssctpr::requestCancel();
+      }
+    }));
+  }
+  for (int t = 0; t < threads; t++) pool[t].join();
+  ssctpr::resetCancel();
+  for (int t = 0; t < threads; t++) {
+    if (!errors[t].empty()) throw std::runtime_error(errors[t]);
+    for (size_t i = 0; i < result.size(); i++) result[i] += partial[t][i];
+  }
+  return result;
+}
+
+void checkWrite(std::ostream& out, const std::string& fileName) {
+  if (!out) throw std::runtime_error("Cannot write " + fileName);
+}
+
+/**
+ Writes the weights as PREFIX.weights (compressed sparse columns), with
+ their rows (PREFIX.variants) and columns (PREFIX.columns), densifying as
+ many columns at a time as fit in --mem-limit
+
+ */
+void writeBinaryWeights(const Options& opt, const Bim& bim, const Matched& m,
+                        const std::vector<Weight>& weights,
+                        const std::vector<Column>& columns) {
+  std::string fileName = opt.out + ".variants";
+  std::ofstream variants(fileName.c_str());
+  variants << "SNP\tA1\tA2\n";
+  for (int j = 0; j < m.size(); j++) {
+    const int v = m.variant[j];
+    variants << bim.snp[v] << "\t" << bim.a1[v] << "\t" << bim.a2[v] << "\n";
+  }
+  checkWrite(variants, fileName);
+  fileName = opt.out + ".columns";
+  std::ofstream cols(fileName.c_str());
+  cols << "s\tlambda_ct\tlambda\n" << std::setprecision(10);
+  for (size_t c = 0; c < columns.size(); c++)
+    cols << columns[c].s << "\t" << columns[c].lambdact << "\t"
+         << columns[c].lambda << "\n";
+  checkWrite(cols, fileName);
+
+  const int p = m.size();
+  const int ncol = columns.size();
+  const int width = std::max(1, std::min(ncol,
+    (int) std::min(opt.memlimit / (8.0 * std::max(p, 1)), 1e9)));
+  std::vector<double> dense;
+  for (int c = 0; c < ncol; c += width) {
+    const int l = std::min(width, ncol - c);
+    dense.assign((size_t) p * l, 0.0);
+    for (size_t i = 0; i < weights.size(); i++) {
+      const int k = weights[i].column - c;
+      if (k >= 0 && k < l) dense[(size_t) k * p + weights[i].variant] = weights[i].beta;
+    }
+    ssctpr::writeWeights(opt.out + ".weights", dense.data(), p, l, c);
+  }
+  if (ncol == 0) ssctpr::writeWeights(opt.out + ".weights", 0, p, 0, 0);
+}
+
+}
+
+int main(int argc, char** argv) {
+  Comm comm(&argc, &argv);
+  try {
+    Options opt = parseOptions(argc, argv);
+    double start = now();
+    // rank 0 reports for all
+    std::ostringstream quiet;
+    std::ostream& report = comm.rank == 0 ? std::cerr : quiet;
+    ssctpr::setWarningStream(&std::cerr);
+    if (opt.trace > 1) ssctpr::setMessageStream(&std::cerr);
+    ssctpr::setFistaVariants(opt.fistavariants);
+
+    const Bim bim = readBim(opt.ref);
+    const Fam fam = readFam(opt.ref);
+    const Keep keep = readKeep(opt.keepref, fam);
+    const int N = fam.size();
+    const int n = keep.index.empty() ? N : keep.index.size();
+
+    Matched m = matchSumstats(opt, bim);
+    if (m.size() == 0) throw std::runtime_error("No variants matched the reference bim");
+    std::vector<int> startvec, endvec;
+    makeBlocks(opt, bim, m, startvec, endvec);
+    double tmatch = now();
+    report << m.size() << " variants matched in " << startvec.size()
+              << " blocks (" << tmatch - start << "s)" << std::endl;
+
+    std::vector<Column> columns;
+    for (size_t si = 0; si < opt.shrink.size(); si++)
+      for (size_t ci = 0; ci < opt.lambdact.size(); ci++)
+        for (size_t i = 0; i < opt.lambda.size(); i++) {
+          Column c = {opt.shrink[si], opt.lambdact[ci], opt.lambda[i]};
+          columns.push_back(c);
+        }
+
+    // chunks of whole blocks: at most mem-limit bytes of genotypes on all
+    // threads (two copies each), and several chunks per thread for balance
+    const int nblocks = startvec.size();
+    const int workers = opt.threads * comm.size;
+    long long maxchunk = (long long) (opt.memlimit / (16.0 * n * opt.threads));
+    maxchunk = std::min(maxchunk, (long long) ceil((double) m.size() / (4 * workers)));
+    maxchunk = std::max(maxchunk, 1LL);
+    std::vector<int> chunkstart, chunkend;
+    for (int b = 0; b < nblocks; b++) {
+      if (chunkstart.empty() ||
+          endvec[b] - startvec[chunkstart.back()] + 1 > maxchunk) {
+        if (!chunkstart.empty()) chunkend.push_back(b - 1);
+        chunkstart.push_back(b);
+      }
+    }
+    chunkend.push_back(nblocks - 1);
+    const int nchunks = chunkstart.size();
+
+    // the chunks of this rank: a contiguous range with about m.size() / size
+    // variants
+    std::vector<int> mystart, myend;
+    for (int c = 0; c < nchunks; c++) {
+      const long long mid = (startvec[chunkstart[c]] + endvec[chunkend[c]] + 1) / 2;
+      if (mid * comm.size / m.size() != comm.rank) continue;
+      mystart.push_back(chunkstart[c]);
+      myend.push_back(chunkend[c]);
+    }
+    const int from = mystart.empty() ? 0 : startvec[mystart.front()];
+    const int to = mystart.empty() ? 0 : endvec[myend.back()] + 1;
+
+    std::vector<Weight> weights;
+    SolveStats stats;
+    bool ld = false;
+    for (size_t si = 0; si < opt.shrink.size(); si++) {
+      if (opt.shrink[si] == 1.0) solveIndep(opt, m, si, from, to, weights);
+      else ld = true;
+    }
+    if (ld && !mystart.empty()) {
+      solveChunks(opt, bim, m, keep, N, startvec, endvec, mystart, myend,
+                  weights, stats);
+    }
+    // each rank scores its own weights; rank 0 writes those of all
+    std::vector<Weight> myweights;
+    if (comm.size > 1 && !opt.test.empty()) myweights = weights;
+    comm.gather(weights);
+    comm.sum(stats.notconverged);
+    comm.sum(stats.paths);
+    comm.sum(stats.decode);
+    comm.sum(stats.solve);
+    comm.sum(stats.sketched);
+    comm.sum(stats.ldnnz);
+    comm.sum(stats.ldshrunk);
+    comm.min(stats.ldsmallest);
+    comm.sum(stats.ldrank);
+    comm.sum(stats.ridge);
+    comm.sum(stats.sweeps);
+    comm.sum(stats.coarse);
+    comm.sum(stats.coarsesweeps);
+    comm.sum(stats.coarsetime);
+    comm.sum(stats.carriers);
+    comm.sum(stats.ldvariance);
+    comm.sum(stats.lderror);
+    std::sort(weights.begin(), weights.end());
+    double tsolve = now();
+    report << "Solved " << columns.size() << " columns in " << nchunks
+           << " chunks on " << comm.size << "x" << opt.threads << " threads ("
+           << tsolve - tmatch << "s)" << std::endl;
+    if (stats.notconverged > 0)
+      report << "Warning: " << stats.notconverged << " of " << stats.paths
+             << " chunk/lambda solutions did not converge" << std::endl;
+
+    std::string fileName = opt.out + ".weights";
+    if (comm.rank == 0 && opt.format == "binary") {
+      writeBinaryWeights(opt, bim, m, weights, columns);
+    } else if (comm.rank == 0) {
+      std::ofstream out(fileName.c_str());
+      out << "SNP\tA1\tA2\ts\tlambda_ct\tlambda\tbeta\n";
+      out << std::setprecision(10);
+      for (size_t i = 0; i < weights.size(); i++) {
+        const int v = m.variant[weights[i].variant];
+        const Column& c = columns[weights[i].column];
+        out << bim.snp[v] << "\t" << bim.a1[v] << "\t" << bim.a2[v] << "\t"
+            << c.s << "\t" << c.lambdact << "\t" << c.lambda << "\t"
+            << weights[i].beta << "\n";
+      }
+      checkWrite(out, fileName);
+    }
+    double twrite = now();
+
+    int nscored = 0;
+    double tscore = twrite;
+    if (!opt.test.empty()) {
+      const Fam testfam = readFam(opt.test);
+      const Keep testkeep = readKeep(opt.keeptest, testfam);
+      int ntest;
+      std::vector<double> scores = score(opt, bim, m,
+                                         comm.size > 1 ? myweights : weights,
+                                         columns.size(), testfam, testkeep,
+                                         ntest, nscored);
+      comm.sum(scores.data(), scores.size());
+      long long scored = nscored;
+      comm.sum(scored);
+      nscored = scored;
+      tscore = now();
+      if (comm.rank > 0) return 0;
+      fileName = opt.out + ".scores";
+      if (opt.format == "binary") {
+        std::vector<int> samples(testkeep.index);
+        if (samples.empty()) {
+          for (int i = 0; i < ntest; i++) samples.push_back(i);
+        }
+        ssctpr::writeScores(fileName, scores.data(), samples.data(), ntest,
+                            columns.size(), 0);
+      } else {
+        std::ofstream out(fileName.c_str());
+        out << "FID\tIID";
+        for (size_t c = 0; c < columns.size(); c++) out << "\t" << columns[c].name();
+        out << "\n" << std::setprecision(10);
+        for (int i = 0; i < ntest; i++) {
+          const int k = testkeep.index.empty() ? i : testkeep.index[i];
+          out << testfam.fid[k] << "\t" << testfam.iid[k];
+          for (size_t c = 0; c < columns.size(); c++)
+            out << "\t" << scores[i + (size_t) c * ntest];
+          out << "\n";
+        }
+        checkWrite(out, fileName);
+      }
+      std::cerr << "Scored " << ntest << " samples on " << nscored
+                << " variants (" << tscore - twrite << "s)" << std::endl;
+    }
+
+    if (comm.rank > 0) return 0;
+    std::ostringstream smallest;
+    if (stats.ldsmallest < std::numeric_limits<double>::infinity())
+      smallest << stats.ldsmallest;
+    else
+      smallest << "NA";
+    fileName = opt.out + ".log";
+    std::ofstream log(fileName.c_str());
+    log << "ref\t" << opt.ref << "\nsumstats\t" << opt.sumstats
+        << "\ntest\t" << opt.test << "\nn.ref\t" << n
+        << "\nvariants\t" << m.size() << "\nblocks\t" << nblocks
+        << "\nchunks\t" << nchunks << "\nranks\t" << comm.size
+        << "\nthreads\t" << opt.threads
+        << "\ncolumns\t" << columns.size() << "\nweights\t" << weights.size()
+        << "\nnot.converged\t" << stats.notconverged
+        << "\nsketch\t" << opt.sketch
+        << "\nsketch.method\t" << opt.sketchmethod
+        << "\nblocks.sketched\t" << stats.sketched
+        << "\nld.error.mean\t"
+        << (stats.sketched > 0 ? stats.lderror / stats.sketched : 0.0)
+        << "\nsolver\t" << opt.solver
+        << "\nformat\t" << opt.format
+        << "\nridge\t" << opt.ridge
+        << "\nblocks.ridge.start\t" << stats.ridge
+        << "\nsubsample\t" << opt.subsample
+        << "\nblocks.coarse.start\t" << stats.coarse
+        << "\nsweeps\t" << stats.sweeps
+        << "\nsweeps.coarse\t" << stats.coarsesweeps
+        << "\nseconds.coarse\t" << stats.coarsetime
+        << "\ncarriers\t" << opt.carriers
+        << "\nvariants.carriers\t" << stats.carriers
+        << "\nld\t" << opt.ld
+        << "\nld.r2\t" << opt.ldr2
+        << "\nld.window\t" << opt.ldwindow
+        << "\nld.nnz\t" << stats.ldnnz
+        << "\nblocks.ld.shrunk\t" << stats.ldshrunk
+        << "\nld.smallest.eigenvalue\t" << smallest.str()
+        << "\nld.rank.mean\t"
+        << (stats.sketched > 0 ? (double) stats.ldrank / stats.sketched : 0.0)
+        << "\nld.variance.mean\t"
+        << (stats.sketched > 0 ? stats.ldvariance / stats.sketched : 0.0)
+        << "\nvariants.scored\t" << nscored
+        << "\nseconds.match\t" << tmatch - start
+        << "\nseconds.decode\t" << stats.decode
+        << "\nseconds.solve\t" << stats.solve
+        << "\nseconds.score\t" << tscore - twrite
+        << "\nseconds.total\t" << now() - start << "\n";
+    checkWrite(log, fileName);
+    return 0;
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_run: " << e.what() << "\n";
+    comm.abort(1);
+    return 1;
+  }
+}
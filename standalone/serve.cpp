@@ -0,0 +1,541 @@
+/**
+ ssCTPR
+ serve.cpp
+ Purpose: resident scoring daemon: keeps a test cohort in memory (or
+ mmapped) and computes polygenic scores of sparse weight sets sent over a
+ local (Unix domain) socket
+
+ @author Yingxi Yang
+
+ Usage: ssctpr_serve --bfile TEST --socket PATH [--keep FILE] [--threads 1]
+                     [--load mmap|memory] [--batch-wait 5] [--max-batch 32]
+
+ The .bim/.fam are parsed once. Requests arriving within --batch-wait
+ milliseconds of each other (up to --max-batch) are merged into a single
+ pass over the genotypes, split by variants between threads; each request
+ gets its own columns of the result. See protocol.h for the protocol and
+ client.cpp for a client. The socket is created with mode 0600.
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "kernels.h"
+#include "plink.h"
+#include "protocol.h"
+
+namespace {
+
+struct Options {
+  std::string bfile, socket, keep, load;
+  int threads, batchwait, maxbatch;
+  Options() : load("mmap"), threads(1), batchwait(5), maxbatch(32) {}
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_serve --bfile TEST --socket PATH [options]\n"
+    "  --bfile BFILE      cohort to score (without .bed)\n"
+    "  --socket PATH      Unix domain socket to listen on\n"
+    "  --keep FILE        FID IID of the samples to score (all)\n"
+    "  --threads T        threads of each decode pass (1)\n"
+    "  --load L           mmap or memory (read the .bed into memory) (mmap)\n"
+    "  --batch-wait MS    time to wait for more requests to batch (5)\n"
+    "  --max-batch K      maximal number of requests per pass (32)\n";
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    std::string v = argv[++i];
+    if (a == "--bfile") opt.bfile = v;
+    else if (a == "--socket") opt.socket = v;
+    else if (a == "--keep") opt.keep = v;
+    else if (a == "--load") opt.load = v;
+    else if (a == "--threads") opt.threads = std::atoi(v.c_str());
+    else if (a == "--batch-wait") opt.batchwait = std::atoi(v.c_str());
+    else if (a == "--max-batch") opt.maxbatch = std::atoi(v.c_str());
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  if (opt.bfile.empty() || opt.socket.empty())
+    throw std::runtime_error("--bfile and --socket must be specified");
+  if (opt.load != "mmap" && opt.load != "memory")
+    throw std::runtime_error("--load must be mmap or memory");
+  if (opt.threads < 1 || opt.maxbatch < 1 || opt.batchwait < 0)
+    throw std::runtime_error("--threads, --max-batch and --batch-wait must be positive");
+  return opt;
+}
+
+/**
+ The cohort: bim, fam, kept samples and the genotypes
+
+ */
+class Cohort {
+public:
+  Cohort(const Options& opt) : map_(0), maplen_(0) {
+    bim = ssctpr::readBim(opt.bfile);
+    fam = ssctpr::readFam(opt.bfile);
+    keep = ssctpr::readKeep(opt.keep, fam);
+    N = fam.size();
+    P = bim.size();
+    n = keep.index.empty() ? N : keep.index.size();
+    index.reserve(P);
+    for (int j = 0; j < P; j++) index.insert(std::make_pair(bim.snp[j], j));
+
+    const std::string fileName = opt.bfile + ".bed";
+    const size_t expected = 3 + ssctpr::bedBytes(N) * (size_t) P;
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + fileName);
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || (size_t) st.st_size < expected) {
+      ::close(fd);
+      throw std::runtime_error(fileName + " is truncated; has the FAM/BIM file been changed?");
+    }
+    const char* data;
+    if (opt.load == "mmap") {
+      maplen_ = st.st_size;
+      map_ = ::mmap(0, maplen_, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (map_ == MAP_FAILED) throw std::runtime_error("Cannot mmap " + fileName);
+      data = (const char*) map_;
+    } else {
+      memory_.resize(expected);
+      size_t done = 0;
+      while (done < expected) {
+        ssize_t k = ::read(fd, &memory_[done], expected - done);
+        if (k <= 0) {
+          ::close(fd);
+          throw std::runtime_error("Cannot read " + fileName);
+        }
+        done += k;
+      }
+      ::close(fd);
+      data = &memory_[0];
+    }
+    if (data[0] != 0x6c || data[1] != 0x1b || data[2] != 0x01)
+      throw std::runtime_error(fileName + " is not a v1.00 SNP-major bed file");
+    bed = data + 3;
+  }
+  ~Cohort() {
+    if (map_) ::munmap(map_, maplen_);
+  }
+
+  ssctpr::Bim bim;
+  ssctpr::Fam fam;
+  ssctpr::Keep keep;
+  std::unordered_map<std::string, int> index;
+  int N, P, n;
+  const char* bed;
+
+private:
+  Cohort(const Cohort&);
+  Cohort& operator=(const Cohort&);
+  void* map_;
+  size_t maplen_;
+  std::vector<char> memory_;
+};
+
+struct Weight {
+  int variant, column;
+  double beta;
+  bool operator<(const Weight& w) const {
+    return variant < w.variant || (variant == w.variant && column < w.column);
+  }
+};
+
+/**
+ A SCORE request waiting for its batch
+
+ */
+struct Request {
+  std::vector<Weight> weights;
+  int ncol;
+  // set by the batch thread
+  std::vector<double> scores;
+  std::string error;
+  int batch;
+  bool done;
+  Request() : ncol(0), batch(0), done(false) {}
+};
+
+class Server {
+public:
+  Server(const Options& opt, const Cohort& cohort) :
+    opt_(opt), cohort_(cohort), stop_(false), listenfd_(-1),
+    passes_(0), requests_(0) {}
+
+  void run();
+
+private:
+  void batchLoop();
+  void process(std::vector<std::shared_ptr<Request> >& batch);
+  void handle(int fd);
+  std::shared_ptr<Request> readScore(ssctpr::SocketReader& in, int ncol,
+                                     long long nweights, int& matched);
+  void shutdown();
+  void joinExited();
+
+  const Options& opt_;
+  const Cohort& cohort_;
+  std::mutex mutex_;
+  std::condition_variable queued_, finished_;
+  std::deque<std::shared_ptr<Request> > queue_;
+  std::atomic<bool> stop_;
+  // handler threads, the sockets of those still running, and the ids of
+  // those that have returned and can be joined (all under mutex_)
+  std::map<std::thread::id, std::thread> handlers_;
+  std::set<int> clients_;
+  std::vector<std::thread::id> exited_;
+  int listenfd_;
+  long long passes_, requests_;
+};
+
+std::shared_ptr<Request> Server::readScore(ssctpr::SocketReader& in, int ncol,
+                                           long long nweights, int& matched) {
+  std::shared_ptr<Request> req(new Request());
+  req->ncol = ncol;
+  req->weights.reserve(nweights);
+  matched = 0;
+  std::string line, snp, a1;
+  for (long long k = 0; k < nweights; k++) {
+    if (!in.readLine(line)) throw std::runtime_error("Connection closed");
+    std::istringstream s(line);
+    int column;
+    double beta;
+    if (!(s >> snp >> a1 >> column >> beta))
+      throw std::runtime_error("Cannot parse weight '" + line + "'");
+    if (column < 0 || column >= ncol)
+      throw std::runtime_error("Column out of range in '" + line + "'");
+    std::unordered_map<std::string, int>::const_iterator it = cohort_.index.find(snp);
+    if (it == cohort_.index.end()) continue;
+    const int j = it->second;
+    double sign;
+    if (a1 == cohort_.bim.a1[j]) sign = 1.0;
+    else if (a1 == cohort_.bim.a2[j]) sign = -1.0;
+    else continue;
+    if (beta == 0.0) continue;
+    Weight w = {j, column, sign * beta};
+    req->weights.push_back(w);
+    matched++;
+  }
+  return req;
+}
+
+void Server::batchLoop() {
+  for (;;) {
+    std::vector<std::shared_ptr<Request> > batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (queue_.empty() && !stop_) queued_.wait(lock);
+      if (stop_ && queue_.empty()) return;
+      // give concurrent clients a chance to join this pass
+      std::chrono::steady_clock::time_point until =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(opt_.batchwait);
+      while ((int) queue_.size() < opt_.maxbatch && !stop_ &&
+             queued_.wait_until(lock, until) != std::cv_status::timeout) {}
+      while (!queue_.empty() && (int) batch.size() < opt_.maxbatch) {
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+      }
+    }
+    process(batch);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (size_t r = 0; r < batch.size(); r++) batch[r]->done = true;
+      passes_++;
+      requests_ += batch.size();
+    }
+    finished_.notify_all();
+  }
+}
+
+/**
+ One pass over the genotypes for all the requests of a batch
+
+ */
+void Server::process(std::vector<std::shared_ptr<Request> >& batch) {
+  const int n = cohort_.n;
+  std::vector<int> offset(batch.size() + 1, 0);
+  size_t total = 0;
+  for (size_t r = 0; r < batch.size(); r++) {
+    offset[r + 1] = offset[r] + batch[r]->ncol;
+    total += batch[r]->weights.size();
+  }
+  const int ncol = offset[batch.size()];
+
+  std::vector<Weight> w;
+  w.reserve(total);
+  for (size_t r = 0; r < batch.size(); r++) {
+    for (size_t k = 0; k < batch[r]->weights.size(); k++) {
+      Weight x = batch[r]->weights[k];
+      x.column += offset[r];
+      w.push_back(x);
+    }
+  }
+  std::sort(w.begin(), w.end());
+  std::vector<int> variants;
+  for (size_t k = 0; k < w.size(); k++) {
+    if (variants.empty() || variants.back() != w[k].variant)
+      variants.push_back(w[k].variant);
+  }
+
+  std::vector<double> result((size_t) n * ncol, 0.0);
+  try {
+    // split the variants so that each thread has a similar number of weights
+    const int threads = std::max(1, std::min(opt_.threads, (int) variants.size()));
+    std::vector<int> first(threads + 1, (int) variants.size());
+    std::vector<size_t> wfirst(threads + 1, w.size());
+    first[0] = 0;
+    wfirst[0] = 0;
+    for (size_t v = 0, k = 0, t = 1; v < variants.size() && t < (size_t) threads; v++) {
+      while (k < w.size() && w[k].variant == variants[v]) k++;
+      if (k * threads >= w.size() * t) {
+        first[t] = v + 1;
+        wfirst[t] = k;
+        t++;
+      }
+    }
+
+    std::vector<std::vector<double> > partial(threads);
+    std::vector<std::string> errors(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+      pool.push_back(std::thread([&, t]() {
+        try {
+          const int from = first[t], to = first[t + 1];
+          if (from >= to) return;
+          std::vector<char> mask(cohort_.P, 0);
+          for (int v = from; v < to; v++) mask[variants[v]] = 1;
+          ssctpr::Selection sel(mask, cohort_.keep);
+          std::vector<int> nonzeros(to - from, 0), colpos;
+          std::vector<double> beta;
+          int v = from;
+          for (size_t k = wfirst[t]; k < wfirst[t + 1]; k++) {
+            while (variants[v] != w[k].variant) v++;
+            nonzeros[v - from]++;
+            colpos.push_back(w[k].column);
+            beta.push_back(w[k].beta);
+          }
+          partial[t].resize((size_t) n * ncol);
+          ssctpr::multiBed3spBuffer(cohort_.bed, cohort_.N, cohort_.P, &beta[0],
+                                    &nonzeros[0], to - from, &colpos[0], ncol,
+                                    sel.sel, &partial[t][0]);
+        } catch (std::exception& e) {
+          errors[t] = e.what();
+        }
+      }));
+    }
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+    for (int t = 0; t < threads; t++) {
+      if (!errors[t].empty()) throw std::runtime_error(errors[t]);
+      if (partial[t].empty()) continue;
+      for (size_t i = 0; i < result.size(); i++) result[i] += partial[t][i];
+    }
+  } catch (std::exception& e) {
+    for (size_t r = 0; r < batch.size(); r++) batch[r]->error = e.what();
+    return;
+  }
+
+  for (size_t r = 0; r < batch.size(); r++) {
+    batch[r]->batch = batch.size();
+    batch[r]->scores.assign(result.begin() + (size_t) offset[r] * n,
+                            result.begin() + (size_t) offset[r + 1] * n);
+  }
+}
+
+void Server::handle(int fd) {
+  try {
+    ssctpr::SocketReader in(fd);
+    std::string line;
+    while (in.readLine(line)) {
+      std::istringstream s(line);
+      std::string command;
+      s >> command;
+      std::ostringstream reply;
+      if (command == "INFO") {
+        reply << "OK " << cohort_.n << " " << cohort_.P << "\n";
+        ssctpr::writeAll(fd, reply.str());
+      } else if (command == "SAMPLES") {
+        reply << "OK " << cohort_.n << "\n";
+        for (int i = 0; i < cohort_.n; i++) {
+          const int k = cohort_.keep.index.empty() ? i : cohort_.keep.index[i];
+          reply << cohort_.fam.fid[k] << " " << cohort_.fam.iid[k] << "\n";
+        }
+        ssctpr::writeAll(fd, reply.str());
+      } else if (command == "SCORE") {
+        int ncol;
+        long long nweights;
+        if (!(s >> ncol >> nweights) || ncol < 1 || nweights < 0) {
+          ssctpr::writeAll(fd, "ERR SCORE needs <ncol> <nweights>\n");
+          break;
+        }
+        int matched;
+        std::shared_ptr<Request> req;
+        try {
+          req = readScore(in, ncol, nweights, matched);
+        } catch (std::exception& e) {
+          ssctpr::writeAll(fd, std::string("ERR ") + e.what() + "\n");
+          break;
+        }
+        bool queued = false;
+        {
+          // the batch thread returns once stop_ is set and the queue is
+          // empty, so nothing is queued after that
+          std::unique_lock<std::mutex> lock(mutex_);
+          if (!stop_) {
+            queue_.push_back(req);
+            queued_.notify_all();
+            queued = true;
+            while (!req->done) finished_.wait(lock);
+          }
+        }
+        if (!queued) {
+          ssctpr::writeAll(fd, "ERR Server is shutting down\n");
+          break;
+        }
+        if (!req->error.empty()) {
+          ssctpr::writeAll(fd, "ERR " + req->error + "\n");
+          continue;
+        }
+        reply << "OK " << cohort_.n << " " << ncol << " " << matched << " "
+              << req->batch << "\n";
+        ssctpr::writeAll(fd, reply.str());
+        ssctpr::writeAll(fd, (const char*) req->scores.data(),
+                         req->scores.size() * sizeof(double));
+      } else if (command == "SHUTDOWN") {
+        ssctpr::writeAll(fd, "OK\n");
+        shutdown();
+        break;
+      } else if (!command.empty()) {
+        ssctpr::writeAll(fd, "ERR Unknown command " + command + "\n");
+      }
+    }
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_serve: " << e.what() << std::endl;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.erase(fd);
+    exited_.push_back(std::this_thread::get_id());
+  }
+  ::close(fd);
+}
+
+// with mutex_ held
+void Server::joinExited() {
+  for (size_t t = 0; t < exited_.size(); t++) {
+    std::map<std::thread::id, std::thread>::iterator it = handlers_.find(exited_[t]);
+    it->second.join();
+    handlers_.erase(it);
+  }
+  exited_.clear();
+}
+
+void Server::shutdown() {
+  stop_ = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_.notify_all();
+  }
+  ::shutdown(listenfd_, SHUT_RDWR);
+}
+
+void Server::run() {
+  sockaddr_un addr = ssctpr::socketAddress(opt_.socket);
+  ::unlink(opt_.socket.c_str());
+  listenfd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenfd_ < 0) throw std::runtime_error("Cannot create a socket");
+  mode_t mask = ::umask(0077);
+  int bound = ::bind(listenfd_, (sockaddr*) &addr, sizeof(addr));
+  ::umask(mask);
+  if (bound < 0) throw std::runtime_error("Cannot bind " + opt_.socket);
+  if (::listen(listenfd_, 64) < 0) throw std::runtime_error("Cannot listen on " + opt_.socket);
+
+  std::thread batcher(&Server::batchLoop, this);
+  std::cerr << "Serving " << cohort_.n << " samples x " << cohort_.P
+            << " variants on " << opt_.socket << std::endl;
+  while (!stop_) {
+    int fd = ::accept(listenfd_, 0, 0);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    joinExited();
+    clients_.insert(fd);
+    std::thread handler(&Server::handle, this, fd);
+    handlers_[handler.get_id()] = std::move(handler);
+  }
+  stop_ = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_.notify_all();
+  }
+  // the queued requests are answered, then the clients still connected are
+  // read to their end, so that no handler outlives the cohort
+  batcher.join();
+  std::map<std::thread::id, std::thread> handlers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::set<int>::iterator it = clients_.begin(); it != clients_.end(); it++)
+      ::shutdown(*it, SHUT_RD);
+    handlers.swap(handlers_);
+    exited_.clear();
+  }
+  for (std::map<std::thread::id, std::thread>::iterator it = handlers.begin();
+       it != handlers.end(); it++)
+    it->second.join();
+  ::close(listenfd_);
+  ::unlink(opt_.socket.c_str());
+  std::cerr << "Served " << requests_ << " requests in " << passes_
+            << " passes" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    Options opt = parseOptions(argc, argv);
+    ::signal(SIGPIPE, SIG_IGN);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Cohort cohort(opt);
+    std::cerr << "Loaded " << opt.bfile << " ("
+              << std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start).count()
+              << "s)" << std::endl;
+    Server server(opt, cohort);
+    server.run();
+    return 0;
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_serve: " << e.what() << "\n";
+    return 1;
+  }
+}
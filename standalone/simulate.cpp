@@ -0,0 +1,710 @@
+/**
+ ssCTPR
+ simulate.cpp
+ Purpose: synthetic PLINK datasets, multi-trait summary statistics and adj
+ inputs for ssCTPR.pipeline, for scaling tests without real genotypes
+
+ @author Yingxi Yang
+
+ Haplotypes are mosaics of a few founder haplotypes per LD block: within a
+ block, each haplotype copies one founder per segment, with switch points
+ that differ between haplotypes, so LD is high within segments, decays within
+ blocks and is absent between blocks. Founders carry the A1 allele at a
+ fraction of about maf, drawn from a power-law MAF spectrum; variants too rare
+ to be carried by a founder are given to independent carriers instead.
+
+ All random draws are hashes of (seed, sample, variant, ...), so blocks can be
+ generated on any thread in any order. Blocks are streamed to the .bed file
+ with pwrite at their final offsets.
+
+ Output (for --out PREFIX):
+   PREFIX.bed/.bim/.fam   genotypes of samples offset+1, ..., offset+n
+   PREFIX.pheno           FID IID Y1 ... YT of these samples
+   PREFIX.sumstats        Chr SNP Position A1 A2, and BETA.Yt SE.Yt P_val.Yt
+                          COR.Yt of each trait t from a GWAS of --gwas-n
+                          other samples (if --gwas-n > 0)
+   PREFIX.adj             SNP ADJ.Y2 ... ADJ.YT (if --traits > 1)
+   PREFIX.blocks.bed      the LD blocks (chr start end), for LDblocks=
+   PREFIX.truth           SNP and the true effects EFFECT.Yt
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+  std::string out;
+  int n, p, chr, blocksize, segment, founders, traits, gwasn, threads;
+  long long offset;
+  double mafmin, mafmax, mafshape, diversity, missing, causal, h2, rg;
+  uint64_t seed;
+  Options() : n(1000), p(10000), chr(22), blocksize(200), segment(50),
+    founders(16), traits(2), gwasn(10000), threads(1), offset(0),
+    mafmin(0.01), mafmax(0.5), mafshape(-1.0), diversity(0.2), missing(0.01), causal(0.01),
+    h2(0.5), rg(0.5), seed(1) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+};
+
+void usage() {
+  std::cerr <<
+    "Usage: ssctpr_simulate --out PREFIX [options]\n"
+    "  --n N              number of samples (1000)\n"
+    "  --p P              number of variants (10000)\n"
+    "  --chr K            number of chromosomes (22)\n"
+    "  --block-size L     variants per LD block (200)\n"
+    "  --segment S        mean variants copied from one founder (50)\n"
+    "  --founders F       founder haplotypes per block, <= 64 (16)\n"
+    "  --maf-min X        smallest MAF (0.01)\n"
+    "  --maf-max X        largest MAF (0.5)\n"
+    "  --maf-shape A      MAF density ~ maf^A; -1 is the neutral spectrum (-1)\n"
+    "  --diversity X      0 = nested carrier sets (strong LD), 1 = independent (0.2)\n"
+    "  --missing X        fraction of missing genotypes (0.01)\n"
+    "  --traits T         primary + secondary traits (2)\n"
+    "  --causal X         fraction of causal variants (0.01)\n"
+    "  --h2 X             heritability of each trait (0.5)\n"
+    "  --rg X             genetic correlation of the secondary traits with the\n"
+    "                     primary trait; also the adj coefficient (0.5)\n"
+    "  --gwas-n N         GWAS sample size of the summary statistics; 0 to skip (10000)\n"
+    "  --sample-offset K  IDs of the samples start at K+1, for disjoint cohorts (0)\n"
+    "  --threads T        threads (all cores)\n"
+    "  --seed S           random seed (1)\n";
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if (a == "--help" || a == "-h") {
+      usage();
+      std::exit(0);
+    }
+    if (i + 1 >= argc) throw std::runtime_error("Missing value for " + a);
+    const char* v = argv[++i];
+    if (a == "--out") opt.out = v;
+    else if (a == "--n") opt.n = std::atoi(v);
+    else if (a == "--p") opt.p = std::atoi(v);
+    else if (a == "--chr") opt.chr = std::atoi(v);
+    else if (a == "--block-size") opt.blocksize = std::atoi(v);
+    else if (a == "--segment") opt.segment = std::atoi(v);
+    else if (a == "--founders") opt.founders = std::atoi(v);
+    else if (a == "--maf-min") opt.mafmin = std::atof(v);
+    else if (a == "--maf-max") opt.mafmax = std::atof(v);
+    else if (a == "--maf-shape") opt.mafshape = std::atof(v);
+    else if (a == "--diversity") opt.diversity = std::atof(v);
+    else if (a == "--missing") opt.missing = std::atof(v);
+    else if (a == "--traits") opt.traits = std::atoi(v);
+    else if (a == "--causal") opt.causal = std::atof(v);
+    else if (a == "--h2") opt.h2 = std::atof(v);
+    else if (a == "--rg") opt.rg = std::atof(v);
+    else if (a == "--gwas-n") opt.gwasn = std::atoi(v);
+    else if (a == "--sample-offset") opt.offset = std::atoll(v);
+    else if (a == "--threads") opt.threads = std::atoi(v);
+    else if (a == "--seed") opt.seed = std::strtoull(v, 0, 10);
+    else throw std::runtime_error("Unknown option " + a);
+  }
+  if (opt.out.empty()) throw std::runtime_error("--out must be specified");
+  if (opt.n < 1 || opt.p < 1) throw std::runtime_error("--n and --p must be positive");
+  if (opt.founders < 2 || opt.founders > 64)
+    throw std::runtime_error("--founders must be between 2 and 64");
+  if (opt.blocksize < 1 || opt.segment < 1)
+    throw std::runtime_error("--block-size and --segment must be positive");
+  if (!(opt.mafmin > 0 && opt.mafmin <= opt.mafmax && opt.mafmax <= 0.5))
+    throw std::runtime_error("Need 0 < --maf-min <= --maf-max <= 0.5");
+  if (opt.diversity < 0 || opt.diversity > 1)
+    throw std::runtime_error("--diversity must be in [0, 1]");
+  if (opt.traits < 1) throw std::runtime_error("--traits must be positive");
+  if (opt.h2 < 0 || opt.h2 > 1 || opt.rg < -1 || opt.rg > 1)
+    throw std::runtime_error("--h2 must be in [0, 1] and --rg in [-1, 1]");
+  if (opt.gwasn != 0 && opt.gwasn < 3)
+    throw std::runtime_error("--gwas-n must be 0 or at least 3");
+  opt.chr = std::max(1, std::min(opt.chr, opt.p));
+  opt.threads = std::max(1, opt.threads);
+  return opt;
+}
+
+// Salts of the independent random streams
+enum Salt {
+  MAF = 1, ALLELES, FOUNDER, SWITCH, RARE, MISS, CAUSAL, EFFECT, NOISE, POSITION
+};
+
+inline uint64_t mix(uint64_t x) {
+  // splitmix64 finalizer
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t hash(uint64_t seed, uint64_t salt, uint64_t a, uint64_t b = 0,
+                     uint64_t c = 0, uint64_t d = 0) {
+  return mix(mix(mix(mix(mix(seed ^ salt) ^ a) ^ b) ^ c) ^ d);
+}
+
+inline double unit(uint64_t h) {
+  return (h >> 11) * (1.0 / 9007199254740992.0); // [0, 1)
+}
+
+inline double gaussian(uint64_t h) {
+  double u1 = unit(mix(h)) + 1e-300;
+  double u2 = unit(h);
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ A sequential stream of geometric gaps, to draw rare events (carriers,
+ missing genotypes) in O(number of events)
+
+ */
+class GapStream {
+public:
+  GapStream(uint64_t h, double rate) : state_(h), logq_(log1p(-rate)) {}
+  long long next() {
+    state_ = mix(state_);
+    return (long long) floor(log(unit(state_) + 1e-300) / logq_);
+  }
+private:
+  uint64_t state_;
+  double logq_;
+};
+
+struct Variant {
+  int chr, pos, block;
+  char a1, a2;
+  double maf;
+  bool rare;       // carriers drawn independently, not from founders
+  uint64_t mask;   // founders carrying A1
+};
+
+struct Block {
+  int start, end, chr; // variants [start, end)
+};
+
+double drawMaf(double u, const Options& opt) {
+  const double a = opt.mafshape + 1.0;
+  if (std::abs(a) < 1e-12) return opt.mafmin * pow(opt.mafmax / opt.mafmin, u);
+  return pow(pow(opt.mafmin, a) + u * (pow(opt.mafmax, a) - pow(opt.mafmin, a)),
+             1.0 / a);
+}
+
+void makeVariants(const Options& opt, std::vector<Variant>& variants,
+                  std::vector<Block>& blocks) {
+  // non-ambiguous allele pairs
+  const char* pairs[] = {"AC", "AG", "CA", "CT", "GA", "GT", "TC", "TG"};
+  variants.resize(opt.p);
+  blocks.clear();
+  const int F = opt.founders;
+  std::vector<std::pair<double, int> > order(F);
+  for (int c = 0; c < opt.chr; c++) {
+    int from = (long long) opt.p * c / opt.chr;
+    int to = (long long) opt.p * (c + 1) / opt.chr;
+    const int firstblock = blocks.size();
+    for (int s = from; s < to; s += opt.blocksize) {
+      Block b;
+      b.start = s;
+      b.end = std::min(to, s + opt.blocksize);
+      b.chr = c + 1;
+      blocks.push_back(b);
+    }
+    for (int j = from; j < to; j++) {
+      Variant& v = variants[j];
+      v.chr = c + 1;
+      v.pos = 1 + (j - from) * 1000 + hash(opt.seed, POSITION, j) % 1000;
+      v.block = firstblock + (j - from) / opt.blocksize;
+      const char* pair = pairs[hash(opt.seed, ALLELES, j) % 8];
+      v.a1 = pair[0];
+      v.a2 = pair[1];
+      v.maf = drawMaf(unit(hash(opt.seed, MAF, j)), opt);
+      int k = (int) floor(v.maf * F + 0.5);
+      v.rare = (k == 0);
+      v.mask = 0;
+      if (!v.rare) {
+        // the k founders with the smallest keys carry A1; keys shared within
+        // the block make the carriers of nearby variants overlap (LD)
+        for (int f = 0; f < F; f++) {
+          double key = (1.0 - opt.diversity) * unit(hash(opt.seed, FOUNDER, v.block, f)) + 
+            opt.diversity * unit(hash(opt.seed, FOUNDER, j, f, 1));
+          order[f] = std::make_pair(key, f);
+        }
+        std::partial_sort(order.begin(), order.begin() + k, order.end());
+        for (int f = 0; f < k; f++) v.mask |= (uint64_t) 1 << order[f].second;
+      }
+    }
+  }
+}
+
+/**
+ Founders copied by each haplotype of a set of samples in one block
+
+ */
+class BlockHaplotypes {
+public:
+  BlockHaplotypes(const Options& opt) : opt_(opt) {}
+
+  void prepare(const Block& b, int blockid, long long firstid, int nsamples) {
+    block_ = b;
+    blockid_ = blockid;
+    firstid_ = firstid;
+    nsamples_ = nsamples;
+    const int S = opt_.segment;
+    nseg_ = (b.end - b.start) / S + 2;
+    shift_.resize(2 * (size_t) nsamples);
+    founder_.resize(2 * (size_t) nsamples * nseg_);
+    for (int i = 0; i < nsamples; i++) {
+      const uint64_t id = firstid + i;
+      for (int h = 0; h < 2; h++) {
+        const size_t ih = 2 * (size_t) i + h;
+        shift_[ih] = hash(opt_.seed, SWITCH, id, h, blockid) % S;
+        for (int q = 0; q < nseg_; q++) {
+          // half of the switch points keep the founder, so LD decays
+          // gradually over the block
+          if (q > 0 && unit(hash(opt_.seed, SWITCH, id, h, blockid, q)) < 0.5) {
+            founder_[ih * nseg_ + q] = founder_[ih * nseg_ + q - 1];
+          } else {
+            founder_[ih * nseg_ + q] =
+              hash(opt_.seed, FOUNDER, id, h, blockid, q) % opt_.founders;
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   Dosages (number of A1 alleles, -1 if missing) of variants [j0, j1) of the 
+   block; out is (j1 - j0) x nsamples, variant-major
+   
+   */
+  void dosages(const std::vector<Variant>& variants, int j0, int j1, 
+               bool missing, int8_t* out) const {
+    const int S = opt_.segment;
+    const int m = j1 - j0;
+    if (m > 64) throw std::logic_error("dosages: at most 64 variants at a time");
+    // alleles of each founder over the variants, bit k = variant j0 + k
+    pattern_.assign(opt_.founders, 0);
+    for (int k = 0; k < m; k++) {
+      const uint64_t mask = variants[j0 + k].mask;
+      for (int f = 0; f < opt_.founders; f++) 
+        pattern_[f] |= ((mask >> f) & 1) << k;
+    }
+    // walk the segments of each haplotype along the variants
+    hapbits_.resize(2 * (size_t) nsamples_);
+    for (size_t ih = 0; ih < hapbits_.size(); ih++) {
+      const uint8_t* founder = &founder_[ih * nseg_];
+      const int pos = j0 - block_.start + shift_[ih];
+      int q = pos / S, r = pos % S;
+      uint64_t bits = 0;
+      for (int k = 0; k < m; q++, r = 0) {
+        const int len = std::min(m - k, S - r);
+        const uint64_t keep = (len == 64) ? ~0ULL : (((uint64_t) 1 << len) - 1) << k;
+        bits |= pattern_[founder[q]] & keep;
+        k += len;
+      }
+      hapbits_[ih] = bits;
+    }
+    for (int k = 0; k < m; k++) {
+      int8_t* d = out + (size_t) k * nsamples_;
+      for (int i = 0; i < nsamples_; i++) {
+        d[i] = ((hapbits_[2 * i] >> k) & 1) + ((hapbits_[2 * i + 1] >> k) & 1);
+      }
+    }
+    for (int k = 0; k < m; k++) {
+      const int j = j0 + k;
+      int8_t* d = out + (size_t) k * nsamples_;
+      if (variants[j].rare) {
+        std::fill(d, d + nsamples_, 0);
+        GapStream carriers(hash(opt_.seed, RARE, j, firstid_), variants[j].maf);
+        for (long long ih = carriers.next(); ih < 2LL * nsamples_;
+             ih += 1 + carriers.next()) {
+          d[ih / 2]++;
+        }
+      }
+      if (missing && opt_.missing > 0) {
+        GapStream miss(hash(opt_.seed, MISS, j, firstid_), opt_.missing);
+        for (long long i = miss.next(); i < nsamples_; i += 1 + miss.next()) {
+          d[i] = -1;
+        }
+      }
+    }
+  }
+
+private:
+  const Options& opt_;
+  Block block_;
+  int blockid_, nsamples_, nseg_;
+  long long firstid_;
+  std::vector<uint16_t> shift_;
+  std::vector<uint8_t> founder_;
+  mutable std::vector<uint64_t> pattern_, hapbits_;
+};
+
+/**
+ Runs f(thread, block) over all blocks on opt.threads threads
+
+ */
+template <class F>
+void parallelBlocks(int threads, int nblocks, F f) {
+  std::atomic<int> next(0);
+  std::vector<std::thread> pool;
+  for (int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&, t]() {
+      for (int b = next++; b < nblocks; b = next++) f(t, b);
+    }));
+  }
+  for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+double now() {
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ True effects per standardized genotype: causal variants share effects
+ across traits with correlation rg to the primary trait
+
+ */
+void makeEffects(const Options& opt, const std::vector<Variant>& variants,
+                 std::vector<double>& effects, std::vector<int>& causal) {
+  const int T = opt.traits;
+  effects.assign((size_t) opt.p * T, 0.0);
+  causal.clear();
+  for (int j = 0; j < opt.p; j++) {
+    if (unit(hash(opt.seed, CAUSAL, j)) >= opt.causal) continue;
+    causal.push_back(j);
+    const double maf = variants[j].maf;
+    const double scale = 1.0 / sqrt(2.0 * maf * (1.0 - maf));
+    const double z1 = gaussian(hash(opt.seed, EFFECT, j, 0));
+    effects[j] = z1 * scale;
+    for (int t = 1; t < T; t++) {
+      const double zt = gaussian(hash(opt.seed, EFFECT, j, t));
+      effects[j + (size_t) t * opt.p] =
+        (opt.rg * z1 + sqrt(1.0 - opt.rg * opt.rg) * zt) * scale;
+    }
+  }
+}
+
+/**
+ Phenotypes Y = G * sqrt(h2 / var(G)) + e * sqrt(1 - h2) from the genetic
+ values G (nsamples x T), standardized
+
+ */
+void makePhenotypes(const Options& opt, std::vector<double>& G, int nsamples,
+                    long long firstid) {
+  for (int t = 0; t < opt.traits; t++) {
+    double* g = &G[(size_t) t * nsamples];
+    double m = 0.0, v = 0.0;
+    for (int i = 0; i < nsamples; i++) m += g[i];
+    m /= nsamples;
+    for (int i = 0; i < nsamples; i++) v += (g[i] - m) * (g[i] - m);
+    v /= nsamples;
+    const double gs = (v > 0) ? sqrt(opt.h2 / v) : 0.0;
+    const double es = (v > 0) ? sqrt(1.0 - opt.h2) : 1.0;
+    double ym = 0.0, yv = 0.0;
+    for (int i = 0; i < nsamples; i++) {
+      g[i] = (g[i] - m) * gs + es * gaussian(hash(opt.seed, NOISE, firstid + i, t));
+      ym += g[i];
+    }
+    ym /= nsamples;
+    for (int i = 0; i < nsamples; i++) yv += (g[i] - ym) * (g[i] - ym);
+    const double ysd = sqrt(yv / nsamples);
+    for (int i = 0; i < nsamples; i++) g[i] = (g[i] - ym) / ysd;
+  }
+}
+
+void checkWrite(std::ostream& out, const std::string& fileName) {
+  if (!out) throw std::runtime_error("Cannot write " + fileName);
+}
+
+/**
+ Writes the .bed file block by block, accumulating the genetic values of
+ the samples in G
+
+ */
+void writeBed(const Options& opt, const std::vector<Variant>& variants,
+              const std::vector<Block>& blocks, const std::vector<double>& effects,
+              std::vector<double>& G) {
+  const std::string fileName = opt.out + ".bed";
+  int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) throw std::runtime_error("Cannot write " + fileName + ": " + strerror(errno));
+  const unsigned char magic[3] = {0x6c, 0x1b, 0x01};
+  const size_t Nbytes = (opt.n + 3) / 4;
+  if (pwrite(fd, magic, 3, 0) != 3 ||
+      ftruncate(fd, 3 + (off_t) Nbytes * opt.p) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot write " + fileName + ": " + strerror(errno));
+  }
+
+  const int T = opt.traits;
+  const int CHUNK = 64; // variants per pwrite
+  std::vector<std::vector<double> > Gt(opt.threads);
+  std::atomic<bool> failed(false);
+  // 2-bit codes by dosage of A1: 0 -> 11, 1 -> 10, 2 -> 00; missing -> 01
+  const uint8_t codes[4] = {0x3, 0x2, 0x0, 0x1};
+  parallelBlocks(opt.threads, blocks.size(), [&](int t, int b) {
+    if (failed) return;
+    BlockHaplotypes hap(opt);
+    hap.prepare(blocks[b], b, opt.offset, opt.n);
+    std::vector<int8_t> dd((size_t) opt.n * CHUNK);
+    std::vector<uint8_t> buf(Nbytes * CHUNK);
+    if (Gt[t].empty()) Gt[t].assign((size_t) opt.n * T, 0.0);
+    for (int j0 = blocks[b].start; j0 < blocks[b].end; j0 += CHUNK) {
+      const int j1 = std::min(blocks[b].end, j0 + CHUNK);
+      hap.dosages(variants, j0, j1, true, &dd[0]);
+      for (int j = j0; j < j1; j++) {
+        const int8_t* d = &dd[(size_t) (j - j0) * opt.n];
+        uint8_t* row = &buf[(size_t) (j - j0) * Nbytes];
+        std::fill(row, row + Nbytes, 0);
+        for (int i = 0; i < opt.n; i++) {
+          row[i >> 2] |= codes[d[i] < 0 ? 3 : d[i]] << ((i & 3) * 2);
+        }
+        for (int tt = 0; tt < T; tt++) {
+          const double e = effects[j + (size_t) tt * opt.p];
+          if (e == 0.0) continue;
+          double* g = &Gt[t][(size_t) tt * opt.n];
+          for (int i = 0; i < opt.n; i++) if (d[i] > 0) g[i] += d[i] * e;
+        }
+      }
+      const size_t len = (size_t) (j1 - j0) * Nbytes;
+      if (pwrite(fd, &buf[0], len, 3 + (off_t) j0 * Nbytes) != (ssize_t) len) {
+        failed = true;
+        return;
+      }
+    }
+  });
+  close(fd);
+  if (failed) throw std::runtime_error("Cannot write " + fileName);
+  G.assign((size_t) opt.n * T, 0.0);
+  for (int t = 0; t < opt.threads; t++) {
+    for (size_t i = 0; i < Gt[t].size(); i++) G[i] += Gt[t][i];
+  }
+}
+
+/**
+ Simulates a GWAS of opt.gwasn samples (ids after those of the cohort) and
+ returns the correlation of each variant with each trait, and the sd of the
+ genotypes
+
+ */
+void simulateGwas(const Options& opt, const std::vector<Variant>& variants,
+                  const std::vector<Block>& blocks, const std::vector<double>& effects,
+                  std::vector<double>& cor, std::vector<double>& sd) {
+  const int T = opt.traits;
+  const int n = opt.gwasn;
+  const long long firstid = opt.offset + opt.n;
+  std::vector<char> hascausal(blocks.size(), 0);
+  for (int j = 0; j < opt.p; j++) {
+    if (effects[j] != 0.0) hascausal[variants[j].block] = 1;
+  }
+
+  // pass 1: genetic values from the causal variants
+  std::vector<std::vector<double> > Gt(opt.threads);
+  parallelBlocks(opt.threads, blocks.size(), [&](int t, int b) {
+    if (!hascausal[b]) return;
+    BlockHaplotypes hap(opt);
+    hap.prepare(blocks[b], b, firstid, n);
+    std::vector<int8_t> d(n);
+    if (Gt[t].empty()) Gt[t].assign((size_t) n * T, 0.0);
+    for (int j = blocks[b].start; j < blocks[b].end; j++) {
+      if (effects[j] == 0.0) continue;
+      hap.dosages(variants, j, j + 1, false, &d[0]);
+      for (int tt = 0; tt < T; tt++) {
+        const double e = effects[j + (size_t) tt * opt.p];
+        double* g = &Gt[t][(size_t) tt * n];
+        for (int i = 0; i < n; i++) g[i] += d[i] * e;
+      }
+    }
+  });
+  std::vector<double> Y((size_t) n * T, 0.0);
+  for (int t = 0; t < opt.threads; t++) {
+    for (size_t i = 0; i < Gt[t].size(); i++) Y[i] += Gt[t][i];
+  }
+  makePhenotypes(opt, Y, n, firstid);
+
+  // pass 2: marginal correlations (Y is standardized)
+  cor.assign((size_t) opt.p * T, 0.0);
+  sd.assign(opt.p, 0.0);
+  parallelBlocks(opt.threads, blocks.size(), [&](int t, int b) {
+    BlockHaplotypes hap(opt);
+    hap.prepare(blocks[b], b, firstid, n);
+    const int CHUNK = 64;
+    std::vector<int8_t> dd((size_t) n * CHUNK);
+    for (int j = blocks[b].start; j < blocks[b].end; j++) {
+      const int k = (j - blocks[b].start) % CHUNK;
+      if (k == 0) 
+        hap.dosages(variants, j, std::min(blocks[b].end, j + CHUNK), false, &dd[0]);
+      const int8_t* d = &dd[(size_t) k * n];
+      long long s = 0, ss = 0;
+      for (int i = 0; i < n; i++) {
+        s += d[i];
+        ss += d[i] * d[i];
+      }
+      const double m = (double) s / n;
+      const double v = (double) ss / n - m * m;
+      sd[j] = (v > 0) ? sqrt(v) : 0.0;
+      if (sd[j] == 0.0) continue;
+      for (int tt = 0; tt < T; tt++) {
+        const double* y = &Y[(size_t) tt * n];
+        double dy = 0.0;
+        for (int i = 0; i < n; i++) dy += d[i] * y[i];
+        double r = dy / n / sd[j];
+        cor[j + (size_t) tt * opt.p] = std::max(-0.999999, std::min(0.999999, r));
+      }
+    }
+  });
+}
+
+std::string snpName(int j) {
+  std::ostringstream s;
+  s << "rs" << j + 1;
+  return s.str();
+}
+
+void writeText(const Options& opt, const std::vector<Variant>& variants,
+               const std::vector<Block>& blocks, const std::vector<double>& effects,
+               const std::vector<double>& G, const std::vector<double>& cor,
+               const std::vector<double>& sd) {
+  const int T = opt.traits;
+  std::string fileName = opt.out + ".bim";
+  std::ofstream bim(fileName.c_str());
+  for (int j = 0; j < opt.p; j++) {
+    const Variant& v = variants[j];
+    bim << v.chr << "\t" << snpName(j) << "\t0\t" << v.pos << "\t"
+        << v.a1 << "\t" << v.a2 << "\n";
+  }
+  checkWrite(bim, fileName);
+
+  fileName = opt.out + ".fam";
+  std::ofstream fam(fileName.c_str());
+  fileName = opt.out + ".pheno";
+  std::ofstream pheno(fileName.c_str());
+  pheno << "FID\tIID";
+  for (int t = 0; t < T; t++) pheno << "\tY" << t + 1;
+  pheno << "\n";
+  for (int i = 0; i < opt.n; i++) {
+    const long long id = opt.offset + i + 1;
+    fam << "S" << id << "\tS" << id << "\t0\t0\t0\t-9\n";
+    pheno << "S" << id << "\tS" << id;
+    for (int t = 0; t < T; t++) pheno << "\t" << G[i + (size_t) t * opt.n];
+    pheno << "\n";
+  }
+  checkWrite(fam, opt.out + ".fam");
+  checkWrite(pheno, fileName);
+
+  fileName = opt.out + ".blocks.bed";
+  std::ofstream bed(fileName.c_str());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    bed << blocks[b].chr << "\t" << variants[blocks[b].start].pos - 1 << "\t"
+        << variants[blocks[b].end - 1].pos << "\n";
+  }
+  checkWrite(bed, fileName);
+
+  fileName = opt.out + ".truth";
+  std::ofstream truth(fileName.c_str());
+  truth << "SNP";
+  for (int t = 0; t < T; t++) truth << "\tEFFECT.Y" << t + 1;
+  truth << "\n";
+  for (int j = 0; j < opt.p; j++) {
+    truth << snpName(j);
+    for (int t = 0; t < T; t++) truth << "\t" << effects[j + (size_t) t * opt.p];
+    truth << "\n";
+  }
+  checkWrite(truth, fileName);
+
+  if (T > 1) {
+    fileName = opt.out + ".adj";
+    std::ofstream adj(fileName.c_str());
+    adj << "SNP";
+    for (int t = 1; t < T; t++) adj << "\tADJ.Y" << t + 1;
+    adj << "\n";
+    for (int j = 0; j < opt.p; j++) {
+      adj << snpName(j);
+      for (int t = 1; t < T; t++) adj << "\t" << std::abs(opt.rg);
+      adj << "\n";
+    }
+    checkWrite(adj, fileName);
+  }
+
+  if (opt.gwasn == 0) return;
+  fileName = opt.out + ".sumstats";
+  std::ofstream ss(fileName.c_str());
+  ss << "Chr\tSNP\tPosition\tA1\tA2";
+  for (int t = 0; t < T; t++) {
+    ss << "\tBETA.Y" << t + 1 << "\tSE.Y" << t + 1 << "\tP_val.Y" << t + 1
+       << "\tCOR.Y" << t + 1;
+  }
+  ss << "\n";
+  const double n = opt.gwasn;
+  for (int j = 0; j < opt.p; j++) {
+    const Variant& v = variants[j];
+    ss << v.chr << "\t" << snpName(j) << "\t" << v.pos << "\t" << v.a1 << "\t" << v.a2;
+    for (int t = 0; t < T; t++) {
+      const double r = cor[j + (size_t) t * opt.p];
+      double beta = 0.0, se = 0.0, pval = 1.0;
+      if (sd[j] > 0) {
+        // Y has unit variance; normal approximation of the t statistic
+        beta = r / sd[j];
+        se = sqrt((1.0 - r * r) / (n - 2.0)) / sd[j];
+        const double tstat = r * sqrt((n - 2.0) / (1.0 - r * r));
+        pval = std::max(DBL_MIN, erfc(std::abs(tstat) / M_SQRT2));
+      }
+      ss << "\t" << beta << "\t" << se << "\t" << pval << "\t" << r;
+    }
+    ss << "\n";
+  }
+  checkWrite(ss, fileName);
+}
+
+}
+
+int main(int argc, char** argv) {
+  try {
+    Options opt = parseOptions(argc, argv);
+    double start = now();
+    std::vector<Variant> variants;
+    std::vector<Block> blocks;
+    makeVariants(opt, variants, blocks);
+    std::vector<double> effects;
+    std::vector<int> causal;
+    makeEffects(opt, variants, effects, causal);
+
+    std::vector<double> G;
+    writeBed(opt, variants, blocks, effects, G);
+    makePhenotypes(opt, G, opt.n, opt.offset);
+    double tbed = now();
+    std::cerr << "Wrote " << opt.out << ".bed (" << opt.n << " x " << opt.p
+              << ", " << blocks.size() << " blocks, " << causal.size()
+              << " causal variants) in " << tbed - start << "s" << std::endl;
+
+    std::vector<double> cor, sd;
+    if (opt.gwasn > 0) {
+      simulateGwas(opt, variants, blocks, effects, cor, sd);
+      std::cerr << "Simulated a GWAS of " << opt.gwasn << " samples in "
+                << now() - tbed << "s" << std::endl;
+    }
+    writeText(opt, variants, blocks, effects, G, cor, sd);
+    std::cerr << "Done in " << now() - start << "s" << std::endl;
+  } catch (std::exception& e) {
+    std::cerr << "ssctpr_simulate: " << e.what() << std::endl;
+    return 2;
+  }
+  return 0;
+}
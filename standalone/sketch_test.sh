@@ -0,0 +1,20 @@
+#!/bin/sh
+# Checks ssctpr_run --sketch: a sketch at least as large as the panel must
+# give the weights of the full panel, and a smaller one must report an LD
+# error in (0, 1).
+# Usage: sketch_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 5
+"$B/ssctpr_run" $ARGS --out "$D/full" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/n" --sketch 401 2>/dev/null
+cmp "$D/full.weights" "$D/n.weights"
+for method in srht sparse; do
+  "$B/ssctpr_run" $ARGS --out "$D/$method" --sketch 100 --sketch-method $method 2>/dev/null
+  awk -v m=$method '$1 == "ld.error.mean" { e = $2 } $1 == "blocks.sketched" { k = $2 }
+    END { if (k == 0 || e <= 0 || e >= 1) { print m ": ld error " e " on " k " blocks"; exit 1 } }' \
+    "$D/$method.log"
+done
+echo "sketches agree with the full panel"
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Checks ssctpr_run --ld sparse: without a threshold it must give the weights
+# of the full panel, and with one it must store fewer correlations and still
+# converge. A threshold makes the blocks indefinite, so each one must be shrunk
+# until its estimated smallest eigenvalue is non-negative.
+# Usage: sparseld_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 5
+"$B/ssctpr_run" $ARGS --out "$D/full" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/r0" --ld sparse --ld-r2 0 2>/dev/null
+# same non-zero weights, up to rounding
+compare_weights "$D/full.weights" "$D/r0.weights" 1e-8
+test "$(wc -l < "$D/full.weights")" -eq "$(wc -l < "$D/r0.weights")"
+for r2 in 0.01 0.1; do
+  "$B/ssctpr_run" $ARGS --out "$D/r$r2" --ld sparse --ld-r2 $r2 --ld-window 10000 2>/dev/null
+  awk -v r2=$r2 -v all=$(awk '$1 == "ld.nnz" { print $2 }' "$D/r0.log") '
+    $1 == "ld.nnz" { nnz = $2 } $1 == "not.converged" { nc = $2 }
+    $1 == "blocks.ld.shrunk" { s = $2 } $1 == "ld.smallest.eigenvalue" { e = $2 }
+    END { if (nnz >= all || nc > 0) { print r2 ": " nnz " of " all " stored, " nc " not converged"; exit 1 }
+          if (s == 0 || e == "NA" || e < 0) { print r2 ": " s " blocks shrunk, smallest eigenvalue " e; exit 1 } }' \
+    "$D/r$r2.log"
+done
+echo "sparse LD agrees with the full panel"
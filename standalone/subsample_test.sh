@@ -0,0 +1,18 @@
+#!/bin/sh
+# Checks ssctpr_run --subsample K: blocks without a warm start must be
+# solved on the coarse panel first and start from that solution, and the
+# weights must agree with those of the full panel alone up to the accuracy
+# of --thr.
+# Usage: subsample_test.sh BUILD_DIR
+set -e
+B=$1
+. "$(dirname "$0")/fixture.sh"
+
+simulate 5
+"$B/ssctpr_run" $ARGS --out "$D/full" 2>/dev/null
+"$B/ssctpr_run" $ARGS --out "$D/coarse" --subsample 150 2>/dev/null
+awk '$1 == "blocks.coarse.start" { c = $2 } $1 == "sweeps.coarse" { s = $2 }
+  END { if (c <= 0 || s <= 0) { print c " coarse starts, " s " coarse sweeps"; exit 1 } }' \
+  "$D/coarse.log"
+compare_weights "$D/full.weights" "$D/coarse.weights" 2e-3
+echo "coarse starts agree with the full panel"